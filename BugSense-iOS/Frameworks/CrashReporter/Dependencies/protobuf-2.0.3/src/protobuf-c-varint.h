@@ -0,0 +1,50 @@
+/*
+ * Copyright 2008, Dave Benson.
+ * Copyright 2008 - 2011 Plausible Labs Cooperative, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License
+ * at http://www.apache.org/licenses/LICENSE-2.0 Unless
+ * required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Varint size kernels, shared by protobuf-c and the PLCrashReporter
+ * async-safe log writer. The encoded size is computed from the value's
+ * bit length, rather than by comparing against each size threshold.
+ *
+ * These are async-safe: no library calls are made, and no state is shared.
+ */
+
+#ifndef __PROTOBUF_C_VARINT_H_
+#define __PROTOBUF_C_VARINT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Maximum encoded size of a 64-bit varint. */
+#define PROTOBUF_C_VARINT_MAX_SIZE 10
+
+/* Encoded size of a 64-bit varint. For 1 <= bits <= 64, (bits * 9 + 64) / 64 == ceil(bits / 7). */
+static inline size_t
+protobuf_c_varint_size64 (uint64_t v)
+{
+  unsigned bits = 64 - __builtin_clzll (v | 1);
+  return (bits * 9 + 64) / 64;
+}
+
+/* Encoded size of a 32-bit varint. */
+static inline size_t
+protobuf_c_varint_size32 (uint32_t v)
+{
+  unsigned bits = 32 - __builtin_clz (v | 1);
+  return (bits * 9 + 64) / 64;
+}
+
+#endif /* __PROTOBUF_C_VARINT_H_ */
@@ -22,6 +22,7 @@
 #define PRINT_UNPACK_ERRORS              1
 
 #include "protobuf-c.h"
+#include "protobuf-c-varint.h"
 
 #define MAX_UINT64_ENCODED_SIZE 10
 
@@ -125,47 +126,18 @@ protobuf_c_buffer_simple_append (ProtobufCBuffer *buffer,
 static inline size_t
 get_tag_size (unsigned number)
 {
-  if (number < (1<<4))
-    return 1;
-  else if (number < (1<<11))
-    return 2;
-  else if (number < (1<<18))
-    return 3;
-  else if (number < (1<<25))
-    return 4;
-  else
-    return 5;
+  return protobuf_c_varint_size32 (number << 3);
 }
 static inline size_t
 uint32_size (uint32_t v)
 {
-  if (v < (1<<7))
-    return 1;
-  else if (v < (1<<14))
-    return 2;
-  else if (v < (1<<21))
-    return 3;
-  else if (v < (1<<28))
-    return 4;
-  else
-    return 5;
+  return protobuf_c_varint_size32 (v);
 }
 static inline size_t
 int32_size (int32_t v)
 {
-  if (v < 0)
-    return 10;
-  else
-  if (v < (1<<7))
-    return 1;
-  else if (v < (1<<14))
-    return 2;
-  else if (v < (1<<21))
-    return 3;
-  else if (v < (1<<28))
-    return 4;
-  else
-    return 5;
+  /* negative values are sign-extended to 10 bytes */
+  return protobuf_c_varint_size64 ((uint64_t)(int64_t) v);
 }
 static inline uint32_t
 zigzag32 (int32_t v)
@@ -183,21 +155,7 @@ sint32_size (int32_t v)
 static inline size_t
 uint64_size (uint64_t v)
 {
-  uint32_t upper_v = (v>>32);
-  if (upper_v == 0)
-    return uint32_size ((uint32_t)v);
-  else if (upper_v < (1<<3))
-    return 5;
-  else if (upper_v < (1<<10))
-    return 6;
-  else if (upper_v < (1<<17))
-    return 7;
-  else if (upper_v < (1<<24))
-    return 8;
-  else if (upper_v < (1U<<31))
-    return 9;
-  else
-    return 10;
+  return protobuf_c_varint_size64 (v);
 }
 static inline uint64_t
 zigzag64 (int64_t v)
@@ -0,0 +1,606 @@
+/*
+ *  harness-main.c
+ *  CrashReporter
+ *
+ *  Linux crash log writer harness. Writes crash reports from a SIGSEGV handler while a set of test threads are
+ *  running, decodes each report, and validates its structure. The report is written uncompressed, with image-relative
+ *  frames, and compressed; each mode is timed over a number of iterations.
+ *
+ *  Build and run from the Source directory (the protobuf-c headers are included as <google/protobuf-c/...>):
+ *
+ *    mkdir -p /tmp/plcrash-inc/google
+ *    ln -sfn "$PWD/../Dependencies/protobuf-2.0.3/src" /tmp/plcrash-inc/google/protobuf-c
+ *    gcc -std=gnu99 -O2 -g -fno-omit-frame-pointer -DPLCF_RELEASE_BUILD -I. -I/tmp/plcrash-inc \
+ *        -o /tmp/plcrash-harness LinuxHarness/harness-main.c \
+ *        PLCrashLogWriter.c PLCrashLogWriterEncoding.c PLCrashAsync.c PLCrashAsyncImage.c PLCrashAsyncImageELF.c \
+ *        PLCrashAsyncThread.c PLCrashAsyncSignalInfo.c PLCrashAsyncCompress.c PLCrashFrameWalker.c \
+ *        PLCrashFrameWalker_linux_x86_64.c PLCrashFrameWalker_x86_64.c -lpthread -ldl
+ *    /tmp/plcrash-harness [iterations] [output directory]
+ *
+ *  The frame walker follows the frame pointer chain, and frame pointers must not be omitted.
+ *
+ *  If an output directory is given, the last report message of each mode is written to <mode>.pb, with the file
+ *  header stripped and the message decompressed, and may be inspected with:
+ *
+ *    protoc --decode=plcrash.CrashReport ../Resources/crash_report.proto < <mode>.pb
+ *
+ *  The harness exits with a non-zero status if any report fails to validate.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <elf.h>
+
+#include "PLCrashReport.h"
+#include "PLCrashLogWriter.h"
+#include "PLCrashFrameWalker.h"
+#include "PLCrashAsyncCompress.h"
+
+/* Output limit, matching the limit used by PLCrashReporter */
+#define REPORT_LIMIT (64 * 1024)
+
+/* Number of test threads, and the number of distinct backtrace depths amongst them */
+#define TEST_THREAD_COUNT 8
+#define TEST_THREAD_DEPTHS 3
+
+/* CrashReport field numbers (see crash_report.proto) */
+enum {
+    REPORT_SYSTEM_INFO = 1,
+    REPORT_APPLICATION_INFO = 2,
+    REPORT_THREADS = 3,
+    REPORT_BINARY_IMAGES = 4,
+    REPORT_SIGNAL = 6,
+    REPORT_PROCESS_INFO = 7,
+    REPORT_MACHINE_INFO = 8,
+
+    THREAD_NUMBER = 1,
+    THREAD_CRASHED = 3,
+    THREAD_PCS = 5,
+    THREAD_IMAGE_RELATIVE_PCS = 6,
+    THREAD_INTERNED_STACK = 7,
+    THREAD_REGISTER_SET = 8,
+    THREAD_REGISTER_VALUES = 9,
+
+    IMAGE_BASE_ADDRESS = 1,
+    IMAGE_SIZE = 2,
+    IMAGE_NAME = 3,
+    IMAGE_CODE_TYPE = 5,
+
+    SIGNAL_NAME = 1,
+    SIGNAL_CODE = 2,
+
+    MACHINE_PROCESSOR = 2,
+    PROCESSOR_ENCODING = 1,
+    PROCESSOR_TYPE = 2,
+
+    /* CrashReport.Processor.TypeEncoding.TYPE_ENCODING_ELF */
+    ENCODING_ELF = 2,
+
+    /* CrashReport.Thread.RegisterSet.REGISTER_SET_X86_64 */
+    REGISTER_SET_X86_64 = 2,
+};
+
+/** A harness run mode. */
+typedef struct harness_mode {
+    /** Mode name, used for output file naming */
+    const char *name;
+
+    /** Crash log writer options */
+    uint32_t options;
+} harness_mode_t;
+
+/** Validated report statistics. */
+typedef struct report_stats {
+    size_t length;
+    uint32_t thread_count;
+    uint32_t interned_count;
+    uint32_t frame_count;
+    uint32_t image_count;
+} report_stats_t;
+
+/** A protobuf field, as read by pb_next(). */
+typedef struct pb_field {
+    uint32_t number;
+    uint32_t wire_type;
+
+    /** Varint value (wire type 0) */
+    uint64_t value;
+
+    /** Length-delimited data (wire type 2) */
+    const uint8_t *data;
+    size_t length;
+} pb_field_t;
+
+static plcrash_log_writer_t writer;
+static uint8_t report_buffer[2 * REPORT_LIMIT];
+static uint8_t message_buffer[256 * 1024];
+
+/* Crash handler state */
+static sigjmp_buf crash_jmp;
+static int report_fd = -1;
+static volatile plcrash_error_t crash_err;
+static struct timespec crash_start;
+static struct timespec crash_end;
+
+static void crash_handler (int signo, siginfo_t *info, void *uap) {
+    plcrash_async_file_t file;
+
+    clock_gettime(CLOCK_MONOTONIC, &crash_start);
+    plcrash_async_file_init(&file, report_fd, REPORT_LIMIT);
+    crash_err = plcrash_log_writer_write(&writer, &file, info, uap);
+    plcrash_async_file_flush(&file);
+    clock_gettime(CLOCK_MONOTONIC, &crash_end);
+
+    siglongjmp(crash_jmp, 1);
+}
+
+/* Faulting address. This is volatile, so that the compiler may not elide the faulting store as undefined behavior. */
+static int * volatile crash_address = NULL;
+
+/* Trigger a SIGSEGV. */
+static void __attribute__((noinline)) crash (void) {
+    *crash_address = 0;
+}
+
+/* Crash, writing a report from the SIGSEGV handler, and return the result of plcrash_log_writer_write(). */
+static plcrash_error_t write_report (void) {
+    if (sigsetjmp(crash_jmp, 1) == 0)
+        crash();
+
+    return crash_err;
+}
+
+static double elapsed_us (const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1e6 + (end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+/*
+ * Minimal protobuf wire format reader.
+ */
+
+static bool pb_varint (const uint8_t **p, const uint8_t *end, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+        *value |= (uint64_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+/* Read the next field, returning false at the end of the message or on a malformed field (setting *error). */
+static bool pb_next (const uint8_t **p, const uint8_t *end, pb_field_t *field, bool *error) {
+    uint64_t key;
+
+    if (*p == end)
+        return false;
+
+    if (!pb_varint(p, end, &key))
+        goto malformed;
+
+    field->number = (uint32_t) (key >> 3);
+    field->wire_type = key & 0x7;
+
+    switch (field->wire_type) {
+        case 0:
+            if (!pb_varint(p, end, &field->value))
+                goto malformed;
+            return true;
+
+        case 1:
+        case 5: {
+            size_t len = field->wire_type == 1 ? 8 : 4;
+            if ((size_t) (end - *p) < len)
+                goto malformed;
+            *p += len;
+            return true;
+        }
+
+        case 2:
+            if (!pb_varint(p, end, &field->value) || field->value > (uint64_t) (end - *p))
+                goto malformed;
+            field->data = *p;
+            field->length = (size_t) field->value;
+            *p += field->length;
+            return true;
+
+        default:
+            goto malformed;
+    }
+
+malformed:
+    *error = true;
+    return false;
+}
+
+/* Count the varints of a packed repeated field, returning false if it is malformed. */
+static bool pb_packed_count (const pb_field_t *field, uint32_t *count) {
+    const uint8_t *p = field->data;
+    const uint8_t *end = field->data + field->length;
+    uint64_t value;
+
+    *count = 0;
+    while (p < end) {
+        if (!pb_varint(&p, end, &value))
+            return false;
+        (*count)++;
+    }
+    return true;
+}
+
+static bool pb_string_equal (const pb_field_t *field, const char *str) {
+    return field->wire_type == 2 && field->length == strlen(str) && memcmp(field->data, str, field->length) == 0;
+}
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "  validation failed: " __VA_ARGS__); \
+        fputc('\n', stderr); \
+        return false; \
+    } \
+} while (0)
+
+static bool validate_image (const pb_field_t *image) {
+    const uint8_t *p = image->data;
+    const uint8_t *end = image->data + image->length;
+    pb_field_t field;
+    bool error = false;
+    bool has_base = false, has_size = false, has_name = false;
+
+    while (pb_next(&p, end, &field, &error)) {
+        switch (field.number) {
+            case IMAGE_BASE_ADDRESS: has_base = true; break;
+            case IMAGE_SIZE: has_size = true; break;
+            case IMAGE_NAME: has_name = true; break;
+            case IMAGE_CODE_TYPE: {
+                const uint8_t *cp = field.data;
+                pb_field_t cfield;
+                while (pb_next(&cp, field.data + field.length, &cfield, &error)) {
+                    if (cfield.number == PROCESSOR_ENCODING)
+                        CHECK(cfield.value == ENCODING_ELF, "image code type encoding is %llu", (unsigned long long) cfield.value);
+                }
+                break;
+            }
+        }
+    }
+
+    CHECK(!error, "malformed binary image");
+    CHECK(has_base && has_size && has_name, "binary image is missing a required field");
+    return true;
+}
+
+static bool validate_thread (const pb_field_t *thread, uint32_t image_count, uint32_t thread_count, bool *crashed,
+                             report_stats_t *stats)
+{
+    const uint8_t *p = thread->data;
+    const uint8_t *end = thread->data + thread->length;
+    pb_field_t field;
+    bool error = false;
+    bool has_number = false, has_crashed = false, has_frames = false;
+    uint32_t register_set = 0, register_count = 0;
+    uint32_t frame_count = 0;
+    uint32_t count;
+
+    *crashed = false;
+    while (pb_next(&p, end, &field, &error)) {
+        switch (field.number) {
+            case THREAD_NUMBER:
+                CHECK(field.value == thread_count, "thread number %llu, expected %u", (unsigned long long) field.value, thread_count);
+                has_number = true;
+                break;
+
+            case THREAD_CRASHED:
+                *crashed = field.value != 0;
+                has_crashed = true;
+                break;
+
+            case THREAD_PCS:
+                CHECK(pb_packed_count(&field, &count), "malformed pcs");
+                frame_count += count;
+                has_frames = true;
+                break;
+
+            case THREAD_IMAGE_RELATIVE_PCS: {
+                const uint8_t *rp = field.data;
+                const uint8_t *rend = field.data + field.length;
+                uint64_t index, delta;
+
+                while (rp < rend) {
+                    CHECK(pb_varint(&rp, rend, &index) && pb_varint(&rp, rend, &delta), "malformed image relative pcs");
+                    CHECK(index == 0 || index - 1 < image_count, "image index %llu exceeds the %u written images",
+                          (unsigned long long) index, image_count);
+                    frame_count++;
+                }
+                has_frames = true;
+                break;
+            }
+
+            case THREAD_INTERNED_STACK:
+                CHECK(field.value < thread_count, "interned stack references thread %llu", (unsigned long long) field.value);
+                stats->interned_count++;
+                has_frames = true;
+                break;
+
+            case THREAD_REGISTER_SET:
+                register_set = (uint32_t) field.value;
+                break;
+
+            case THREAD_REGISTER_VALUES:
+                CHECK(pb_packed_count(&field, &register_count), "malformed register values");
+                break;
+        }
+    }
+
+    CHECK(!error, "malformed thread");
+    CHECK(has_number && has_crashed, "thread is missing a required field");
+    CHECK(has_frames, "thread %u has no backtrace", thread_count);
+    stats->frame_count += frame_count;
+
+    /* The crashed thread's backtrace includes at least crash() and a caller; crash() is a leaf, and may not have a
+     * frame of its own */
+    if (*crashed) {
+        CHECK(frame_count >= 2, "crashed thread has %u frames", frame_count);
+        CHECK(register_set == REGISTER_SET_X86_64, "crashed thread register set is %u", register_set);
+        CHECK(register_count > 0, "crashed thread has no register values");
+    }
+
+    return true;
+}
+
+static bool validate_report (const uint8_t *msg, size_t len, report_stats_t *stats) {
+    const uint8_t *p;
+    const uint8_t *end = msg + len;
+    pb_field_t field;
+    bool error = false;
+    bool has_system = false, has_app = false, has_signal = false;
+    uint32_t crashed_count = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->length = len;
+
+    /* Binary images are written prior to the threads; count them first, so that image indices can be checked */
+    p = msg;
+    while (pb_next(&p, end, &field, &error)) {
+        if (field.number == REPORT_BINARY_IMAGES) {
+            if (!validate_image(&field))
+                return false;
+            stats->image_count++;
+        }
+    }
+    CHECK(!error, "malformed report");
+    CHECK(stats->image_count > 0, "no binary images were written");
+
+    p = msg;
+    while (pb_next(&p, end, &field, &error)) {
+        switch (field.number) {
+            case REPORT_SYSTEM_INFO: has_system = true; break;
+            case REPORT_APPLICATION_INFO: has_app = true; break;
+
+            case REPORT_THREADS: {
+                bool crashed;
+                if (!validate_thread(&field, stats->image_count, stats->thread_count, &crashed, stats))
+                    return false;
+                if (crashed)
+                    crashed_count++;
+                stats->thread_count++;
+                break;
+            }
+
+            case REPORT_SIGNAL: {
+                const uint8_t *sp = field.data;
+                pb_field_t sfield;
+                bool has_name = false, has_code = false;
+
+                while (pb_next(&sp, field.data + field.length, &sfield, &error)) {
+                    if (sfield.number == SIGNAL_NAME) {
+                        CHECK(pb_string_equal(&sfield, "SIGSEGV"), "signal name is '%.*s'", (int) sfield.length, sfield.data);
+                        has_name = true;
+                    } else if (sfield.number == SIGNAL_CODE) {
+                        CHECK(pb_string_equal(&sfield, "SEGV_MAPERR"), "signal code is '%.*s'", (int) sfield.length, sfield.data);
+                        has_code = true;
+                    }
+                }
+                CHECK(has_name && has_code, "signal is missing a required field");
+                has_signal = true;
+                break;
+            }
+
+            case REPORT_MACHINE_INFO: {
+                const uint8_t *mp = field.data;
+                pb_field_t mfield;
+
+                while (pb_next(&mp, field.data + field.length, &mfield, &error)) {
+                    if (mfield.number != MACHINE_PROCESSOR)
+                        continue;
+
+                    const uint8_t *cp = mfield.data;
+                    pb_field_t cfield;
+                    while (pb_next(&cp, mfield.data + mfield.length, &cfield, &error)) {
+                        if (cfield.number == PROCESSOR_ENCODING)
+                            CHECK(cfield.value == ENCODING_ELF, "processor encoding is %llu", (unsigned long long) cfield.value);
+                        else if (cfield.number == PROCESSOR_TYPE)
+                            CHECK(cfield.value == EM_X86_64, "processor type is %llu", (unsigned long long) cfield.value);
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    CHECK(!error, "malformed report");
+    CHECK(has_system && has_app && has_signal, "report is missing a required field");
+    CHECK(crashed_count == 1, "%u crashed threads", crashed_count);
+    CHECK(stats->thread_count >= TEST_THREAD_COUNT + 1, "only %u threads were written", stats->thread_count);
+
+    return true;
+}
+
+/* Strip the file header, decompressing the message if required. */
+static bool decode_file (const uint8_t *data, size_t len, const uint8_t **msg, size_t *msg_len) {
+    const struct PLCrashReportFileHeader *header = (const struct PLCrashReportFileHeader *) data;
+    size_t header_len = sizeof(struct PLCrashReportFileHeader);
+
+    CHECK(len >= header_len, "report is truncated");
+    CHECK(memcmp(header->magic, PLCRASH_REPORT_FILE_MAGIC, sizeof(header->magic)) == 0, "bad file magic");
+
+    if (header->version == PLCRASH_REPORT_FILE_VERSION) {
+        *msg = data + header_len;
+        *msg_len = len - header_len;
+        return true;
+    }
+
+    CHECK(header->version == PLCRASH_REPORT_FILE_VERSION_COMPRESSED, "unknown file version %u", header->version);
+    CHECK(len >= header_len + 4, "compressed report is truncated");
+
+    const uint8_t *p = data + header_len;
+    size_t expected = p[0] | (p[1] << 8) | (p[2] << 16) | ((size_t) p[3] << 24);
+    size_t decoded;
+
+    CHECK(expected <= sizeof(message_buffer), "uncompressed length %zu is too large", expected);
+    CHECK(plcrash_async_lz_decompress(p + 4, len - header_len - 4, message_buffer, expected, &decoded) == PLCRASH_ESUCCESS,
+          "decompression failed");
+    CHECK(decoded == expected, "decompressed %zu bytes, expected %zu", decoded, expected);
+
+    *msg = message_buffer;
+    *msg_len = decoded;
+    return true;
+}
+
+static bool run_mode (const harness_mode_t *mode, int iterations, const char *outdir) {
+    report_stats_t stats;
+    double total_us = 0, min_us = 0;
+    const uint8_t *msg = NULL;
+    size_t msg_len = 0;
+    ssize_t len = 0;
+    plcrash_error_t err;
+
+    plcrash_log_writer_set_options(&writer, mode->options);
+
+    for (int i = 0; i < iterations; i++) {
+        if (ftruncate(report_fd, 0) != 0 || lseek(report_fd, 0, SEEK_SET) != 0) {
+            perror("ftruncate");
+            return false;
+        }
+
+        if ((err = write_report()) != PLCRASH_ESUCCESS) {
+            fprintf(stderr, "%s: plcrash_log_writer_write() failed: %d\n", mode->name, err);
+            return false;
+        }
+
+        double us = elapsed_us(&crash_start, &crash_end);
+        total_us += us;
+        if (i == 0 || us < min_us)
+            min_us = us;
+
+        len = pread(report_fd, report_buffer, sizeof(report_buffer), 0);
+        if (len <= 0) {
+            fprintf(stderr, "%s: could not read the report\n", mode->name);
+            return false;
+        }
+
+        if (!decode_file(report_buffer, (size_t) len, &msg, &msg_len) || !validate_report(msg, msg_len, &stats)) {
+            fprintf(stderr, "%s: iteration %d failed to validate\n", mode->name, i);
+            return false;
+        }
+    }
+
+    printf("%-10s file %6zd bytes, message %6zu bytes, %2u threads (%u interned), %4u frames, %3u images; "
+           "write mean %7.1f us, min %7.1f us\n",
+           mode->name, len, stats.length, stats.thread_count, stats.interned_count, stats.frame_count,
+           stats.image_count, total_us / iterations, min_us);
+
+    if (outdir != NULL) {
+        char path[1024];
+        FILE *out;
+
+        snprintf(path, sizeof(path), "%s/%s.pb", outdir, mode->name);
+        if ((out = fopen(path, "wb")) == NULL || fwrite(msg, 1, msg_len, out) != msg_len) {
+            perror(path);
+            return false;
+        }
+        fclose(out);
+    }
+
+    return true;
+}
+
+int main (int argc, char *argv[]) {
+    static const harness_mode_t modes[] = {
+        { "plain", 0 },
+        { "relative", PLCRASH_LOG_WRITER_OPTION_IMAGE_RELATIVE_FRAMES },
+        { "compressed", PLCRASH_LOG_WRITER_OPTION_IMAGE_RELATIVE_FRAMES | PLCRASH_LOG_WRITER_OPTION_COMPRESS },
+    };
+    plframe_test_thead_t threads[TEST_THREAD_COUNT];
+    char report_path[] = "/tmp/plcrash-harness-XXXXXX";
+    int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    const char *outdir = argc > 2 ? argv[2] : NULL;
+    bool ok = true;
+    plcrash_error_t err;
+
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: %s [iterations] [output directory]\n", argv[0]);
+        return 2;
+    }
+
+    if ((err = plcrash_log_writer_init_c(&writer, "com.example.harness", "1.0")) != PLCRASH_ESUCCESS) {
+        fprintf(stderr, "plcrash_log_writer_init_c() failed: %d\n", err);
+        return 1;
+    }
+
+    if ((err = plcrash_log_writer_update_images(&writer)) != PLCRASH_ESUCCESS) {
+        fprintf(stderr, "plcrash_log_writer_update_images() failed: %d\n", err);
+        return 1;
+    }
+
+    if ((report_fd = mkstemp(report_path)) < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    unlink(report_path);
+
+    /* The report is written on an alternate signal stack, as it would be for a stack overflow */
+    stack_t ss;
+    ss.ss_sp = malloc(SIGSTKSZ * 4);
+    ss.ss_size = SIGSTKSZ * 4;
+    ss.ss_flags = 0;
+    if (ss.ss_sp == NULL || sigaltstack(&ss, NULL) != 0) {
+        perror("sigaltstack");
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = crash_handler;
+    sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGSEGV, &sa, NULL) != 0) {
+        perror("sigaction");
+        return 1;
+    }
+
+    /* Threads of equal depth share a backtrace, and are interned */
+    for (int i = 0; i < TEST_THREAD_COUNT; i++)
+        plframe_test_thread_spawn_depth(&threads[i], i % TEST_THREAD_DEPTHS);
+
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]) && ok; i++)
+        ok = run_mode(&modes[i], iterations, outdir);
+
+    for (int i = 0; i < TEST_THREAD_COUNT; i++)
+        plframe_test_thread_stop(&threads[i]);
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+    close(report_fd);
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
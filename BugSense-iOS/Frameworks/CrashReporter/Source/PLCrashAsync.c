@@ -31,6 +31,9 @@
 #import <stdint.h>
 #import <errno.h>
 #import <string.h>
+#import <assert.h>
+#import <sys/mman.h>
+#import <sys/uio.h>
 
 /**
  * @internal
@@ -123,6 +126,41 @@ static ssize_t writen (int fd, const void *data, size_t len) {
     return written;
 }
 
+/**
+ * @internal
+ *
+ * Write all bytes referenced by @a iov to @a fd, retrying on EINTR and partial writes. The contents of
+ * @a iov will be modified.
+ */
+static bool writevn (int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, iov, iovcnt);
+        if (written <= 0) {
+            if (errno == EINTR) {
+                // Try again
+                continue;
+            } else {
+                PLCF_DEBUG("Error occured writing to crash log: %s", strerror(errno));
+                return false;
+            }
+        }
+
+        /* Skip any fully written segments, and advance into a partially written segment */
+        while (iovcnt > 0 && (size_t) written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return true;
+}
+
 
 /**
  * Initialize the plcrash_async_file_t instance.
@@ -138,64 +176,318 @@ void plcrash_async_file_init (plcrash_async_file_t *file, int fd, off_t output_l
     file->buflen = 0;
     file->total_bytes = 0;
     file->limit_bytes = output_limit;
+    file->mem = NULL;
+    file->iovcnt = 0;
+    file->queued_bytes = 0;
+    file->buffer = file->default_buffer;
+    file->bufsize = sizeof(file->default_buffer);
+
+    /* Record the starting offset; previously written data may be patched relative to this offset via
+     * plcrash_async_file_pwrite(). */
+    file->base_offset = lseek(fd, 0, SEEK_CUR);
+    if (file->base_offset == -1)
+        file->base_offset = 0;
+}
+
+
+/**
+ * Initialize the plcrash_async_file_t instance to write to a memory buffer, rather than a file descriptor.
+ * Once @a size bytes have been written, all further data will be dropped.
+ *
+ * @param file File structure to initialize.
+ * @param buffer The output buffer.
+ * @param size The size of @a buffer, in bytes.
+ */
+void plcrash_async_file_init_mem (plcrash_async_file_t *file, void *buffer, size_t size) {
+    file->fd = -1;
+    file->buflen = 0;
+    file->total_bytes = 0;
+    file->base_offset = 0;
+    file->limit_bytes = size;
+    file->mem = buffer;
+    file->iovcnt = 0;
+    file->queued_bytes = 0;
+    file->buffer = file->default_buffer;
+    file->bufsize = sizeof(file->default_buffer);
+}
+
+
+/**
+ * Initialize the plcrash_async_file_t instance to write to a shared, writable memory mapping of @a fd. All output
+ * is copied directly to the mapping; when the file is closed, the mapping is synchronized and the file is truncated
+ * to the length of the written data.
+ *
+ * @param file File structure to initialize.
+ * @param fd Open file descriptor, of at least @a size bytes.
+ * @param mapping A MAP_SHARED mapping of @a fd, starting at offset 0.
+ * @param size The size of @a mapping, in bytes. No more than @a size bytes will be written.
+ *
+ * @note The mapping is owned by the caller, and will not be unmapped by plcrash_async_file_close().
+ */
+void plcrash_async_file_init_mapped (plcrash_async_file_t *file, int fd, void *mapping, size_t size) {
+    plcrash_async_file_init_mem(file, mapping, size);
+    file->fd = fd;
+}
+
+
+/**
+ * Replace the file's embedded PLCRASH_ASYNC_FILE_DEFAULT_BUFFER_SIZE output buffer with @a buffer. Buffered output
+ * is only flushed once the buffer fills (or the file is closed), so a buffer large enough to hold a complete crash
+ * report allows the report to be written with a single flush.
+ *
+ * This must be called prior to writing any data to @a file. The buffer should be allocated in advance (eg, when the
+ * crash reporter is enabled) so as to avoid allocation or stack growth within a signal handler.
+ *
+ * @param file The file instance.
+ * @param buffer The output buffer. This must remain valid until the file is closed.
+ * @param size The size of @a buffer, in bytes.
+ */
+void plcrash_async_file_set_buffer (plcrash_async_file_t *file, void *buffer, size_t size) {
+    assert(file->buflen == 0 && file->iovcnt == 0);
+
+    file->buffer = buffer;
+    file->bufsize = size;
 }
 
 
+/**
+ * @internal
+ *
+ * Slow path for plcrash_async_file_reserve(); flushes the output buffer and starts a new buffer segment
+ * as required.
+ */
+uint8_t *plcrash_async_file_reserve_slow (plcrash_async_file_t *file, size_t len) {
+    /* Check output limit */
+    if (file->limit_bytes != 0 && (off_t) len > file->limit_bytes - file->total_bytes) {
+        return NULL;
+    }
+
+    /* Check if the buffer will fill */
+    if (file->buflen + len > file->bufsize) {
+        if (!plcrash_async_file_flush(file))
+            return NULL;
+
+        if (len > file->bufsize)
+            return NULL;
+    }
+
+    /* Start a new segment if the last segment does not end at the current buffer position */
+    uint8_t *dest = (uint8_t *) file->buffer + file->buflen;
+    struct iovec *last = file->iovcnt > 0 ? &file->iov[file->iovcnt - 1] : NULL;
+
+    if (last == NULL || (uint8_t *) last->iov_base + last->iov_len != dest) {
+        if (file->iovcnt == PLCRASH_ASYNC_FILE_IOV_MAX) {
+            if (!plcrash_async_file_flush(file))
+                return NULL;
+            dest = (uint8_t *) file->buffer;
+        }
+
+        last = &file->iov[file->iovcnt++];
+        last->iov_base = dest;
+        last->iov_len = 0;
+    }
+
+    return dest;
+}
+
 /**
  * Write all bytes from @a data to the file buffer. Returns true on success,
  * or false if an error occurs.
  */
 bool plcrash_async_file_write (plcrash_async_file_t *file, const void *data, size_t len) {
-    /* Check and update output limit */
-    if (file->limit_bytes != 0 && len + file->total_bytes > file->limit_bytes) {
-        return false;
-    } else if (file->limit_bytes != 0) {
+    uint8_t *dest;
+
+    /* Writes larger than the buffer are written directly */
+    if (file->mem == NULL && len > file->bufsize) {
+        /* Check and update output limit */
+        if (file->limit_bytes != 0 && (off_t) len > file->limit_bytes - file->total_bytes) {
+            return false;
+        }
+
+        if (!plcrash_async_file_flush(file))
+            return false;
+
+        if (writen(file->fd, data, len) < 0) {
+            return false;
+        }
+
         file->total_bytes += len;
+        return true;
     }
 
-    /* Check if the buffer will fill */
-    if (file->buflen + len > sizeof(file->buffer)) {
-        /* Flush the buffer */
-        if (writen(file->fd, file->buffer, file->buflen) < 0) {
+    /* Buffer the data */
+    if ((dest = plcrash_async_file_reserve(file, len)) == NULL)
+        return false;
+
+    plcrash_async_memcpy(dest, data, len);
+    plcrash_async_file_commit(file, len);
+
+    return true;
+}
+
+/**
+ * Queue @a data for output by reference, without copying it to the file buffer. The data will be written
+ * with a single writev() call alongside any other queued output when the file is next flushed. Returns true
+ * on success, or false if an error occurs.
+ *
+ * Data smaller than PLCRASH_ASYNC_FILE_REF_MIN is copied, as with plcrash_async_file_write().
+ *
+ * @param file The output file.
+ * @param data The data to be written. This must remain valid and unmodified until the file is flushed or closed.
+ * @param len The length of @a data, in bytes.
+ */
+bool plcrash_async_file_write_ref (plcrash_async_file_t *file, const void *data, size_t len) {
+    /* Memory targets and small writes are copied */
+    if (file->mem != NULL || len < PLCRASH_ASYNC_FILE_REF_MIN)
+        return plcrash_async_file_write(file, data, len);
+
+    /* Check the output limit */
+    if (file->limit_bytes != 0 && (off_t) len > file->limit_bytes - file->total_bytes) {
+        return false;
+    }
+
+    /* Queue the segment. The output offset is only advanced once the segment has been queued. */
+    if (file->iovcnt == PLCRASH_ASYNC_FILE_IOV_MAX) {
+        if (!plcrash_async_file_flush(file))
             return false;
-        }
-        
-        file->buflen = 0;
     }
-    
-    /* Check if the new data fits within the buffer, if so, buffer it */
-    if (len + file->buflen <= sizeof(file->buffer)) {
-        plcrash_async_memcpy(file->buffer + file->buflen, data, len);
-        file->buflen += len;
-        
+
+    file->iov[file->iovcnt].iov_base = (void *) data;
+    file->iov[file->iovcnt].iov_len = len;
+    file->iovcnt++;
+    file->queued_bytes += len;
+    file->total_bytes += len;
+
+    return true;
+}
+
+
+/**
+ * Overwrite @a len bytes of previously written data, starting at @a offset. Returns true on success,
+ * or false if an error occurs.
+ *
+ * The replaced range must have already been written via plcrash_async_file_write(); this may be used to
+ * back-patch fixed-width values (such as message length prefixes) once their value is known. Bytes that
+ * are still buffered are patched in place, and only already flushed bytes require seeking the
+ * underlying file descriptor.
+ *
+ * @param file The file to be patched.
+ * @param offset The output offset, as returned by plcrash_async_file_offset(), at which to begin writing.
+ * @param data The replacement data.
+ * @param len The number of bytes to be written.
+ */
+bool plcrash_async_file_pwrite (plcrash_async_file_t *file, off_t offset, const void *data, size_t len) {
+    const uint8_t *p = data;
+    off_t flushed = file->total_bytes - file->queued_bytes;
+
+    /* Only previously written data may be replaced */
+    if (offset < 0 || offset + (off_t) len > file->total_bytes)
+        return false;
+
+    /* Memory targets may be patched directly */
+    if (file->mem != NULL) {
+        plcrash_async_memcpy(file->mem + offset, data, len);
         return true;
-        
-    } else {
-        /* Won't fit in the buffer, just write it */
-        if (writen(file->fd, data, len) < 0) {
+    }
+
+    /* Patch any bytes that have already been flushed to disk */
+    if (offset < flushed) {
+        size_t nflushed = len;
+        if (offset + (off_t) nflushed > flushed)
+            nflushed = flushed - offset;
+
+        if (lseek(file->fd, file->base_offset + offset, SEEK_SET) == -1) {
+            PLCF_DEBUG("Error seeking in crash log: %s", strerror(errno));
             return false;
         }
-        
-        return true;
-    } 
+
+        ssize_t written = writen(file->fd, p, nflushed);
+
+        /* Restore the output position prior to checking for write errors */
+        if (lseek(file->fd, file->base_offset + flushed, SEEK_SET) == -1) {
+            PLCF_DEBUG("Error seeking in crash log: %s", strerror(errno));
+            return false;
+        }
+
+        if (written < 0)
+            return false;
+
+        p += nflushed;
+        offset += nflushed;
+        len -= nflushed;
+    }
+
+    /* Patch the remainder in the queued segments. Only buffered segments may be modified. */
+    off_t seg_offset = flushed;
+    for (int i = 0; i < file->iovcnt && len > 0; i++) {
+        struct iovec *seg = &file->iov[i];
+        off_t seg_end = seg_offset + seg->iov_len;
+
+        if (offset < seg_end) {
+            size_t n = len;
+            if (offset + (off_t) n > seg_end)
+                n = seg_end - offset;
+
+            if ((char *) seg->iov_base < file->buffer || (char *) seg->iov_base >= file->buffer + file->bufsize) {
+                PLCF_DEBUG("Attempted to patch data queued by reference");
+                return false;
+            }
+
+            plcrash_async_memcpy((uint8_t *) seg->iov_base + (offset - seg_offset), p, n);
+            p += n;
+            offset += n;
+            len -= n;
+        }
+
+        seg_offset = seg_end;
+    }
+
+    return true;
+}
+
+/**
+ * Return the current output offset; this is the total number of bytes written to @a file, including
+ * any bytes that are still buffered.
+ */
+off_t plcrash_async_file_offset (plcrash_async_file_t *file) {
+    return file->total_bytes;
+}
+
+/**
+ * Return the number of bytes that may be written to @a file before its output limit is reached, or SIZE_MAX
+ * if the file has no output limit.
+ */
+size_t plcrash_async_file_remaining (plcrash_async_file_t *file) {
+    /* A limit of 0 disables the limit for file descriptor targets; memory targets are always limited */
+    if (file->limit_bytes == 0 && file->mem == NULL)
+        return SIZE_MAX;
+
+    if (file->total_bytes >= file->limit_bytes)
+        return 0;
+
+    return file->limit_bytes - file->total_bytes;
 }
 
 
 /**
- * Flush all buffered bytes from the file buffer.
+ * Flush all buffered and queued bytes to the output file.
  */
 bool plcrash_async_file_flush (plcrash_async_file_t *file) {
     /* Anything to do? */
-    if (file->buflen == 0)
+    if (file->queued_bytes == 0 || file->mem != NULL) {
+        file->buflen = 0;
+        file->iovcnt = 0;
         return true;
+    }
     
-    /* Write remaining */
-    if (writen(file->fd, file->buffer, file->buflen) < 0)
-        return false;
-    
+    /* Write all queued segments */
+    bool ret = writevn(file->fd, file->iov, file->iovcnt);
+
     file->buflen = 0;
+    file->iovcnt = 0;
+    file->queued_bytes = 0;
     
-    return true;
+    return ret;
 }
 
 
@@ -207,6 +499,19 @@ bool plcrash_async_file_close (plcrash_async_file_t *file) {
     if (!plcrash_async_file_flush(file))
         return false;
 
+    /* Memory targets have no backing file descriptor */
+    if (file->fd < 0)
+        return true;
+
+    /* Commit mapped output, and discard any unused space at the end of the file */
+    if (file->mem != NULL) {
+        if (file->total_bytes > 0 && msync(file->mem, file->total_bytes, MS_SYNC) != 0)
+            PLCF_DEBUG("Error synchronizing mapped file: %s", strerror(errno));
+
+        if (ftruncate(file->fd, file->total_bytes) != 0)
+            PLCF_DEBUG("Error truncating mapped file: %s", strerror(errno));
+    }
+
     /* Close the file descriptor */
     if (close(file->fd) != 0) {
         PLCF_DEBUG("Error closing file: %s", strerror(errno));
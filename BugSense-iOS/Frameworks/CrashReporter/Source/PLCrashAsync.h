@@ -28,8 +28,11 @@
 
 
 #import <stdio.h> // for snprintf
+#import <string.h> // for strlen
 #import <unistd.h>
 #import <stdbool.h>
+#import <stdint.h>
+#import <sys/uio.h>
 
 // Debug output support. Lines are capped at 128 (stack space is scarce). This implemention
 // is not async-safe and should not be enabled in release builds
@@ -79,6 +82,32 @@ const char *plcrash_strerror (plcrash_error_t error);
 
 void *plcrash_async_memcpy(void *dest, const void *source, size_t n);
 
+/**
+ * @internal
+ * @ingroup plcrash_async_bufio
+ *
+ * Size of the output buffer embedded in plcrash_async_file_t. A larger buffer may be supplied via
+ * plcrash_async_file_set_buffer().
+ */
+#define PLCRASH_ASYNC_FILE_DEFAULT_BUFFER_SIZE 256
+
+/**
+ * @internal
+ * @ingroup plcrash_async_bufio
+ *
+ * Maximum number of output segments that may be queued by a plcrash_async_file_t prior to flushing.
+ */
+#define PLCRASH_ASYNC_FILE_IOV_MAX 16
+
+/**
+ * @internal
+ * @ingroup plcrash_async_bufio
+ *
+ * Minimum length of data that will be queued by reference via plcrash_async_file_write_ref(). Smaller writes
+ * are copied to the output buffer, as the additional segment would cost more than the copy.
+ */
+#define PLCRASH_ASYNC_FILE_REF_MIN 64
+
 /**
  * @internal
  * @ingroup plcrash_async_bufio
@@ -93,18 +122,99 @@ typedef struct plcrash_async_file {
     /** Output limit */
     off_t limit_bytes;
 
-    /** Total bytes written */
+    /** Total bytes written. This is also the current output offset, relative to base_offset. */
     off_t total_bytes;
 
+    /** The file descriptor's offset at initialization time. Output offsets are relative to this value. */
+    off_t base_offset;
+
+    /** Memory output target, or NULL if output is written to fd. If non-NULL, limit_bytes specifies the
+     * size of the memory target, and all output is copied directly to the target. If fd is also valid, the
+     * target is a shared mapping of fd. */
+    uint8_t *mem;
+
+    /** Output buffer. This is either default_buffer, or a buffer supplied via plcrash_async_file_set_buffer(). */
+    char *buffer;
+
+    /** Size of the output buffer, in bytes */
+    size_t bufsize;
+
     /** Current length of data in buffer */
     size_t buflen;
 
-    /** Buffered output */
-    char buffer[256];
+    /** Queued output segments, in output order. Each segment references either the buffer, or caller-owned
+     * data queued via plcrash_async_file_write_ref(). All segments are written with a single writev() on flush. */
+    struct iovec iov[PLCRASH_ASYNC_FILE_IOV_MAX];
+
+    /** Number of queued segments */
+    int iovcnt;
+
+    /** Total length of all queued segments, in bytes */
+    size_t queued_bytes;
+
+    /** Default output buffer */
+    char default_buffer[PLCRASH_ASYNC_FILE_DEFAULT_BUFFER_SIZE];
 } plcrash_async_file_t;
 
 
 void plcrash_async_file_init (plcrash_async_file_t *file, int fd, off_t output_limit);
+void plcrash_async_file_init_mem (plcrash_async_file_t *file, void *buffer, size_t size);
+void plcrash_async_file_init_mapped (plcrash_async_file_t *file, int fd, void *mapping, size_t size);
+void plcrash_async_file_set_buffer (plcrash_async_file_t *file, void *buffer, size_t size);
 bool plcrash_async_file_write (plcrash_async_file_t *file, const void *data, size_t len);
+bool plcrash_async_file_write_ref (plcrash_async_file_t *file, const void *data, size_t len);
+bool plcrash_async_file_pwrite (plcrash_async_file_t *file, off_t offset, const void *data, size_t len);
+off_t plcrash_async_file_offset (plcrash_async_file_t *file);
+size_t plcrash_async_file_remaining (plcrash_async_file_t *file);
 bool plcrash_async_file_flush (plcrash_async_file_t *file);
 bool plcrash_async_file_close (plcrash_async_file_t *file);
+
+uint8_t *plcrash_async_file_reserve_slow (plcrash_async_file_t *file, size_t len);
+
+/**
+ * Reserve @a len bytes of output space, allowing data to be encoded directly into the output buffer. The
+ * reserved bytes must be committed via plcrash_async_file_commit() prior to any further output.
+ *
+ * @param file The output file.
+ * @param len The number of bytes to reserve. For file descriptor targets, this must not exceed the size of the
+ * file's active output buffer (PLCRASH_ASYNC_FILE_DEFAULT_BUFFER_SIZE, or the size supplied to
+ * plcrash_async_file_set_buffer()); larger reservations fail.
+ *
+ * @return Returns a pointer to the reserved bytes, or NULL if the output limit would be exceeded, @a len exceeds
+ * the output buffer size, or the buffer could not be flushed.
+ */
+static inline uint8_t *plcrash_async_file_reserve (plcrash_async_file_t *file, size_t len) {
+    /* Memory targets are written in place */
+    if (file->mem != NULL) {
+        if ((off_t) len > file->limit_bytes - file->total_bytes)
+            return NULL;
+        return file->mem + file->total_bytes;
+    }
+
+    /* Fast path: the data fits in the buffer, and extends the last queued segment */
+    uint8_t *dest = (uint8_t *) file->buffer + file->buflen;
+    if (file->buflen + len <= file->bufsize && file->iovcnt > 0 &&
+        (uint8_t *) file->iov[file->iovcnt - 1].iov_base + file->iov[file->iovcnt - 1].iov_len == dest &&
+        (file->limit_bytes == 0 || (off_t) len <= file->limit_bytes - file->total_bytes))
+    {
+        return dest;
+    }
+
+    return plcrash_async_file_reserve_slow(file, len);
+}
+
+/**
+ * Commit @a len bytes previously reserved via plcrash_async_file_reserve().
+ *
+ * @param file The output file.
+ * @param len The number of bytes written to the reserved space. Must not exceed the reserved length.
+ */
+static inline void plcrash_async_file_commit (plcrash_async_file_t *file, size_t len) {
+    file->total_bytes += len;
+
+    if (file->mem == NULL) {
+        file->buflen += len;
+        file->iov[file->iovcnt - 1].iov_len += len;
+        file->queued_bytes += len;
+    }
+}
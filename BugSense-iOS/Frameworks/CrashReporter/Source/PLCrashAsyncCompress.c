@@ -0,0 +1,373 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#import "PLCrashAsyncCompress.h"
+
+#import <stdbool.h>
+
+/**
+ * @internal
+ * @ingroup plcrash_async
+ * @defgroup plcrash_async_compress Async-safe Compression
+ *
+ * Implements async-safe, allocation-free LZ77 compression of crash report data. Output uses the LZ4 block
+ * format: a sequence of (token, literal length, literals, match offset, match length) tuples, where the
+ * token holds the 4-bit literal and match lengths, and longer lengths are extended with additional bytes.
+ * @{
+ */
+
+/** Minimum match length. */
+#define LZ_MIN_MATCH 4
+
+/** Maximum match offset. */
+#define LZ_MAX_OFFSET 65535
+
+/** The final bytes of the input that are always encoded as literals, as required by the LZ4 block format. */
+#define LZ_LAST_LITERALS 5
+
+/** The final bytes of the input within which no match may start, as required by the LZ4 block format. */
+#define LZ_MATCH_LIMIT 12
+
+/** Fetch a (possibly unaligned) 32-bit value. */
+static inline uint32_t lz_read32 (const uint8_t *p) {
+    uint32_t v;
+    __builtin_memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/** Fetch a (possibly unaligned) 64-bit value. */
+static inline uint64_t lz_read64 (const uint8_t *p) {
+    uint64_t v;
+    __builtin_memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/** Hash a 4 byte sequence to a match table index. */
+static inline uint32_t lz_hash (uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - PLCRASH_ASYNC_LZ_HASH_BITS);
+}
+
+/**
+ * Write an extended length, as a run of 255 bytes terminated by the remainder.
+ *
+ * @param file Output file. May be NULL, in which case only @a size is updated.
+ * @param size The number of bytes written will be added to this value.
+ * @param len The length to be written.
+ */
+static bool lz_write_length (plcrash_async_file_t *file, size_t *size, size_t len) {
+    *size += len / 255 + 1;
+    if (file == NULL)
+        return true;
+
+    while (true) {
+        size_t n = len / 255 + 1;
+        uint8_t *out;
+
+        if (n > 64)
+            n = 64;
+
+        if ((out = plcrash_async_file_reserve(file, n)) == NULL)
+            return false;
+
+        for (size_t i = 0; i < n; i++) {
+            if (len < 255) {
+                out[i] = len;
+                plcrash_async_file_commit(file, i + 1);
+                return true;
+            }
+
+            out[i] = 255;
+            len -= 255;
+        }
+        plcrash_async_file_commit(file, n);
+    }
+}
+
+/**
+ * Write a single sequence.
+ *
+ * @param file Output file. May be NULL, in which case only @a size is updated.
+ * @param size The number of bytes written will be added to this value.
+ * @param literals The sequence's literal bytes.
+ * @param literal_len The number of literal bytes.
+ * @param offset The match offset. Ignored if @a last is true.
+ * @param match_len The match length, less LZ_MIN_MATCH. Ignored if @a last is true.
+ * @param last If true, this is the final sequence, and contains no match.
+ */
+static bool lz_write_sequence (plcrash_async_file_t *file, size_t *size, const uint8_t *literals, size_t literal_len,
+                               size_t offset, size_t match_len, bool last)
+{
+    uint8_t *out;
+
+    /* Size the sequence */
+    if (file == NULL) {
+        *size += 1 + literal_len;
+        if (literal_len >= 15)
+            lz_write_length(NULL, size, literal_len - 15);
+
+        if (!last) {
+            *size += 2;
+            if (match_len >= 15)
+                lz_write_length(NULL, size, match_len - 15);
+        }
+
+        return true;
+    }
+
+    /* Token */
+    if ((out = plcrash_async_file_reserve(file, 1)) == NULL)
+        return false;
+    
+    out[0] = (literal_len >= 15 ? 15 : literal_len) << 4;
+    if (!last)
+        out[0] |= (match_len >= 15 ? 15 : match_len);
+    plcrash_async_file_commit(file, 1);
+
+    /* Literals. These are queued by reference where possible. */
+    *size += 1;
+    if (literal_len >= 15 && !lz_write_length(file, size, literal_len - 15))
+        return false;
+
+    if (literal_len > 0 && !plcrash_async_file_write_ref(file, literals, literal_len))
+        return false;
+    *size += literal_len;
+
+    if (last)
+        return true;
+
+    /* Match */
+    if ((out = plcrash_async_file_reserve(file, 2)) == NULL)
+        return false;
+
+    out[0] = offset & 0xFF;
+    out[1] = offset >> 8;
+    plcrash_async_file_commit(file, 2);
+    *size += 2;
+
+    if (match_len >= 15 && !lz_write_length(file, size, match_len - 15))
+        return false;
+
+    return true;
+}
+
+/**
+ * Compress @a len bytes of @a data to @a file, or only compute the compressed size if @a file is NULL.
+ *
+ * @param state Compressor state. This will be reset prior to use.
+ * @param file Output file. May be NULL.
+ * @param size The number of compressed bytes will be added to this value.
+ * @param data The data to be compressed.
+ * @param len The length of @a data, in bytes. Must be less than 4GB.
+ */
+static plcrash_error_t lz_compress (plcrash_async_lz_state_t *state, plcrash_async_file_t *file, size_t *size, const void *data, size_t len) {
+    const uint8_t *base = data;
+    const uint8_t *end = base + len;
+    const uint8_t *anchor = base;
+    const uint8_t *ip = base;
+
+    /* Reset the match table. Stale entries could reference positions past the end of the input; reset entries
+     * reference the first input position, and are rejected by the match check below if they do not match. */
+    for (size_t i = 0; i < sizeof(state->table) / sizeof(state->table[0]); i++)
+        state->table[i] = 0;
+
+    /* Inputs too short to contain a match are written as literals */
+    if (len > LZ_MATCH_LIMIT) {
+        const uint8_t *match_start_limit = end - LZ_MATCH_LIMIT;
+        const uint8_t *match_end_limit = end - LZ_LAST_LITERALS;
+
+        /* The first position can not be matched */
+        ip++;
+
+        while (ip < match_start_limit) {
+            uint32_t sequence = lz_read32(ip);
+            uint32_t hash = lz_hash(sequence);
+            const uint8_t *ref = base + state->table[hash];
+
+            state->table[hash] = ip - base;
+
+            /* Skip ahead faster in incompressible data */
+            if (ref >= ip || ip - ref > LZ_MAX_OFFSET || lz_read32(ref) != sequence) {
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            /* Extend the match backwards into the pending literals */
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+
+            /* Extend the match forwards */
+            const uint8_t *mp = ip + LZ_MIN_MATCH;
+            const uint8_t *rp = ref + LZ_MIN_MATCH;
+            while (mp + sizeof(uint64_t) <= match_end_limit && lz_read64(mp) == lz_read64(rp)) {
+                mp += sizeof(uint64_t);
+                rp += sizeof(uint64_t);
+            }
+            while (mp < match_end_limit && *mp == *rp) {
+                mp++;
+                rp++;
+            }
+
+            if (!lz_write_sequence(file, size, anchor, ip - anchor, ip - ref, mp - ip - LZ_MIN_MATCH, false))
+                return PLCRASH_OUTPUT_ERR;
+
+            /* Index a position within the match, improving the odds of matching repeated structures */
+            state->table[lz_hash(lz_read32(mp - 2))] = (mp - 2) - base;
+
+            ip = mp;
+            anchor = ip;
+        }
+    }
+
+    /* Trailing literals */
+    if (!lz_write_sequence(file, size, anchor, end - anchor, 0, 0, true))
+        return PLCRASH_OUTPUT_ERR;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Compress @a len bytes of @a data, writing the compressed output to @a file. The output may be decoded with
+ * plcrash_async_lz_decompress().
+ *
+ * Literal runs are queued for output by reference; @a data must remain valid and unmodified until @a file is
+ * flushed or closed.
+ *
+ * If @a file reaches its output limit, a truncated stream will have been written. Callers that must not write
+ * a truncated stream should first verify that plcrash_async_lz_compressed_size() bytes are available.
+ *
+ * @param state Compressor state. This will be reset prior to use.
+ * @param file Output file.
+ * @param data The data to be compressed.
+ * @param len The length of @a data, in bytes. Must be less than 4GB.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or PLCRASH_OUTPUT_ERR if writing to @a file fails.
+ */
+plcrash_error_t plcrash_async_lz_compress (plcrash_async_lz_state_t *state, plcrash_async_file_t *file, const void *data, size_t len) {
+    size_t size = 0;
+    return lz_compress(state, file, &size, data, len);
+}
+
+/**
+ * Return the number of bytes that plcrash_async_lz_compress() will write when compressing @a len bytes of
+ * @a data. The compressor is deterministic; the result is exact.
+ *
+ * @param state Compressor state. This will be reset prior to use.
+ * @param data The data to be compressed.
+ * @param len The length of @a data, in bytes. Must be less than 4GB.
+ */
+size_t plcrash_async_lz_compressed_size (plcrash_async_lz_state_t *state, const void *data, size_t len) {
+    size_t size = 0;
+    lz_compress(state, NULL, &size, data, len);
+    return size;
+}
+
+/**
+ * Decompress @a len bytes of data previously compressed with plcrash_async_lz_compress().
+ *
+ * @param data The compressed data.
+ * @param len The length of @a data, in bytes.
+ * @param output The output buffer.
+ * @param output_len The size of @a output, in bytes.
+ * @param decoded_len On success, will be set to the number of bytes written to @a output.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or PLCRASH_EINVAL if @a data is invalid, or would decode to more
+ * than @a output_len bytes.
+ */
+plcrash_error_t plcrash_async_lz_decompress (const void *data, size_t len, void *output, size_t output_len, size_t *decoded_len) {
+    const uint8_t *ip = data;
+    const uint8_t *end = ip + len;
+    uint8_t *op = output;
+    uint8_t *out_end = op + output_len;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+        size_t length;
+        uint8_t b;
+
+        /* Literals */
+        length = token >> 4;
+        if (length == 15) {
+            do {
+                if (ip == end)
+                    return PLCRASH_EINVAL;
+                b = *ip++;
+                length += b;
+            } while (b == 255);
+        }
+
+        if (length > (size_t) (end - ip) || length > (size_t) (out_end - op))
+            return PLCRASH_EINVAL;
+
+        plcrash_async_memcpy(op, ip, length);
+        ip += length;
+        op += length;
+
+        /* The final sequence has no match */
+        if (ip == end)
+            break;
+
+        /* Match */
+        if (end - ip < 2)
+            return PLCRASH_EINVAL;
+
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t) (op - (uint8_t *) output))
+            return PLCRASH_EINVAL;
+
+        length = token & 0xF;
+        if (length == 15) {
+            do {
+                if (ip == end)
+                    return PLCRASH_EINVAL;
+                b = *ip++;
+                length += b;
+            } while (b == 255);
+        }
+        length += LZ_MIN_MATCH;
+
+        if (length > (size_t) (out_end - op))
+            return PLCRASH_EINVAL;
+
+        /* Matches may overlap their output; copy bytewise */
+        const uint8_t *ref = op - offset;
+        for (size_t i = 0; i < length; i++)
+            op[i] = ref[i];
+        op += length;
+    }
+
+    *decoded_len = op - (uint8_t *) output;
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * @} plcrash_async_compress
+ */
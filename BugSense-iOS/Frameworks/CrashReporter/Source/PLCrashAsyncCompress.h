@@ -0,0 +1,58 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+#import "PLCrashAsync.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_async_compress
+ *
+ * Number of bits used to index the compressor's match table.
+ */
+#define PLCRASH_ASYNC_LZ_HASH_BITS 12
+
+/**
+ * @internal
+ * @ingroup plcrash_async_compress
+ *
+ * Compressor state. This holds the match table used while compressing, and should be allocated in advance (eg,
+ * when the crash reporter is enabled) so as to avoid allocation or stack growth within a signal handler. The
+ * state need not be initialized; it is reset by each call to plcrash_async_lz_compress().
+ */
+typedef struct plcrash_async_lz_state {
+    /** Most recent input position for each hashed 4 byte sequence. */
+    uint32_t table[1 << PLCRASH_ASYNC_LZ_HASH_BITS];
+} plcrash_async_lz_state_t;
+
+plcrash_error_t plcrash_async_lz_compress (plcrash_async_lz_state_t *state, plcrash_async_file_t *file, const void *data, size_t len);
+size_t plcrash_async_lz_compressed_size (plcrash_async_lz_state_t *state, const void *data, size_t len);
+plcrash_error_t plcrash_async_lz_decompress (const void *data, size_t len, void *output, size_t output_len, size_t *decoded_len);
@@ -0,0 +1,236 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2009 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+
+#import "PLCrashAsyncCompress.h"
+#import "PLCrashLogWriterEncoding.h"
+
+#import <fcntl.h>
+#import <mach/mach_time.h>
+
+@interface PLCrashAsyncCompressTests : SenTestCase {
+@private
+    /* Compressor state */
+    plcrash_async_lz_state_t _state;
+}
+@end
+
+@implementation PLCrashAsyncCompressTests
+
+/* Compress and decompress the given data, verifying that the result matches. Returns the compressed length. */
+- (size_t) roundTrip: (const uint8_t *) data length: (size_t) len {
+    size_t bound = len + (len / 255) + 16;
+    uint8_t *compressed = malloc(bound);
+    uint8_t *decompressed = malloc(len + 1);
+    plcrash_async_file_t file;
+    size_t decoded_len;
+
+    plcrash_async_file_init_mem(&file, compressed, bound);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_lz_compress(&_state, &file, data, len), @"Compression failed for length %zu", len);
+
+    size_t compressed_len = plcrash_async_file_offset(&file);
+    STAssertEquals(compressed_len, plcrash_async_lz_compressed_size(&_state, data, len), @"Incorrect computed size for length %zu", len);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_lz_decompress(compressed, compressed_len, decompressed, len, &decoded_len),
+                   @"Decompression failed for length %zu", len);
+    STAssertEquals(len, decoded_len, @"Incorrect decompressed length");
+    STAssertTrue(memcmp(data, decompressed, len) == 0, @"Incorrect decompressed data for length %zu", len);
+
+    /* Decompressing to a smaller buffer must fail */
+    if (len > 0)
+        STAssertEquals(PLCRASH_EINVAL, plcrash_async_lz_decompress(compressed, compressed_len, decompressed, len - 1, &decoded_len),
+                       @"Decompression to a short buffer succeeded");
+
+    free(compressed);
+    free(decompressed);
+    return compressed_len;
+}
+
+- (void) testRoundTrip {
+    size_t size = 200 * 1024;
+    uint8_t *data = malloc(size);
+    uint32_t seed = 1;
+
+    /* Short inputs, including those too short to contain a match */
+    for (size_t len = 0; len < 64; len++) {
+        for (size_t i = 0; i < len; i++)
+            data[i] = i % 3;
+        [self roundTrip: data length: len];
+    }
+
+    /* Long runs, requiring extended match lengths */
+    memset(data, 'A', size);
+    STAssertTrue([self roundTrip: data length: size] < size / 100, @"Run was not compressed");
+
+    /* Incompressible data, requiring extended literal lengths */
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 24;
+    }
+    [self roundTrip: data length: size];
+
+    free(data);
+}
+
+/* Compressed output written to a file must match output written to memory */
+- (void) testFileOutput {
+    NSString *path = [NSTemporaryDirectory() stringByAppendingString: [[NSProcessInfo processInfo] globallyUniqueString]];
+    size_t size = 64 * 1024;
+    uint8_t *data = malloc(size);
+    uint8_t *expected = malloc(size * 2);
+    plcrash_async_file_t file;
+
+    for (size_t i = 0; i < size; i++)
+        data[i] = (i % 251) ^ (i / 1024);
+
+    plcrash_async_file_init_mem(&file, expected, size * 2);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_lz_compress(&_state, &file, data, size), @"Compression failed");
+    size_t expected_len = plcrash_async_file_offset(&file);
+
+    int fd = open([path UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    STAssertTrue(fd >= 0, @"Could not open output file");
+    plcrash_async_file_init(&file, fd, 0);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_lz_compress(&_state, &file, data, size), @"Compression failed");
+    STAssertTrue(plcrash_async_file_close(&file), @"Close failed");
+
+    NSData *written = [NSData dataWithContentsOfFile: path];
+    STAssertEquals(expected_len, (size_t) [written length], @"Incorrect output length");
+    STAssertTrue(memcmp(expected, [written bytes], expected_len) == 0, @"Incorrect output");
+
+    [[NSFileManager defaultManager] removeItemAtPath: path error: NULL];
+    free(data);
+    free(expected);
+}
+
+/* Invalid input must be rejected without reading or writing out of bounds */
+- (void) testInvalidInput {
+    uint8_t output[64];
+    size_t decoded_len;
+
+    /* Truncated extended literal length */
+    const uint8_t truncated_length[] = { 0xF0, 0xFF };
+    STAssertEquals(PLCRASH_EINVAL, plcrash_async_lz_decompress(truncated_length, sizeof(truncated_length), output, sizeof(output), &decoded_len), @"Accepted invalid data");
+
+    /* Truncated literals */
+    const uint8_t truncated_literals[] = { 0x40, 'a', 'b' };
+    STAssertEquals(PLCRASH_EINVAL, plcrash_async_lz_decompress(truncated_literals, sizeof(truncated_literals), output, sizeof(output), &decoded_len), @"Accepted invalid data");
+
+    /* Match offset precedes the start of the output */
+    const uint8_t bad_offset[] = { 0x10, 'a', 0x02, 0x00, 0x00 };
+    STAssertEquals(PLCRASH_EINVAL, plcrash_async_lz_decompress(bad_offset, sizeof(bad_offset), output, sizeof(output), &decoded_len), @"Accepted invalid data");
+
+    /* Zero match offset */
+    const uint8_t zero_offset[] = { 0x10, 'a', 0x00, 0x00, 0x00 };
+    STAssertEquals(PLCRASH_EINVAL, plcrash_async_lz_decompress(zero_offset, sizeof(zero_offset), output, sizeof(output), &decoded_len), @"Accepted invalid data");
+
+    /* A valid overlapping match */
+    const uint8_t overlap[] = { 0x10, 'a', 0x01, 0x00, 0x00 };
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_lz_decompress(overlap, sizeof(overlap), output, sizeof(output), &decoded_len), @"Rejected valid data");
+    STAssertEquals((size_t) 5, decoded_len, @"Incorrect decoded length");
+    STAssertTrue(memcmp(output, "aaaaa", 5) == 0, @"Incorrect decoded data");
+}
+
+/* Compress a synthetic crash report of 64 threads and 200 binary images. Results are logged. */
+- (void) testCompressionBenchmark {
+    size_t size = 192 * 1024;
+    uint8_t *report = malloc(size);
+    uint8_t *compressed = malloc(size * 2);
+    uint8_t *decompressed = malloc(size);
+    mach_timebase_info_data_t timebase;
+    plcrash_async_file_t file;
+    uint32_t seed = 1;
+    uint64_t start;
+    uint64_t compress_ns;
+    uint64_t decompress_ns;
+    size_t decoded_len;
+    const int iterations = 100;
+
+    mach_timebase_info(&timebase);
+
+    /* Threads, each with a packed backtrace of absolute PCs in one of 32 images */
+    plcrash_async_file_init_mem(&file, report, size);
+    for (uint32_t i = 0; i < 64; i++) {
+        plcrash_writer_message_t thread;
+        plcrash_writer_message_t pcs;
+
+        plcrash_writer_pack_message_begin(&file, 3, &thread);
+        plcrash_writer_pack_uint32(&file, 1, i);
+        plcrash_writer_pack_bool(&file, 3, i == 0);
+        plcrash_writer_pack_message_begin(&file, 5, &pcs);
+
+        seed = seed * 1103515245 + 12345;
+        for (uint32_t frame = 0; frame < 10 + (seed >> 27); frame++) {
+            seed = seed * 1103515245 + 12345;
+            plcrash_writer_pack_packed_varint(&file, 0x30000000ULL + ((seed >> 27) * 0x100000) + ((seed >> 8) & 0xFFFF));
+        }
+
+        plcrash_writer_pack_message_end(&file, &pcs);
+        plcrash_writer_pack_message_end(&file, &thread);
+    }
+
+    /* Binary images */
+    for (uint32_t i = 0; i < 200; i++) {
+        plcrash_writer_message_t image;
+        char name[128];
+
+        snprintf(name, sizeof(name), "/System/Library/Frameworks/Framework%u.framework/Framework%u", i, i);
+        plcrash_writer_pack_message_begin(&file, 4, &image);
+        plcrash_writer_pack_uint64(&file, 1, 0x30000000ULL + (i * 0x100000));
+        plcrash_writer_pack_uint64(&file, 2, 0x80000 + (i * 0x1000));
+        plcrash_writer_pack_string(&file, 3, name);
+        plcrash_writer_pack_message_end(&file, &image);
+    }
+    size_t report_len = plcrash_async_file_offset(&file);
+
+    /* Compress */
+    start = mach_absolute_time();
+    for (int i = 0; i < iterations; i++) {
+        plcrash_async_file_init_mem(&file, compressed, size * 2);
+        plcrash_async_lz_compress(&_state, &file, report, report_len);
+    }
+    compress_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom / iterations;
+    size_t compressed_len = plcrash_async_file_offset(&file);
+
+    /* Decompress */
+    start = mach_absolute_time();
+    for (int i = 0; i < iterations; i++)
+        plcrash_async_lz_decompress(compressed, compressed_len, decompressed, size, &decoded_len);
+    decompress_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom / iterations;
+
+    STAssertEquals(report_len, decoded_len, @"Incorrect decompressed length");
+    STAssertTrue(memcmp(report, decompressed, report_len) == 0, @"Incorrect decompressed data");
+
+    NSLog(@"Compressed %zu byte report to %zu bytes (%.2fx): compress %.1f MB/s, decompress %.1f MB/s", report_len, compressed_len,
+          (double) report_len / compressed_len, (double) report_len * 1000 / compress_ns, (double) report_len * 1000 / decompress_ns);
+
+    free(report);
+    free(compressed);
+    free(decompressed);
+}
+
+@end
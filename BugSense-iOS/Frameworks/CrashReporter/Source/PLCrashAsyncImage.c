@@ -44,9 +44,545 @@
  * Atomic compare and swap is used to ensure a consistent view of the list for readers. To simplify implementation, a
  * write mutex is held for all updates; the implementation is not designed for efficiency in the face of contention
  * between readers and writers, and it's assumed that no contention should realistically occur.
+ *
+ * To support address lookups without a linear scan, the list also maintains a sorted index of image address ranges.
+ * Writers build a new index when images are appended, and atomically swap it into place. Removal clears the image's
+ * range in place and records its position, and the index is only rebuilt once every
+ * PLCRASH_ASYNC_IMAGE_INDEX_REMOVED_MAX removals. Combined with a writer-side hash table of header addresses, removal
+ * requires no search of the list, and only an amortized share of an index copy.
+ *
+ * Nodes and indexes are never deallocated while the list is in use. Nodes are allocated in chunks, along with storage
+ * for their names and records, and removed nodes and replaced indexes are placed on a retired list. Writers never
+ * wait on readers; instead, once a writer observes that no readers are active, all retired nodes and indexes are
+ * returned to their free lists for reuse. Once the pool has grown to the list's working size, appending and removing
+ * images performs no allocation.
  * @{
  */
 
+/**
+ * @internal
+ * Compare two image ranges by start address.
+ */
+static int plcrash_async_image_range_compare (const void *a, const void *b) {
+    const plcrash_async_image_range_t *lhs = a;
+    const plcrash_async_image_range_t *rhs = b;
+
+    if (lhs->start < rhs->start)
+        return -1;
+    else if (lhs->start > rhs->start)
+        return 1;
+
+    return 0;
+}
+
+/**
+ * @internal
+ * Allocate a new node chunk, adding its nodes to the free list. Must be called with the write lock held.
+ *
+ * @return Returns true on success, or false if the chunk could not be allocated.
+ */
+static bool plcrash_async_image_list_grow (plcrash_async_image_list_t *list) {
+    plcrash_async_image_chunk_t *chunk = calloc(1, sizeof(plcrash_async_image_chunk_t));
+    if (chunk == NULL) {
+        PLCF_DEBUG("Could not allocate image list node chunk");
+        return false;
+    }
+
+    for (size_t i = 0; i < PLCRASH_ASYNC_IMAGE_CHUNK_NODES; i++) {
+        plcrash_async_image_t *node = &chunk->nodes[i];
+
+        node->storage = chunk->storage[i];
+        node->storage_size = sizeof(chunk->storage[i]);
+        node->pool_next = list->free;
+        list->free = node;
+    }
+
+    chunk->next = list->chunks;
+    list->chunks = chunk;
+
+    return true;
+}
+
+/**
+ * @internal
+ * Return all retired nodes and indexes to their free lists, if no readers are active. Must be called with the write
+ * lock held.
+ */
+static void plcrash_async_image_list_reclaim (plcrash_async_image_list_t *list) {
+    /* A reader acquires its reference prior to fetching the list head or index; if no references are held after a
+     * node or index has been made unreachable, no reader may still hold it. */
+    if (list->refcount > 0)
+        return;
+
+    while (list->retired != NULL) {
+        plcrash_async_image_t *node = list->retired;
+        list->retired = node->pool_next;
+
+        node->pool_next = list->free;
+        list->free = node;
+    }
+
+    while (list->retired_index != NULL) {
+        plcrash_async_image_index_t *index = list->retired_index;
+        list->retired_index = index->pool_next;
+
+        index->pool_next = list->free_index;
+        list->free_index = index;
+    }
+
+    list->retired_index_count = 0;
+}
+
+/**
+ * @internal
+ * Fetch an index with space for at least @a count ranges from the free list, allocating a new index if none is
+ * available. Must be called with the write lock held.
+ *
+ * @return Returns the index, or NULL if allocation failed, or the retired index limit has been reached.
+ */
+static plcrash_async_image_index_t *plcrash_async_image_list_index_alloc (plcrash_async_image_list_t *list, size_t count) {
+    plcrash_async_image_index_t *index;
+
+    /* Reuse a free index, if one is available. Indexes that are too small are deallocated. */
+    while ((index = list->free_index) != NULL) {
+        list->free_index = index->pool_next;
+        if (index->capacity >= count)
+            return index;
+
+        free(index);
+    }
+
+    /* Bound the memory held by retired indexes while readers remain active */
+    if (list->retired_index_count >= PLCRASH_ASYNC_IMAGE_RETIRED_INDEX_MAX)
+        return NULL;
+
+    /* Allocate with additional headroom, to avoid reallocating as images are added. */
+    size_t capacity = (count * 2) + PLCRASH_ASYNC_IMAGE_CHUNK_NODES;
+    index = malloc(sizeof(*index) + (capacity * sizeof(index->ranges[0])));
+    if (index == NULL) {
+        PLCF_DEBUG("Could not allocate image address index");
+        return NULL;
+    }
+
+    index->capacity = capacity;
+    return index;
+}
+
+/**
+ * @internal
+ * Atomically replace the list's current index, retiring the previous index. Must be called with the write lock held.
+ *
+ * @param list The list.
+ * @param old_index The current index, or NULL.
+ * @param new_index The new index, or NULL if no index is available.
+ */
+static void plcrash_async_image_list_publish_index (plcrash_async_image_list_t *list, plcrash_async_image_index_t *old_index,
+                                                    plcrash_async_image_index_t *new_index)
+{
+    if (!OSAtomicCompareAndSwapPtrBarrier(old_index, new_index, (void **) &list->index)) {
+        PLCF_DEBUG("Failed to replace image address index despite holding lock");
+    }
+
+    /* Retire the previous index */
+    if (old_index != NULL) {
+        old_index->pool_next = list->retired_index;
+        list->retired_index = old_index;
+        list->retired_index_count++;
+    }
+}
+
+/**
+ * @internal
+ * Return the list position of the image indexed by @a range, accounting for the images removed from @a index since
+ * it was built. This method is async-safe.
+ */
+static uint32_t plcrash_async_image_index_position (plcrash_async_image_index_t *index, const plcrash_async_image_range_t *range) {
+    uint32_t removed_count = index->removed_count;
+    uint32_t position = range->position;
+
+    /* Each removal is recorded prior to the count being incremented */
+    OSMemoryBarrier();
+
+    for (uint32_t i = 0; i < removed_count; i++) {
+        if (index->removed[i] < range->position)
+            position--;
+    }
+
+    return position;
+}
+
+/**
+ * @internal
+ * Return the range of @a item within @a index, or NULL if the item is not indexed.
+ */
+static plcrash_async_image_range_t *plcrash_async_image_index_find_range (plcrash_async_image_index_t *index,
+                                                                          plcrash_async_image_t *item)
+{
+    size_t low = 0;
+    size_t high = index->count;
+
+    if (item->size == 0)
+        return NULL;
+
+    /* Find the first range starting at the item's header */
+    while (low < high) {
+        size_t mid = low + ((high - low) / 2);
+        if (index->ranges[mid].start < item->header)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    for (size_t i = low; i < index->count && index->ranges[i].start == item->header; i++) {
+        if (index->ranges[i].image == item)
+            return &index->ranges[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * @internal
+ * Copy the ranges of @a old_index into a newly allocated index with space for @a additional ranges. The ranges of
+ * removed images are omitted, and the positions of the remaining ranges are updated. Must be called with the write
+ * lock held.
+ *
+ * @return Returns the new index, or NULL if the index could not be allocated.
+ */
+static plcrash_async_image_index_t *plcrash_async_image_list_index_compact (plcrash_async_image_list_t *list,
+                                                                            plcrash_async_image_index_t *old_index,
+                                                                            size_t additional)
+{
+    plcrash_async_image_index_t *new_index = plcrash_async_image_list_index_alloc(list, old_index->count + additional);
+    if (new_index == NULL)
+        return NULL;
+
+    new_index->pool_next = NULL;
+    new_index->count = 0;
+    new_index->removed_count = 0;
+
+    for (size_t i = 0; i < old_index->count; i++) {
+        if (old_index->ranges[i].image == NULL)
+            continue;
+
+        plcrash_async_image_range_t *range = &new_index->ranges[new_index->count++];
+        *range = old_index->ranges[i];
+        range->position = plcrash_async_image_index_position(old_index, &old_index->ranges[i]);
+    }
+
+    return new_index;
+}
+
+/**
+ * @internal
+ * Build and publish a new address index for the current list contents, retiring the previous index. Must be called
+ * with the write lock held.
+ *
+ * If the index can not be allocated, no index is published, and readers will fall back to a linear search.
+ */
+static void plcrash_async_image_list_reindex (plcrash_async_image_list_t *list) {
+    plcrash_async_image_index_t *old_index = list->index;
+    plcrash_async_image_index_t *new_index;
+    plcrash_async_image_t *item;
+    uint32_t position;
+    size_t count = 0;
+
+    /* Count the images with a known size */
+    for (item = list->head; item != NULL; item = item->next) {
+        if (item->size > 0)
+            count++;
+    }
+
+    /* Populate and sort the new index */
+    new_index = plcrash_async_image_list_index_alloc(list, count);
+    if (new_index != NULL) {
+        new_index->pool_next = NULL;
+        new_index->count = 0;
+        new_index->removed_count = 0;
+
+        for (item = list->head, position = 0; item != NULL; item = item->next, position++) {
+            if (item->size == 0)
+                continue;
+
+            plcrash_async_image_range_t *range = &new_index->ranges[new_index->count++];
+            range->start = item->header;
+            range->end = item->header + item->size;
+            range->position = position;
+            range->image = item;
+        }
+
+        qsort(new_index->ranges, new_index->count, sizeof(new_index->ranges[0]), plcrash_async_image_range_compare);
+    }
+
+    plcrash_async_image_list_publish_index(list, old_index, new_index);
+}
+
+/**
+ * @internal
+ * Publish an index that adds the newly appended @a item to the current index. Must be called with the write lock held,
+ * after @a item has been appended to the list.
+ *
+ * The current index is compacted into a copy with @a item's range inserted in place, avoiding a full rebuild of the
+ * index.
+ */
+static void plcrash_async_image_list_index_append (plcrash_async_image_list_t *list, plcrash_async_image_t *item) {
+    plcrash_async_image_index_t *old_index = list->index;
+    plcrash_async_image_index_t *new_index;
+
+    /* Images of unknown size are not indexed */
+    if (item->size == 0)
+        return;
+
+    /* Without a current index, perform a full rebuild */
+    if (old_index == NULL) {
+        plcrash_async_image_list_reindex(list);
+        return;
+    }
+
+    new_index = plcrash_async_image_list_index_compact(list, old_index, 1);
+    if (new_index != NULL) {
+        size_t low = 0;
+        size_t high = new_index->count;
+
+        /* Find the insertion point; the first range starting above the item. */
+        while (low < high) {
+            size_t mid = low + ((high - low) / 2);
+            if (new_index->ranges[mid].start <= item->header)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        memmove(&new_index->ranges[low + 1], &new_index->ranges[low], (new_index->count - low) * sizeof(new_index->ranges[0]));
+
+        plcrash_async_image_range_t *range = &new_index->ranges[low];
+        range->start = item->header;
+        range->end = item->header + item->size;
+        range->position = list->count - 1;
+        range->image = item;
+
+        new_index->count++;
+    }
+
+    plcrash_async_image_list_publish_index(list, old_index, new_index);
+}
+
+/**
+ * @internal
+ * Remove @a item from the current index. Must be called with the write lock held, after @a item has been
+ * made unreachable.
+ *
+ * The item's range is cleared in place, and its position is recorded in the index; this requires no copy of the
+ * index. Once PLCRASH_ASYNC_IMAGE_INDEX_REMOVED_MAX removals have been recorded, or if the item was not indexed, the
+ * index is instead compacted into a copy that omits the item, and the copy is published.
+ *
+ * @param list The list.
+ * @param item The removed item.
+ * @param position The item's former position within the list.
+ */
+static void plcrash_async_image_list_index_remove (plcrash_async_image_list_t *list, plcrash_async_image_t *item,
+                                                   uint32_t position)
+{
+    plcrash_async_image_index_t *old_index = list->index;
+    plcrash_async_image_index_t *new_index;
+    plcrash_async_image_range_t *range;
+
+    /* Without a current index, perform a full rebuild */
+    if (old_index == NULL) {
+        plcrash_async_image_list_reindex(list);
+        return;
+    }
+
+    /* Record the removal in place. The removal is recorded prior to the range being cleared; a concurrent reader
+     * may observe either the item, or its removal. */
+    range = plcrash_async_image_index_find_range(old_index, item);
+    if (range != NULL && old_index->removed_count < PLCRASH_ASYNC_IMAGE_INDEX_REMOVED_MAX) {
+        old_index->removed[old_index->removed_count] = range->position;
+        OSMemoryBarrier();
+
+        old_index->removed_count++;
+        OSMemoryBarrier();
+
+        range->image = NULL;
+        return;
+    }
+
+    /* Otherwise, compact the index. The positions of all following images are updated, even if the item itself was
+     * not indexed. */
+    new_index = plcrash_async_image_list_index_compact(list, old_index, 0);
+    if (new_index != NULL) {
+        size_t count = new_index->count;
+        new_index->count = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            if (new_index->ranges[i].image == item)
+                continue;
+
+            plcrash_async_image_range_t *dest = &new_index->ranges[new_index->count++];
+            *dest = new_index->ranges[i];
+            if (dest->position > position)
+                dest->position--;
+        }
+    }
+
+    plcrash_async_image_list_publish_index(list, old_index, new_index);
+}
+
+/**
+ * @internal
+ * Return the hash table slot at which the search for @a header begins.
+ */
+static inline size_t plcrash_async_image_hash_slot (plcrash_async_image_list_t *list, uintptr_t header) {
+    /* Image headers are page aligned; Fibonacci hashing distributes the high-order bits across the table. */
+    uint64_t hash = (uint64_t) header * 0x9E3779B97F4A7C15ULL;
+    return (size_t) (hash ^ (hash >> 32)) & (list->hash_capacity - 1);
+}
+
+/**
+ * @internal
+ * Insert @a image into the hash table. The table must have been sized to hold the image via
+ * plcrash_async_image_hash_reserve(). Must be called with the write lock held.
+ */
+static void plcrash_async_image_hash_insert (plcrash_async_image_list_t *list, plcrash_async_image_t *image) {
+    size_t slot = plcrash_async_image_hash_slot(list, image->header);
+
+    while (list->hash[slot].image != NULL)
+        slot = (slot + 1) & (list->hash_capacity - 1);
+
+    list->hash[slot].header = image->header;
+    list->hash[slot].image = image;
+}
+
+/**
+ * @internal
+ * Ensure that the hash table may hold all list entries, plus @a additional images, rebuilding the table from the
+ * list if necessary. If the table can not be allocated, the hash table is disabled, and writers will fall back to a
+ * linear search of the list. Must be called with the write lock held.
+ */
+static void plcrash_async_image_hash_reserve (plcrash_async_image_list_t *list, size_t additional) {
+    size_t required = ((size_t) list->count + additional) * 2;
+    size_t capacity = PLCRASH_ASYNC_IMAGE_HASH_MIN_CAPACITY;
+
+    if (list->hash != NULL && list->hash_capacity >= required)
+        return;
+
+    while (capacity < required)
+        capacity *= 2;
+
+    if (list->hash != NULL)
+        free(list->hash);
+
+    list->hash_capacity = capacity;
+    list->hash = calloc(capacity, sizeof(list->hash[0]));
+    if (list->hash == NULL) {
+        PLCF_DEBUG("Could not allocate image hash table");
+        return;
+    }
+
+    for (plcrash_async_image_t *item = list->head; item != NULL; item = item->next)
+        plcrash_async_image_hash_insert(list, item);
+}
+
+/**
+ * @internal
+ * Return the image with the given @a header address from the hash table, or NULL if not found. Must be called with
+ * the write lock held, and a hash table must be available.
+ */
+static plcrash_async_image_t *plcrash_async_image_hash_find (plcrash_async_image_list_t *list, uintptr_t header) {
+    size_t slot = plcrash_async_image_hash_slot(list, header);
+
+    while (list->hash[slot].image != NULL && list->hash[slot].header != header)
+        slot = (slot + 1) & (list->hash_capacity - 1);
+
+    return list->hash[slot].image;
+}
+
+/**
+ * @internal
+ * Remove and return the first image with the given @a header address from the hash table, or NULL if not found. Must
+ * be called with the write lock held, and a hash table must be available.
+ */
+static plcrash_async_image_t *plcrash_async_image_hash_remove (plcrash_async_image_list_t *list, uintptr_t header) {
+    size_t mask = list->hash_capacity - 1;
+    size_t slot = plcrash_async_image_hash_slot(list, header);
+    plcrash_async_image_t *image;
+
+    while (list->hash[slot].image != NULL && list->hash[slot].header != header)
+        slot = (slot + 1) & mask;
+
+    if ((image = list->hash[slot].image) == NULL)
+        return NULL;
+
+    /* Shift any following entries of the probe sequence back into the vacated slot, preserving the invariant that
+     * no empty slot lies between an entry and its initial slot. */
+    size_t empty = slot;
+    size_t next = slot;
+    while (true) {
+        next = (next + 1) & mask;
+        if (list->hash[next].image == NULL)
+            break;
+
+        /* Entries whose initial slot lies cyclically within (empty, next] must remain in place. */
+        size_t initial = plcrash_async_image_hash_slot(list, list->hash[next].header);
+        if (((next - initial) & mask) < ((next - empty) & mask))
+            continue;
+
+        list->hash[empty] = list->hash[next];
+        empty = next;
+    }
+
+    list->hash[empty].header = 0;
+    list->hash[empty].image = NULL;
+
+    return image;
+}
+
+/**
+ * @internal
+ * Return the position of @a item within the list. The position is read from the address index if the item is indexed;
+ * otherwise, the list is searched. Must be called with the write lock held.
+ */
+static uint32_t plcrash_async_image_list_position (plcrash_async_image_list_t *list, plcrash_async_image_t *item) {
+    plcrash_async_image_index_t *index = list->index;
+    plcrash_async_image_range_t *range;
+
+    if (index != NULL && (range = plcrash_async_image_index_find_range(index, item)) != NULL)
+        return plcrash_async_image_index_position(index, range);
+
+    uint32_t position = 0;
+    for (plcrash_async_image_t *cur = list->head; cur != NULL && cur != item; cur = cur->next)
+        position++;
+
+    return position;
+}
+
+/**
+ * @internal
+ * Ensure that @a node has at least @a size bytes of storage. Must be called with the write lock held.
+ *
+ * @return Returns true on success, or false if the storage could not be allocated.
+ */
+static bool plcrash_async_image_reserve_storage (plcrash_async_image_t *node, size_t size) {
+    if (node->storage_size >= size)
+        return true;
+
+    void *storage = malloc(size);
+    if (storage == NULL) {
+        PLCF_DEBUG("Could not allocate image storage");
+        return false;
+    }
+
+    /* Pooled storage remains owned by the chunk, and is simply abandoned. */
+    if (node->storage_allocated)
+        free(node->storage);
+
+    node->storage = storage;
+    node->storage_size = size;
+    node->storage_allocated = true;
+
+    return true;
+}
+
 /**
  * Initialize a new binary image list and issue a memory barrier
  *
@@ -58,6 +594,12 @@ void plcrash_async_image_list_init (plcrash_async_image_list_t *list) {
     memset(list, 0, sizeof(*list));
 
     list->write_lock = OS_SPINLOCK_INIT;
+
+    /* Pre-allocate the initial node pool and hash table. If this fails, allocation will be retried on append. */
+    plcrash_async_image_list_grow(list);
+    plcrash_async_image_hash_reserve(list, 0);
+
+    OSMemoryBarrier();
 }
 
 /**
@@ -66,48 +608,240 @@ void plcrash_async_image_list_init (plcrash_async_image_list_t *list) {
  * @warning This method is not async safe.
  */
 void plcrash_async_image_list_free (plcrash_async_image_list_t *list) {
-    plcrash_async_image_t *next = list->head;
-    while (next != NULL) {
-        /* Save the current pointer and fetch the next pointer. */
-        plcrash_async_image_t *cur = next;
-        next = cur->next;
-        
-        /* Deallocate the current item. */
-        if (cur->name != NULL)
-            free(cur->name);
-        free(cur);
+    /* Deallocate the node chunks, including any dedicated node storage */
+    while (list->chunks != NULL) {
+        plcrash_async_image_chunk_t *chunk = list->chunks;
+        list->chunks = chunk->next;
+
+        for (size_t i = 0; i < PLCRASH_ASYNC_IMAGE_CHUNK_NODES; i++) {
+            if (chunk->nodes[i].storage_allocated)
+                free(chunk->nodes[i].storage);
+        }
+
+        free(chunk);
+    }
+
+    if (list->hash != NULL)
+        free(list->hash);
+
+    /* Deallocate the address indexes */
+    plcrash_async_image_index_t *lists[] = { list->index, list->retired_index, list->free_index };
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+        plcrash_async_image_index_t *next = lists[i];
+        while (next != NULL) {
+            plcrash_async_image_index_t *index = next;
+            next = index->pool_next;
+            free(index);
+        }
+    }
+}
+
+/**
+ * @internal
+ * Filter the unpublished batch of @a count nodes chained from @a first to @a last, returning to the pool any node
+ * whose header address is already registered with @a list, or that is repeated within the batch. The remaining nodes
+ * are inserted into the hash table, if available. Must be called with the write lock held, after the hash table has
+ * been sized for the batch.
+ */
+static void plcrash_async_image_list_filter_batch (plcrash_async_image_list_t *list, plcrash_async_image_t **first,
+                                                   plcrash_async_image_t **last, uint32_t *count)
+{
+    plcrash_async_image_t *node = *first;
+    plcrash_async_image_t *kept = NULL;
+
+    *first = NULL;
+    while (node != NULL) {
+        plcrash_async_image_t *next = node->next;
+        bool duplicate = false;
+
+        if (list->hash != NULL) {
+            duplicate = (plcrash_async_image_hash_find(list, node->header) != NULL);
+            if (!duplicate)
+                plcrash_async_image_hash_insert(list, node);
+        } else {
+            /* Without a hash table, search both the list and the nodes retained from this batch */
+            for (plcrash_async_image_t *item = list->head; item != NULL && !duplicate; item = item->next)
+                duplicate = (item->header == node->header);
+
+            for (plcrash_async_image_t *item = *first; item != NULL && !duplicate; item = item->next)
+                duplicate = (item->header == node->header);
+        }
+
+        if (duplicate) {
+            /* The node was never reachable by readers, and may be returned to the pool immediately */
+            node->pool_next = list->free;
+            list->free = node;
+            (*count)--;
+        } else {
+            node->prev = kept;
+            node->next = NULL;
+            if (kept != NULL)
+                kept->next = node;
+            else
+                *first = node;
+
+            kept = node;
+        }
+
+        node = next;
     }
+
+    *last = kept;
 }
 
 /**
- * Append a new binary image record to @a list.
+ * Append a new binary image record to @a list. If an image with the same header address is already registered, the
+ * record is not appended.
  *
  * @param list The list to which the image record should be appended.
  * @param header The image's header address.
+ * @param size The size of the image's __TEXT segment, or 0 if unknown.
  * @param name The image's name.
+ * @param record The image's pre-encoded report record, or NULL. The record will be copied.
+ * @param record_len The length of @a record, in bytes.
+ *
+ * @warning This method is not async safe.
+ */
+void plcrash_async_image_list_append (plcrash_async_image_list_t *list, uintptr_t header, uint64_t size, const char *name,
+                                      const void *record, size_t record_len)
+{
+    plcrash_async_image_entry_t entry = {
+        .header = header,
+        .size = size,
+        .name = name,
+        .record = record,
+        .record_len = record_len
+    };
+
+    plcrash_async_image_list_append_batch(list, &entry, 1);
+}
+
+/**
+ * Append multiple binary image records to @a list, in order.
+ *
+ * The list nodes are reserved from the pool and populated without holding the write lock, and are then made visible
+ * to readers with a single atomic update; the address index is rebuilt once for the entire batch. This should be
+ * preferred over repeated calls to plcrash_async_image_list_append() when registering a large number of images.
+ *
+ * Entries whose header address is already registered, or that repeat an earlier entry of the batch, are skipped. As
+ * this is checked with the write lock held, callers need not serialize against other writers registering the same
+ * images.
+ *
+ * @param list The list to which the image records should be appended.
+ * @param entries The image records to append. The names and records will be copied.
+ * @param count The number of entries.
  *
  * @warning This method is not async safe.
  */
-void plcrash_async_image_list_append (plcrash_async_image_list_t *list, uintptr_t header, const char *name) {
-    /* Initialize the new entry. */
-    plcrash_async_image_t *new = calloc(1, sizeof(plcrash_async_image_t));
-    new->header = header;
-    new->name = strdup(name);
-    
-    /* Update the image record and issue a memory barrier to ensure a consistent view. */
+void plcrash_async_image_list_append_batch (plcrash_async_image_list_t *list, const plcrash_async_image_entry_t *entries,
+                                            size_t count)
+{
+    plcrash_async_image_t *first = NULL;
+    plcrash_async_image_t *last = NULL;
+    plcrash_async_image_t *unused = NULL;
+    plcrash_async_image_t *node;
+    uint32_t appended = 0;
+
+    if (count == 0)
+        return;
+
+    /* Reserve the nodes from the pool, reclaiming retired nodes or growing the pool if necessary. The reserved nodes
+     * are chained via their pool_next pointers. */
+    OSSpinLockLock(&list->write_lock); {
+        plcrash_async_image_list_reclaim(list);
+
+        for (size_t i = 0; i < count; i++) {
+            if (list->free == NULL && !plcrash_async_image_list_grow(list))
+                break;
+
+            node = list->free;
+            list->free = node->pool_next;
+
+            node->pool_next = unused;
+            unused = node;
+        }
+    } OSSpinLockUnlock(&list->write_lock);
+
+    /* Populate the nodes. These are not yet reachable by readers or other writers, and no lock is required. */
+    for (size_t i = 0; i < count && unused != NULL; i++) {
+        const plcrash_async_image_entry_t *entry = &entries[i];
+        size_t name_len = strlen(entry->name) + 1;
+        size_t record_len = (entry->record != NULL) ? entry->record_len : 0;
+
+        node = unused;
+
+        /* Reserve the name and record storage. If the record can not be stored, it will be omitted. */
+        if (!plcrash_async_image_reserve_storage(node, name_len + record_len)) {
+            record_len = 0;
+            if (!plcrash_async_image_reserve_storage(node, name_len))
+                continue;
+        }
+
+        unused = node->pool_next;
+
+        node->header = entry->header;
+        node->size = entry->size;
+        node->name = node->storage;
+        memcpy(node->name, entry->name, name_len);
+
+        if (record_len > 0) {
+            node->record = (uint8_t *) node->storage + name_len;
+            node->record_len = record_len;
+            memcpy(node->record, entry->record, record_len);
+        } else {
+            node->record = NULL;
+            node->record_len = 0;
+        }
+
+        node->prev = last;
+        node->next = NULL;
+        node->pool_next = NULL;
+
+        if (last != NULL)
+            last->next = node;
+        else
+            first = node;
+
+        last = node;
+        appended++;
+    }
+
+    /* Update the image records and issue a memory barrier to ensure a consistent view. */
     OSMemoryBarrier();
-    
+
     /* Lock the list from other writers. */
     OSSpinLockLock(&list->write_lock); {
+        /* Return any unused nodes to the pool */
+        while ((node = unused) != NULL) {
+            unused = node->pool_next;
+            node->pool_next = list->free;
+            list->free = node;
+        }
+
+        if (first == NULL) {
+            OSSpinLockUnlock(&list->write_lock);
+            return;
+        }
+
+        /* Size the hash table prior to linking the new records; if the table must be rebuilt, it is rebuilt from
+         * the existing records. */
+        plcrash_async_image_hash_reserve(list, appended);
+
+        /* Drop any images that are already registered */
+        plcrash_async_image_list_filter_batch(list, &first, &last, &appended);
+        if (first == NULL) {
+            OSSpinLockUnlock(&list->write_lock);
+            return;
+        }
 
         /* If this is the first entry, initialize the list. */
         if (list->tail == NULL) {
 
             /* Update the list tail. This need not be done atomically, as tail is never accessed by a lockless reader. */
-            list->tail = new;
+            list->tail = last;
 
             /* Atomically update the list head; this will be iterated upon by lockless readers. */
-            if (!OSAtomicCompareAndSwapPtrBarrier(NULL, new, (void **) (&list->head))) {
+            if (!OSAtomicCompareAndSwapPtrBarrier(NULL, first, (void **) (&list->head))) {
                 /* Should never occur */
                 PLCF_DEBUG("An async image head was set with tail == NULL despite holding lock.");
             }
@@ -115,36 +849,81 @@ void plcrash_async_image_list_append (plcrash_async_image_list_t *list, uintptr_
         
         /* Otherwise, append to the end of the list */
         else {
-            /* Atomically slot the new record into place; this may be iterated on by a lockless reader. */
-            if (!OSAtomicCompareAndSwapPtrBarrier(NULL, new, (void **) (&list->tail->next))) {
+            /* Update the prev pointer. This is never accessed without a lock, so no additional barrier is required. */
+            first->prev = list->tail;
+
+            /* Atomically slot the new records into place; this may be iterated on by a lockless reader. */
+            if (!OSAtomicCompareAndSwapPtrBarrier(NULL, first, (void **) (&list->tail->next))) {
                 PLCF_DEBUG("Failed to append to image list despite holding lock");
             }
 
-            /* Update the prev and tail pointers. This is never accessed without a lock, so no additional barrier
-             * is required here. */
-            new->prev = list->tail;
-            list->tail = new;
+            list->tail = last;
         }
+
+        list->count += appended;
+
+        /* Publish the updated address index. A single image may be inserted in place; larger batches are indexed
+         * with a single rebuild. */
+        if (appended == 1)
+            plcrash_async_image_list_index_append(list, first);
+        else
+            plcrash_async_image_list_reindex(list);
+
+        plcrash_async_image_list_reclaim(list);
     } OSSpinLockUnlock(&list->write_lock);
 }
 
+/**
+ * Return true if a binary image record with the given @a header address has been appended to @a list, and not
+ * removed. The record is found via the list's header address hash table.
+ *
+ * @param header The header address of the record to be found.
+ *
+ * @warning This method is not async safe.
+ */
+bool plcrash_async_image_list_contains (plcrash_async_image_list_t *list, uintptr_t header) {
+    plcrash_async_image_t *item;
+
+    /* Lock the list from other writers. */
+    OSSpinLockLock(&list->write_lock); {
+        /* If the hash table is unavailable, fall back on searching the list. */
+        if (list->hash != NULL) {
+            item = plcrash_async_image_hash_find(list, header);
+        } else {
+            for (item = list->head; item != NULL; item = item->next) {
+                if (item->header == header)
+                    break;
+            }
+        }
+    } OSSpinLockUnlock(&list->write_lock);
+
+    return item != NULL;
+}
+
 /**
  * Remove a binary image record from @a list.
  *
- * @param header The header address of the record to be removed. The first record matching this address will be removed.
+ * The record is found via the list's header address hash table, and its address index range is cleared in place; the
+ * address index is only copied once every PLCRASH_ASYNC_IMAGE_INDEX_REMOVED_MAX removals.
+ *
+ * @param header The header address of the record to be removed.
  *
  * @warning This method is not async safe.
  */
 void plcrash_async_image_list_remove (plcrash_async_image_list_t *list, uintptr_t header) {
     /* Lock the list from other writers. */
     OSSpinLockLock(&list->write_lock); {
-        /* Find the record. */
-        plcrash_async_image_t *item = list->head;
-        while (item != NULL) {
-            if (item->header == header)
-                break;
+        plcrash_async_image_t *item;
+        uint32_t position;
 
-            item = item->next;
+        /* Find the record. If the hash table is unavailable, fall back on searching the list. */
+        if (list->hash != NULL) {
+            item = plcrash_async_image_hash_remove(list, header);
+        } else {
+            for (item = list->head; item != NULL; item = item->next) {
+                if (item->header == header)
+                    break;
+            }
         }
         
         /* If not found, nothing to do */
@@ -153,6 +932,8 @@ void plcrash_async_image_list_remove (plcrash_async_image_list_t *list, uintptr_
             return;
         }
 
+        position = plcrash_async_image_list_position(list, item);
+
         /*
          * Atomically make the item unreachable by readers.
          *
@@ -179,13 +960,17 @@ void plcrash_async_image_list_remove (plcrash_async_image_list_t *list, uintptr_
             list->tail = item->prev;
         }
 
-        /* If a reader is active, simply spin until inactive. */
-        while (list->refcount > 0) {
-        }
+        list->count--;
+
+        /* Publish an address index that no longer references the item. */
+        plcrash_async_image_list_index_remove(list, item, position);
 
-        if (item->name != NULL)
-            free(item->name);
-        free(item);
+        /* Retire the item. Its next pointer is left intact, as a reader may still be iterating via the item; it
+         * will be reused once no readers remain. */
+        item->pool_next = list->retired;
+        list->retired = item;
+
+        plcrash_async_image_list_reclaim(list);
     } OSSpinLockUnlock(&list->write_lock);
 }
 
@@ -199,10 +984,10 @@ void plcrash_async_image_list_remove (plcrash_async_image_list_t *list, uintptr_
  */
 void plcrash_async_image_list_set_reading (plcrash_async_image_list_t *list, bool enable) {
     if (enable) {
-        /* Increment and issue a barrier. Once issued, no items will be deallocated while a reference is held. */
+        /* Increment and issue a barrier. Once issued, no retired items will be reused while a reference is held. */
         OSAtomicIncrement32Barrier(&list->refcount);
     } else {
-        /* Increment and issue a barrier. Once issued, items may again be deallocated. */
+        /* Decrement and issue a barrier. Once issued, retired items may again be reused. */
         OSAtomicDecrement32Barrier(&list->refcount);
     }
 }
@@ -220,6 +1005,70 @@ plcrash_async_image_t *plcrash_async_image_list_next (plcrash_async_image_list_t
     return list->head;
 }
 
+/**
+ * Find the image containing @a address. This method is async-safe, and performs a binary search of the list's
+ * address index; if no index is available, the list is searched linearly. Images with an unknown size are never
+ * matched.
+ *
+ * The list must be retained for reading (see plcrash_async_image_list_set_reading()) for as long as the
+ * returned image is in use.
+ *
+ * @param list The list to be searched.
+ * @param address The address to look up.
+ * @param position If non-NULL, will be set to the image's position within the list, as would be returned by
+ * iterating the list with plcrash_async_image_list_next().
+ *
+ * @return Returns the image containing @a address, or NULL if not found.
+ */
+plcrash_async_image_t *plcrash_async_image_list_find (plcrash_async_image_list_t *list, uintptr_t address, uint32_t *position) {
+    plcrash_async_image_index_t *index = list->index;
+
+    /* Fall back on a linear search if no index is available */
+    if (index == NULL) {
+        plcrash_async_image_t *image = NULL;
+        uint32_t i = 0;
+
+        while ((image = plcrash_async_image_list_next(list, image)) != NULL) {
+            if (image->size > 0 && address >= image->header && address - image->header < image->size) {
+                if (position != NULL)
+                    *position = i;
+                return image;
+            }
+            i++;
+        }
+
+        return NULL;
+    }
+
+    /* Find the last range starting at or below the address */
+    size_t low = 0;
+    size_t high = index->count;
+    while (low < high) {
+        size_t mid = low + ((high - low) / 2);
+        if (index->ranges[mid].start <= address)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == 0)
+        return NULL;
+
+    plcrash_async_image_range_t *range = &index->ranges[low - 1];
+    if (address >= range->end)
+        return NULL;
+
+    /* The image may have been removed */
+    plcrash_async_image_t *image = range->image;
+    if (image == NULL)
+        return NULL;
+
+    if (position != NULL)
+        *position = plcrash_async_image_index_position(index, range);
+
+    return image;
+}
+
 /**
  * @}
  */
\ No newline at end of file
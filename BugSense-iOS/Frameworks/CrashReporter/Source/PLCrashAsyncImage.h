@@ -27,8 +27,51 @@
  */
 
 #include <stdint.h>
-#include <libkern/OSAtomic.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+#if __APPLE__
+#include <libkern/OSAtomic.h>
+#elif __linux__
+/*
+ * Minimal equivalents of the OSAtomic primitives used by the image list, implemented with the GCC atomic builtins.
+ * All operations are async-safe.
+ */
+typedef volatile int32_t OSSpinLock;
+#define OS_SPINLOCK_INIT 0
+
+static inline void OSSpinLockLock (OSSpinLock *lock) {
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE) != 0) {
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED) != 0) {
+#if defined(__i386__) || defined(__x86_64__)
+            __builtin_ia32_pause();
+#endif
+        }
+    }
+}
+
+static inline void OSSpinLockUnlock (OSSpinLock *lock) {
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+static inline void OSMemoryBarrier (void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline bool OSAtomicCompareAndSwapPtrBarrier (void *old_value, void *new_value, void * volatile *value) {
+    return __atomic_compare_exchange_n(value, &old_value, new_value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline int32_t OSAtomicIncrement32Barrier (volatile int32_t *value) {
+    return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline int32_t OSAtomicDecrement32Barrier (volatile int32_t *value) {
+    return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST);
+}
+#else
+#error Unsupported Platform
+#endif
 
 /**
  * @internal
@@ -39,17 +82,168 @@
 typedef struct plcrash_async_image {
     /** The binary image's header address. */
     uintptr_t header;
+
+    /** The size of the binary image's __TEXT segment, starting at the header address, or 0 if unknown. For ELF
+     * images, this is the extent of the executable segment, measured from the header address. */
+    uint64_t size;
     
     /** The binary image's name/path. */
     char *name;
 
+    /** The binary image's pre-encoded report record, or NULL if unavailable. If available, this may be emitted
+     * directly when writing a crash report. */
+    void *record;
+
+    /** The length of the pre-encoded record, in bytes. */
+    size_t record_len;
+
     /** The previous image in the list, or NULL */
     struct plcrash_async_image *prev;
     
     /** The next image in the list, or NULL. */
     struct plcrash_async_image *next;
+
+    /** The next node in the list's free or retired node list, or NULL. */
+    struct plcrash_async_image *pool_next;
+
+    /** Backing storage for the image's name and record. This is retained when the node is returned to the pool, and
+     * reused if large enough for the node's next image. */
+    void *storage;
+
+    /** The size of @a storage, in bytes. */
+    size_t storage_size;
+
+    /** If true, @a storage was allocated for this node, rather than from its chunk's storage pool. */
+    bool storage_allocated;
 } plcrash_async_image_t;
 
+/**
+ * @internal
+ * @ingroup plcrash_async_image
+ *
+ * The number of nodes allocated at once by the image list's node pool.
+ */
+#define PLCRASH_ASYNC_IMAGE_CHUNK_NODES 64
+
+/**
+ * @internal
+ * @ingroup plcrash_async_image
+ *
+ * The size of the name and record storage allocated for each pooled node. Images that require additional storage
+ * are allocated dedicated storage.
+ */
+#define PLCRASH_ASYNC_IMAGE_NODE_STORAGE 512
+
+/**
+ * @internal
+ * @ingroup plcrash_async_image
+ *
+ * The maximum number of retired address indexes. If readers remain active long enough for this many indexes to be
+ * retired, no further indexes are allocated until the retired indexes are reclaimed, and lookups fall back to a
+ * linear search.
+ */
+#define PLCRASH_ASYNC_IMAGE_RETIRED_INDEX_MAX 4
+
+/**
+ * @internal
+ * @ingroup plcrash_async_image
+ *
+ * The maximum number of removed images that may be recorded in an address index before it is compacted. Removal
+ * marks the image's range in place, and lookups must account for each recorded removal when computing an image's
+ * position; this bounds both the cost of those lookups and the number of removals between compactions.
+ */
+#define PLCRASH_ASYNC_IMAGE_INDEX_REMOVED_MAX 32
+
+/**
+ * @internal
+ * @ingroup plcrash_async_image
+ *
+ * The minimum capacity of the image list's header address hash table. The table is grown to maintain a load factor
+ * of at most 50%.
+ */
+#define PLCRASH_ASYNC_IMAGE_HASH_MIN_CAPACITY 128
+
+/**
+ * @internal
+ * @ingroup plcrash_async_image
+ *
+ * A block of pre-allocated image list nodes, and their name and record storage.
+ */
+typedef struct plcrash_async_image_chunk {
+    /** The next chunk, or NULL. */
+    struct plcrash_async_image_chunk *next;
+
+    /** The chunk's nodes. */
+    plcrash_async_image_t nodes[PLCRASH_ASYNC_IMAGE_CHUNK_NODES];
+
+    /** The nodes' name and record storage. */
+    uint8_t storage[PLCRASH_ASYNC_IMAGE_CHUNK_NODES][PLCRASH_ASYNC_IMAGE_NODE_STORAGE];
+} plcrash_async_image_chunk_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_async_image
+ *
+ * A binary image address range, as stored in the image list's address index.
+ */
+typedef struct plcrash_async_image_range {
+    /** The image's start address (inclusive). */
+    uintptr_t start;
+
+    /** The image's end address (exclusive). */
+    uintptr_t end;
+
+    /** The image's position within the list, at the time the index was built. */
+    uint32_t position;
+
+    /** The image, or NULL if the image has been removed. */
+    plcrash_async_image_t * volatile image;
+} plcrash_async_image_range_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_async_image
+ *
+ * A sorted index of the address ranges of all images in an image list with a known size. Appending an image copies
+ * the index, and the copy atomically replaces the previous index. Removing an image instead clears the image's range
+ * in place, and records its position; once PLCRASH_ASYNC_IMAGE_INDEX_REMOVED_MAX removals have been recorded, the
+ * index is compacted into a copy.
+ */
+typedef struct plcrash_async_image_index {
+    /** The next index in the list's free or retired index list, or NULL. */
+    struct plcrash_async_image_index *pool_next;
+
+    /** The maximum number of ranges that may be stored in this index. */
+    size_t capacity;
+
+    /** The number of ranges, including the ranges of removed images. */
+    size_t count;
+
+    /** The positions of the removed images, as recorded in their ranges. The position of each remaining image is
+     * reduced by the number of removed images that preceded it. */
+    uint32_t removed[PLCRASH_ASYNC_IMAGE_INDEX_REMOVED_MAX];
+
+    /** The number of entries in @a removed. Only incremented once the entry has been written. */
+    volatile uint32_t removed_count;
+
+    /** The image ranges, sorted by start address. */
+    plcrash_async_image_range_t ranges[];
+} plcrash_async_image_index_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_async_image
+ *
+ * An entry in the image list's header address hash table.
+ */
+typedef struct plcrash_async_image_hash_entry {
+    /** The image's header address. */
+    uintptr_t header;
+
+    /** The image, or NULL if the entry is empty. */
+    plcrash_async_image_t *image;
+} plcrash_async_image_hash_entry_t;
+
 /**
  * @internal
  * @ingroup plcrash_async_image
@@ -67,18 +261,74 @@ typedef struct plcrash_async_image_list {
     /** The tail of the list, or NULL if the list is empty. Must only be used to append new entries. */
     plcrash_async_image_t *tail;
 
-    /** The list reference count. No nodes will be deallocated while the count is greater than 0. If the count
-     * reaches 0, all nodes in the free list will be deallocated. */
-    int32_t refcount;
+    /** The number of images in the list. Must only be accessed by writers. */
+    uint32_t count;
+
+    /** The list reference count. No retired nodes or indexes will be reused while the count is greater than 0. Once
+     * the count is observed to be 0 by a writer, all retired nodes and indexes are returned to their free lists. */
+    volatile int32_t refcount;
 
     /** The node free list. */
     plcrash_async_image_t *free;
+
+    /** Removed nodes that may still be in use by readers. */
+    plcrash_async_image_t *retired;
+
+    /** All allocated node chunks. */
+    plcrash_async_image_chunk_t *chunks;
+
+    /** The current address index, or NULL if no index is available. */
+    plcrash_async_image_index_t *index;
+
+    /** Replaced indexes that may still be in use by readers. */
+    plcrash_async_image_index_t *retired_index;
+
+    /** The number of indexes in @a retired_index. */
+    uint32_t retired_index_count;
+
+    /** The index free list. */
+    plcrash_async_image_index_t *free_index;
+
+    /** Open addressing hash table mapping header addresses to list nodes, or NULL if unavailable. Must only be
+     * accessed by writers. */
+    plcrash_async_image_hash_entry_t *hash;
+
+    /** The number of entries in @a hash. Always a power of two. */
+    size_t hash_capacity;
 } plcrash_async_image_list_t;
 
+/**
+ * @internal
+ * @ingroup plcrash_async_image
+ *
+ * A binary image record to be appended to an image list.
+ */
+typedef struct plcrash_async_image_entry {
+    /** The image's header address. */
+    uintptr_t header;
+
+    /** The size of the image's __TEXT segment, or 0 if unknown. */
+    uint64_t size;
+
+    /** The image's name. */
+    const char *name;
+
+    /** The image's pre-encoded report record, or NULL. */
+    const void *record;
+
+    /** The length of @a record, in bytes. */
+    size_t record_len;
+} plcrash_async_image_entry_t;
+
 void plcrash_async_image_list_init (plcrash_async_image_list_t *list);
 void plcrash_async_image_list_free (plcrash_async_image_list_t *list);
-void plcrash_async_image_list_append (plcrash_async_image_list_t *list, uintptr_t header, const char *name);
+void plcrash_async_image_list_append (plcrash_async_image_list_t *list, uintptr_t header, uint64_t size, const char *name,
+                                      const void *record, size_t record_len);
+void plcrash_async_image_list_append_batch (plcrash_async_image_list_t *list, const plcrash_async_image_entry_t *entries,
+                                            size_t count);
 void plcrash_async_image_list_remove (plcrash_async_image_list_t *list, uintptr_t header);
+bool plcrash_async_image_list_contains (plcrash_async_image_list_t *list, uintptr_t header);
 
 void plcrash_async_image_list_set_reading (plcrash_async_image_list_t *list, bool enable);
 plcrash_async_image_t *plcrash_async_image_list_next (plcrash_async_image_list_t *list, plcrash_async_image_t *current);
+plcrash_async_image_t *plcrash_async_image_list_find (plcrash_async_image_list_t *list, uintptr_t address, uint32_t *position);
@@ -0,0 +1,470 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/* Required for dl_iterate_phdr() */
+#define _GNU_SOURCE
+
+#import "PLCrashAsyncImageELF.h"
+#import "PLCrashLogWriterEncoding.h"
+
+#ifdef __linux__
+
+#import <link.h>
+#import <elf.h>
+#import <sys/param.h>
+#import <stdlib.h>
+#import <string.h>
+#import <unistd.h>
+
+/**
+ * @internal
+ * @ingroup plcrash_async_image
+ * @defgroup plcrash_async_image_elf ELF Binary Image Provider (Linux)
+ *
+ * Populates a binary image list from the ELF objects reported by dl_iterate_phdr(). Linux provides no equivalent of
+ * the dyld add/remove image callbacks; instead, the list is brought up to date by calling
+ * plcrash_async_image_elf_list_update() after the process' set of loaded objects may have changed.
+ *
+ * Each image's report record is encoded at registration time, using the GNU build-id in place of the Mach-O UUID,
+ * and the ELF machine type as the image's code type. No ELF headers are parsed at crash time.
+ * @{
+ */
+
+/**
+ * @internal
+ * Protobuf field IDs, as defined in crash_report.proto
+ */
+enum {
+    /** CrashReport.binary_images */
+    PLCRASH_PROTO_BINARY_IMAGES_ID = 4,
+
+    /** CrashReport.BinaryImage.base_address */
+    PLCRASH_PROTO_BINARY_IMAGE_ADDR_ID = 1,
+
+    /** CrashReport.BinaryImage.size */
+    PLCRASH_PROTO_BINARY_IMAGE_SIZE_ID = 2,
+
+    /** CrashReport.BinaryImage.name */
+    PLCRASH_PROTO_BINARY_IMAGE_NAME_ID = 3,
+
+    /** CrashReport.BinaryImage.uuid */
+    PLCRASH_PROTO_BINARY_IMAGE_UUID_ID = 4,
+
+    /** CrashReport.BinaryImage.code_type */
+    PLCRASH_PROTO_BINARY_IMAGE_CODE_TYPE_ID = 5,
+
+    /** CrashReport.Processor.encoding */
+    PLCRASH_PROTO_PROCESSOR_ENCODING_ID = 1,
+
+    /** CrashReport.Processor.type */
+    PLCRASH_PROTO_PROCESSOR_TYPE_ID = 2,
+
+    /** CrashReport.Processor.subtype */
+    PLCRASH_PROTO_PROCESSOR_SUBTYPE_ID = 3,
+
+    /** CrashReport.Processor.TypeEncoding.TYPE_ENCODING_ELF */
+    PLCRASH_PROTO_PROCESSOR_ENCODING_ELF = 2,
+};
+
+/** The GNU build-id note name, including the NUL terminator. */
+static const char gnu_note_name[] = "GNU";
+
+/**
+ * @internal
+ * Round @a value up to a multiple of @a align, which must be a power of two.
+ */
+static inline size_t plcrash_async_image_elf_align (size_t value, size_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+/**
+ * @internal
+ * Search a PT_NOTE segment for the GNU build-id note.
+ *
+ * @param notes The address of the mapped note segment.
+ * @param len The length of the note segment.
+ * @param align The note alignment; 8 for segments with 8-byte alignment, 4 otherwise.
+ * @param info The image info to which the build-id will be written.
+ *
+ * @return Returns true if a build-id was found.
+ */
+static bool plcrash_async_image_elf_find_build_id (const uint8_t *notes, size_t len, size_t align,
+                                                   plcrash_async_image_elf_info_t *info)
+{
+    size_t offset = 0;
+
+    while (offset + sizeof(ElfW(Nhdr)) <= len) {
+        const ElfW(Nhdr) *nhdr = (const ElfW(Nhdr) *) (notes + offset);
+        size_t name_offset = offset + sizeof(ElfW(Nhdr));
+        size_t desc_offset = name_offset + plcrash_async_image_elf_align(nhdr->n_namesz, align);
+        size_t next_offset = desc_offset + plcrash_async_image_elf_align(nhdr->n_descsz, align);
+
+        /* Reject truncated notes */
+        if (desc_offset > len || next_offset > len || next_offset <= offset)
+            return false;
+
+        if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == sizeof(gnu_note_name) &&
+            memcmp(notes + name_offset, gnu_note_name, sizeof(gnu_note_name)) == 0)
+        {
+            info->build_id_len = nhdr->n_descsz;
+            if (info->build_id_len > sizeof(info->build_id))
+                info->build_id_len = sizeof(info->build_id);
+
+            memcpy(info->build_id, notes + desc_offset, info->build_id_len);
+            return true;
+        }
+
+        offset = next_offset;
+    }
+
+    return false;
+}
+
+/**
+ * @internal
+ * Parse an image's program headers.
+ *
+ * @param phdr_info The image's dl_iterate_phdr() info.
+ * @param info The image info to be populated.
+ *
+ * @return Returns true if the image has a loadable segment, and may be registered.
+ */
+static bool plcrash_async_image_elf_parse (const struct dl_phdr_info *phdr_info, plcrash_async_image_elf_info_t *info) {
+    const ElfW(Phdr) *first_load = NULL;
+
+    memset(info, 0, sizeof(*info));
+
+    /* The header is mapped by the first loadable segment; the program headers are sorted by address. */
+    for (ElfW(Half) i = 0; i < phdr_info->dlpi_phnum; i++) {
+        if (phdr_info->dlpi_phdr[i].p_type == PT_LOAD) {
+            first_load = &phdr_info->dlpi_phdr[i];
+            break;
+        }
+    }
+
+    if (first_load == NULL)
+        return false;
+
+    info->header = phdr_info->dlpi_addr + first_load->p_vaddr - first_load->p_offset;
+    info->name = phdr_info->dlpi_name;
+
+    /* Machine type. The ELF header is only available if the first segment maps the start of the file. */
+    if (first_load->p_offset == 0 && first_load->p_filesz >= sizeof(ElfW(Ehdr))) {
+        const ElfW(Ehdr) *ehdr = (const ElfW(Ehdr) *) info->header;
+        if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) == 0) {
+            info->has_machine = true;
+            info->machine = ehdr->e_machine;
+        }
+    }
+
+    for (ElfW(Half) i = 0; i < phdr_info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *phdr = &phdr_info->dlpi_phdr[i];
+        uintptr_t addr = phdr_info->dlpi_addr + phdr->p_vaddr;
+
+        /* Executable segment */
+        if (phdr->p_type == PT_LOAD && (phdr->p_flags & PF_X) && info->size == 0 && addr >= info->header)
+            info->size = (addr + phdr->p_memsz) - info->header;
+
+        /* Build-id */
+        if (phdr->p_type == PT_NOTE && info->build_id_len == 0)
+            plcrash_async_image_elf_find_build_id((const uint8_t *) addr, phdr->p_filesz, phdr->p_align == 8 ? 8 : 4, info);
+    }
+
+    return true;
+}
+
+/**
+ * @internal
+ * Write a Processor message for an ELF machine type.
+ */
+static size_t plcrash_async_image_elf_write_processor_info (plcrash_async_file_t *file, uint16_t machine) {
+    size_t rv = 0;
+
+    rv += plcrash_writer_pack_uint32(file, PLCRASH_PROTO_PROCESSOR_ENCODING_ID, PLCRASH_PROTO_PROCESSOR_ENCODING_ELF);
+    rv += plcrash_writer_pack_uint64(file, PLCRASH_PROTO_PROCESSOR_TYPE_ID, machine);
+    rv += plcrash_writer_pack_uint64(file, PLCRASH_PROTO_PROCESSOR_SUBTYPE_ID, 0);
+
+    return rv;
+}
+
+/**
+ * @internal
+ * Write a BinaryImage message.
+ */
+static size_t plcrash_async_image_elf_write_binary_image (plcrash_async_file_t *file, const plcrash_async_image_elf_info_t *info) {
+    size_t rv = 0;
+
+    rv += plcrash_writer_pack_uint64(file, PLCRASH_PROTO_BINARY_IMAGE_SIZE_ID, info->size);
+    rv += plcrash_writer_pack_uint64(file, PLCRASH_PROTO_BINARY_IMAGE_ADDR_ID, info->header);
+    rv += plcrash_writer_pack_string(file, PLCRASH_PROTO_BINARY_IMAGE_NAME_ID, info->name);
+
+    /* The build-id takes the place of the Mach-O UUID */
+    if (info->build_id_len > 0)
+        rv += plcrash_writer_pack_bytes(file, PLCRASH_PROTO_BINARY_IMAGE_UUID_ID, info->build_id, info->build_id_len);
+
+    if (info->has_machine) {
+        uint32_t msgsize = plcrash_async_image_elf_write_processor_info(NULL, info->machine);
+
+        rv += plcrash_writer_pack_message_header(file, PLCRASH_PROTO_BINARY_IMAGE_CODE_TYPE_ID, msgsize);
+        rv += plcrash_async_image_elf_write_processor_info(file, info->machine);
+    }
+
+    return rv;
+}
+
+/**
+ * Write a complete CrashReport.binary_images record for an ELF image, including the field tag and length prefix.
+ * If @a file is NULL, no data is written, and the record's length is returned.
+ *
+ * @param file Output file, or NULL.
+ * @param info The image to be written.
+ *
+ * @return Returns the number of bytes written (or that would be written, if @a file is NULL).
+ */
+size_t plcrash_async_image_elf_write_record (plcrash_async_file_t *file, const plcrash_async_image_elf_info_t *info) {
+    size_t rv = 0;
+    uint32_t size;
+
+    size = plcrash_async_image_elf_write_binary_image(NULL, info);
+    rv += plcrash_writer_pack_message_header(file, PLCRASH_PROTO_BINARY_IMAGES_ID, size);
+    rv += plcrash_async_image_elf_write_binary_image(file, info);
+
+    return rv;
+}
+
+/**
+ * @internal
+ * Update context for plcrash_async_image_elf_update_callback().
+ */
+typedef struct plcrash_async_image_elf_update_ctx {
+    /** The list being updated. */
+    plcrash_async_image_list_t *list;
+
+    /** The header addresses of all loaded images. */
+    uintptr_t *loaded;
+
+    /** The number of elements in @a loaded. */
+    size_t loaded_count;
+
+    /** The number of elements allocated for @a loaded. */
+    size_t loaded_capacity;
+
+    /** The loaded images that are not yet registered with the list. */
+    plcrash_async_image_elf_info_t *added;
+
+    /** The number of elements in @a added. */
+    size_t added_count;
+
+    /** The number of elements allocated for @a added. */
+    size_t added_capacity;
+
+    /** Storage for the main executable's path. */
+    char exe_path[MAXPATHLEN];
+
+    /** If true, an allocation failed, and iteration was terminated. */
+    bool failed;
+} plcrash_async_image_elf_update_ctx_t;
+
+/**
+ * @internal
+ * Ensure that the array at @a elements may hold @a count elements of @a size bytes, growing it if necessary.
+ *
+ * @return Returns false if the array could not be grown.
+ */
+static bool plcrash_async_image_elf_reserve (void **elements, size_t *capacity, size_t count, size_t size) {
+    if (count <= *capacity)
+        return true;
+
+    size_t new_capacity = (*capacity == 0) ? 64 : *capacity * 2;
+    void *new_elements = realloc(*elements, new_capacity * size);
+    if (new_elements == NULL)
+        return false;
+
+    *elements = new_elements;
+    *capacity = new_capacity;
+    return true;
+}
+
+/**
+ * @internal
+ * dl_iterate_phdr() callback; records the header address of each loaded image, and the program header data of any
+ * loaded image that is not yet registered with the list.
+ */
+static int plcrash_async_image_elf_update_callback (struct dl_phdr_info *phdr_info, size_t size, void *data) {
+    plcrash_async_image_elf_update_ctx_t *ctx = data;
+    plcrash_async_image_elf_info_t info;
+
+    if (!plcrash_async_image_elf_parse(phdr_info, &info))
+        return 0;
+
+    if (!plcrash_async_image_elf_reserve((void **) &ctx->loaded, &ctx->loaded_capacity, ctx->loaded_count + 1, sizeof(ctx->loaded[0]))) {
+        ctx->failed = true;
+        return 1;
+    }
+    ctx->loaded[ctx->loaded_count++] = info.header;
+
+    /* Skip images that have already been registered */
+    if (plcrash_async_image_list_contains(ctx->list, info.header))
+        return 0;
+
+    /* The main executable is reported with an empty name */
+    if (info.name == NULL || info.name[0] == '\0') {
+        ssize_t len = readlink("/proc/self/exe", ctx->exe_path, sizeof(ctx->exe_path) - 1);
+        if (len < 0)
+            len = 0;
+
+        ctx->exe_path[len] = '\0';
+        info.name = ctx->exe_path;
+    }
+
+    if (!plcrash_async_image_elf_reserve((void **) &ctx->added, &ctx->added_capacity, ctx->added_count + 1, sizeof(ctx->added[0]))) {
+        ctx->failed = true;
+        return 1;
+    }
+    ctx->added[ctx->added_count++] = info;
+
+    return 0;
+}
+
+/**
+ * @internal
+ * qsort() and bsearch() comparison function for header addresses.
+ */
+static int plcrash_async_image_elf_header_compare (const void *a, const void *b) {
+    uintptr_t lhs = *(const uintptr_t *) a;
+    uintptr_t rhs = *(const uintptr_t *) b;
+
+    if (lhs < rhs)
+        return -1;
+    else if (lhs > rhs)
+        return 1;
+    return 0;
+}
+
+/**
+ * Bring @a list up to date with the ELF objects currently loaded in the process. Objects that are not yet
+ * registered are appended to the list, and registered objects that are no longer loaded are removed.
+ *
+ * The loaded objects are enumerated with a single dl_iterate_phdr() pass. Registration is checked via the list's
+ * header address hash table, and only newly loaded objects have their report records encoded; these are appended to
+ * the list as a single batch.
+ *
+ * @param list The list to be updated. This list should be populated exclusively by this function.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or PLCRASH_ENOMEM if the loaded objects could not be recorded.
+ *
+ * @warning This function is not async safe, and must be called outside of a signal handler.
+ */
+plcrash_error_t plcrash_async_image_elf_list_update (plcrash_async_image_list_t *list) {
+    plcrash_async_image_elf_update_ctx_t ctx;
+    plcrash_async_image_entry_t *entries = NULL;
+    plcrash_async_file_t buffer;
+    uint8_t *records = NULL;
+    size_t records_len = 0;
+    plcrash_async_image_t *image;
+    plcrash_async_image_t *next;
+    plcrash_error_t err = PLCRASH_ESUCCESS;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.list = list;
+
+    /* Enumerate the loaded images */
+    dl_iterate_phdr(plcrash_async_image_elf_update_callback, &ctx);
+    if (ctx.failed) {
+        PLCF_DEBUG("Could not allocate the loaded image list");
+        err = PLCRASH_ENOMEM;
+        goto cleanup;
+    }
+
+    /* Remove unloaded images. The list's images are only removed by this function, and need not be retained for
+     * reading during iteration. */
+    qsort(ctx.loaded, ctx.loaded_count, sizeof(ctx.loaded[0]), plcrash_async_image_elf_header_compare);
+
+    next = plcrash_async_image_list_next(list, NULL);
+    while ((image = next) != NULL) {
+        uintptr_t header = image->header;
+
+        next = plcrash_async_image_list_next(list, image);
+        if (bsearch(&header, ctx.loaded, ctx.loaded_count, sizeof(ctx.loaded[0]), plcrash_async_image_elf_header_compare) == NULL)
+            plcrash_async_image_list_remove(list, header);
+    }
+
+    /* Add new images */
+    if (ctx.added_count == 0)
+        goto cleanup;
+
+    entries = malloc(ctx.added_count * sizeof(*entries));
+    if (entries == NULL) {
+        PLCF_DEBUG("Could not allocate image batch");
+        err = PLCRASH_ENOMEM;
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < ctx.added_count; i++) {
+        entries[i].header = ctx.added[i].header;
+        entries[i].size = ctx.added[i].size;
+        entries[i].name = ctx.added[i].name;
+        entries[i].record_len = plcrash_async_image_elf_write_record(NULL, &ctx.added[i]);
+        records_len += entries[i].record_len;
+    }
+
+    /* Pre-encode the image records. If unavailable, the images are registered without records. */
+    if ((records = malloc(records_len)) != NULL) {
+        plcrash_async_file_init_mem(&buffer, records, records_len);
+        for (size_t i = 0; i < ctx.added_count; i++) {
+            entries[i].record = records + plcrash_async_file_offset(&buffer);
+            plcrash_async_image_elf_write_record(&buffer, &ctx.added[i]);
+        }
+    } else {
+        for (size_t i = 0; i < ctx.added_count; i++) {
+            entries[i].record = NULL;
+            entries[i].record_len = 0;
+        }
+    }
+
+    plcrash_async_image_list_append_batch(list, entries, ctx.added_count);
+
+cleanup:
+    if (records != NULL)
+        free(records);
+    if (entries != NULL)
+        free(entries);
+    if (ctx.added != NULL)
+        free(ctx.added);
+    if (ctx.loaded != NULL)
+        free(ctx.loaded);
+
+    return err;
+}
+
+/**
+ * @}
+ */
+
+#endif /* __linux__ */
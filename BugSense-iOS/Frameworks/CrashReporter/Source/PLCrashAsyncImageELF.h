@@ -0,0 +1,78 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifdef __linux__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#import "PLCrashAsync.h"
+#import "PLCrashAsyncImage.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_async_image_elf
+ *
+ * The maximum GNU build-id length that will be recorded for an image. Longer build-ids are truncated.
+ */
+#define PLCRASH_ASYNC_IMAGE_ELF_BUILD_ID_MAX 64
+
+/**
+ * @internal
+ * @ingroup plcrash_async_image_elf
+ *
+ * ELF binary image information, as parsed from the image's program headers.
+ */
+typedef struct plcrash_async_image_elf_info {
+    /** The image's header address; the address at which the image's first loadable segment is mapped. */
+    uintptr_t header;
+
+    /** The extent of the image's executable segment, measured from the header address. */
+    uint64_t size;
+
+    /** The image's path. */
+    const char *name;
+
+    /** If true, the image's ELF header was readable, and @a machine is valid. */
+    bool has_machine;
+
+    /** The image's ELF machine type (e_machine). */
+    uint16_t machine;
+
+    /** The image's GNU build-id. */
+    uint8_t build_id[PLCRASH_ASYNC_IMAGE_ELF_BUILD_ID_MAX];
+
+    /** The length of @a build_id, in bytes, or 0 if the image has no build-id. */
+    size_t build_id_len;
+} plcrash_async_image_elf_info_t;
+
+size_t plcrash_async_image_elf_write_record (plcrash_async_file_t *file, const plcrash_async_image_elf_info_t *info);
+plcrash_error_t plcrash_async_image_elf_list_update (plcrash_async_image_list_t *list);
+
+#endif /* __linux__ */
@@ -29,6 +29,7 @@
 #import "GTMSenTestCase.h"
 
 #import "PLCrashAsyncImage.h"
+#import "PLCrashAsyncImageELF.h"
 
 @interface PLCrashAsyncImageTests : SenTestCase {
     plcrash_async_image_list_t _list;
@@ -47,15 +48,15 @@
 }
 
 - (void) testAppendImage {
-    plcrash_async_image_list_append(&_list, 0x0, "image_name");
+    plcrash_async_image_list_append(&_list, 0x0, 0, "image_name", NULL, 0);
 
     STAssertNotNULL(_list.head, @"List HEAD should be set to our new image entry");
     STAssertEquals(_list.head, _list.tail, @"The list head and tail should be equal for the first entry");
     
-    plcrash_async_image_list_append(&_list, 0x1, "image_name");
-    plcrash_async_image_list_append(&_list, 0x2, "image_name");
-    plcrash_async_image_list_append(&_list, 0x3, "image_name");
-    plcrash_async_image_list_append(&_list, 0x4, "image_name");
+    plcrash_async_image_list_append(&_list, 0x1, 0, "image_name", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x2, 0, "image_name", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x3, 0, "image_name", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x4, 0, "image_name", NULL, 0);
     
     /* Verify the appended elements */
     plcrash_async_image_t *item = NULL;
@@ -76,9 +77,27 @@
 }
 
 
+- (void) testAppendRecord {
+    const uint8_t record[] = { 0x22, 0x02, 0x08, 0x01 };
+
+    plcrash_async_image_list_append(&_list, 0x0, 0x1000, "image_name", record, sizeof(record));
+    plcrash_async_image_list_append(&_list, 0x1, 0, "image_name", NULL, 0);
+
+    plcrash_async_image_t *item = plcrash_async_image_list_next(&_list, NULL);
+    STAssertEquals((uint64_t) 0x1000, item->size, @"Incorrect image size");
+    STAssertNotNULL(item->record, @"Record should be set");
+    STAssertTrue(item->record != record, @"Record should have been copied");
+    STAssertEquals(sizeof(record), item->record_len, @"Incorrect record length");
+    STAssertTrue(memcmp(record, item->record, sizeof(record)) == 0, @"Incorrect record value");
+
+    item = plcrash_async_image_list_next(&_list, item);
+    STAssertNULL(item->record, @"Record should not be set");
+    STAssertEquals((size_t) 0, item->record_len, @"Record length should be 0");
+}
+
 /* Test removing the last image in the list. */
 - (void) testRemoveLastImage {
-    plcrash_async_image_list_append(&_list, 0x0, "image_name");
+    plcrash_async_image_list_append(&_list, 0x0, 0, "image_name", NULL, 0);
     plcrash_async_image_list_remove(&_list, 0x0);
 
     STAssertNULL(_list.head, @"List HEAD should now be NULL");
@@ -86,11 +105,11 @@
 }
 
 - (void) testRemoveImage {
-    plcrash_async_image_list_append(&_list, 0x0, "image_name");
-    plcrash_async_image_list_append(&_list, 0x1, "image_name");
-    plcrash_async_image_list_append(&_list, 0x2, "image_name");
-    plcrash_async_image_list_append(&_list, 0x3, "image_name");
-    plcrash_async_image_list_append(&_list, 0x4, "image_name");
+    plcrash_async_image_list_append(&_list, 0x0, 0, "image_name", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x1, 0, "image_name", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x2, 0, "image_name", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x3, 0, "image_name", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x4, 0, "image_name", NULL, 0);
 
     /* Try a non-existent item */
     plcrash_async_image_list_remove(&_list, 0x42);
@@ -119,4 +138,285 @@
     }
 }
 
+- (void) testFindImage {
+    uint32_t position;
+
+    /* Append out of address order, including an image of unknown size */
+    plcrash_async_image_list_append(&_list, 0x3000, 0x1000, "image_3", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x1000, 0x1000, "image_1", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x5000, 0, "image_5", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x2000, 0x800, "image_2", NULL, 0);
+
+    plcrash_async_image_list_set_reading(&_list, true);
+
+    plcrash_async_image_t *image = plcrash_async_image_list_find(&_list, 0x1000, &position);
+    STAssertNotNULL(image, @"Image should be found");
+    STAssertEqualCStrings("image_1", image->name, @"Incorrect image");
+    STAssertEquals((uint32_t) 1, position, @"Incorrect list position");
+
+    image = plcrash_async_image_list_find(&_list, 0x27FF, &position);
+    STAssertNotNULL(image, @"Image should be found");
+    STAssertEqualCStrings("image_2", image->name, @"Incorrect image");
+    STAssertEquals((uint32_t) 3, position, @"Incorrect list position");
+
+    image = plcrash_async_image_list_find(&_list, 0x3FFF, &position);
+    STAssertNotNULL(image, @"Image should be found");
+    STAssertEqualCStrings("image_3", image->name, @"Incorrect image");
+    STAssertEquals((uint32_t) 0, position, @"Incorrect list position");
+
+    /* Addresses outside of any image, or within an image of unknown size */
+    STAssertNULL(plcrash_async_image_list_find(&_list, 0x0FFF, NULL), @"Address below all images should not be found");
+    STAssertNULL(plcrash_async_image_list_find(&_list, 0x2800, NULL), @"Address between images should not be found");
+    STAssertNULL(plcrash_async_image_list_find(&_list, 0x5000, NULL), @"Image of unknown size should not be found");
+
+    plcrash_async_image_list_set_reading(&_list, false);
+}
+
+- (void) testFindRemovedImage {
+    uint32_t position;
+
+    plcrash_async_image_list_append(&_list, 0x1000, 0x1000, "image_1", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x2000, 0x1000, "image_2", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x3000, 0x1000, "image_3", NULL, 0);
+    plcrash_async_image_list_remove(&_list, 0x2000);
+
+    STAssertNULL(plcrash_async_image_list_find(&_list, 0x2000, NULL), @"Removed image should not be found");
+
+    /* Positions of the following images must be updated */
+    plcrash_async_image_t *image = plcrash_async_image_list_find(&_list, 0x3000, &position);
+    STAssertNotNULL(image, @"Image should be found");
+    STAssertEquals((uint32_t) 1, position, @"Incorrect list position");
+}
+
+/* Removed images must not be reused while a reader is active. */
+- (void) testRemoveWhileReading {
+    plcrash_async_image_list_append(&_list, 0x1000, 0x1000, "image_1", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x2000, 0x1000, "image_2", NULL, 0);
+
+    plcrash_async_image_list_set_reading(&_list, true);
+    plcrash_async_image_t *removed = plcrash_async_image_list_next(&_list, NULL);
+    plcrash_async_image_list_remove(&_list, 0x1000);
+
+    /* The removed node must remain intact, and must still lead to the remainder of the list */
+    plcrash_async_image_list_append(&_list, 0x3000, 0x1000, "image_3", NULL, 0);
+    STAssertEquals((uintptr_t) 0x1000, removed->header, @"Removed node was reused while reading");
+    STAssertEqualCStrings("image_1", removed->name, @"Removed node was reused while reading");
+    STAssertNotNULL(removed->next, @"Removed node's next pointer should be preserved");
+    STAssertEquals((uintptr_t) 0x2000, removed->next->header, @"Incorrect next node");
+    plcrash_async_image_list_set_reading(&_list, false);
+
+    /* Once no readers remain, the node may be reused */
+    plcrash_async_image_list_append(&_list, 0x4000, 0x1000, "image_4", NULL, 0);
+    plcrash_async_image_list_remove(&_list, 0x4000);
+    plcrash_async_image_list_append(&_list, 0x5000, 0x1000, "image_5", NULL, 0);
+
+    uint32_t position;
+    plcrash_async_image_t *image = plcrash_async_image_list_find(&_list, 0x5000, &position);
+    STAssertNotNULL(image, @"Image should be found");
+    STAssertEqualCStrings("image_5", image->name, @"Incorrect image");
+    STAssertEquals((uint32_t) 2, position, @"Incorrect list position");
+}
+
+- (void) testAppendBatch {
+    const uint8_t record[] = { 0x22, 0x02, 0x08, 0x01 };
+    plcrash_async_image_entry_t entries[PLCRASH_ASYNC_IMAGE_CHUNK_NODES * 2];
+    char names[PLCRASH_ASYNC_IMAGE_CHUNK_NODES * 2][32];
+    size_t count = sizeof(entries) / sizeof(entries[0]);
+
+    /* Append an initial image, followed by a batch that requires growing the node pool */
+    plcrash_async_image_list_append(&_list, 0x0, 0x1000, "image_initial", NULL, 0);
+
+    for (size_t i = 0; i < count; i++) {
+        snprintf(names[i], sizeof(names[i]), "image_%zu", i);
+        entries[i].header = 0x1000 * (count - i);
+        entries[i].size = 0x1000;
+        entries[i].name = names[i];
+        entries[i].record = (i % 2 == 0) ? record : NULL;
+        entries[i].record_len = (i % 2 == 0) ? sizeof(record) : 0;
+    }
+    plcrash_async_image_list_append_batch(&_list, entries, count);
+
+    /* Verify the list order and contents */
+    plcrash_async_image_t *item = plcrash_async_image_list_next(&_list, NULL);
+    STAssertEqualCStrings("image_initial", item->name, @"Incorrect name value");
+
+    for (size_t i = 0; i < count; i++) {
+        item = plcrash_async_image_list_next(&_list, item);
+        STAssertNotNULL(item, @"Item should not be NULL");
+        STAssertEquals(entries[i].header, item->header, @"Incorrect header value");
+        STAssertEqualCStrings(names[i], item->name, @"Incorrect name value");
+
+        if (i % 2 == 0) {
+            STAssertEquals(sizeof(record), item->record_len, @"Incorrect record length");
+            STAssertTrue(memcmp(record, item->record, sizeof(record)) == 0, @"Incorrect record value");
+        } else {
+            STAssertNULL(item->record, @"Record should not be set");
+        }
+    }
+    STAssertNULL(plcrash_async_image_list_next(&_list, item), @"Item should be NULL");
+    STAssertEquals(item, _list.tail, @"The list tail should be the last batch entry");
+
+    /* Verify that the batch was indexed */
+    uint32_t position;
+    item = plcrash_async_image_list_find(&_list, 0x1000 * count, &position);
+    STAssertNotNULL(item, @"Image should be found");
+    STAssertEqualCStrings("image_0", item->name, @"Incorrect image");
+    STAssertEquals((uint32_t) 1, position, @"Incorrect list position");
+}
+
+/* Images that are already registered, or repeated within a batch, must be skipped */
+- (void) testAppendDuplicates {
+    plcrash_async_image_entry_t entries[] = {
+        { .header = 0x2000, .size = 0x1000, .name = "image_2" },
+        { .header = 0x1000, .size = 0x1000, .name = "image_1_duplicate" },
+        { .header = 0x3000, .size = 0x1000, .name = "image_3" },
+        { .header = 0x2000, .size = 0x1000, .name = "image_2_duplicate" }
+    };
+
+    plcrash_async_image_list_append(&_list, 0x1000, 0x1000, "image_1", NULL, 0);
+    plcrash_async_image_list_append_batch(&_list, entries, sizeof(entries) / sizeof(entries[0]));
+    plcrash_async_image_list_append(&_list, 0x3000, 0x1000, "image_3_duplicate", NULL, 0);
+
+    /* Verify the list contents */
+    const char *names[] = { "image_1", "image_2", "image_3" };
+    plcrash_async_image_t *item = NULL;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        item = plcrash_async_image_list_next(&_list, item);
+        STAssertNotNULL(item, @"Item should not be NULL");
+        STAssertEqualCStrings(names[i], item->name, @"Incorrect name value");
+        STAssertEquals(item, plcrash_async_image_list_find(&_list, item->header, NULL), @"Image should be found");
+    }
+    STAssertNULL(plcrash_async_image_list_next(&_list, item), @"Item should be NULL");
+    STAssertEquals(item, _list.tail, @"The list tail should be the last appended image");
+    STAssertEquals((uint32_t) 3, _list.count, @"Incorrect image count");
+
+    /* A removed image may be registered again */
+    plcrash_async_image_list_remove(&_list, 0x2000);
+    plcrash_async_image_list_append(&_list, 0x2000, 0x1000, "image_2_reloaded", NULL, 0);
+    item = plcrash_async_image_list_find(&_list, 0x2000, NULL);
+    STAssertNotNULL(item, @"Image should be found");
+    STAssertEqualCStrings("image_2_reloaded", item->name, @"Incorrect name value");
+    STAssertEquals((uint32_t) 3, _list.count, @"Incorrect image count");
+}
+
+/* Test removal from a list large enough to require growth of the header hash table */
+- (void) testRemoveManyImages {
+    const uintptr_t count = PLCRASH_ASYNC_IMAGE_HASH_MIN_CAPACITY * 2;
+
+    for (uintptr_t i = 0; i < count; i++)
+        plcrash_async_image_list_append(&_list, 0x1000 * i, 0x1000, "image_name", NULL, 0);
+
+    /* Remove the odd images, in reverse order */
+    for (uintptr_t i = count - 1; i < count; i -= 2)
+        plcrash_async_image_list_remove(&_list, 0x1000 * i);
+
+    /* Verify the remaining images, and their positions */
+    plcrash_async_image_t *item = NULL;
+    for (uintptr_t i = 0; i < count; i += 2) {
+        uint32_t position;
+
+        item = plcrash_async_image_list_next(&_list, item);
+        STAssertNotNULL(item, @"Item should not be NULL");
+        STAssertEquals(0x1000 * i, item->header, @"Incorrect header value");
+
+        STAssertEquals(item, plcrash_async_image_list_find(&_list, 0x1000 * i, &position), @"Image should be found");
+        STAssertEquals((uint32_t) (i / 2), position, @"Incorrect list position");
+    }
+    STAssertNULL(plcrash_async_image_list_next(&_list, item), @"Item should be NULL");
+
+    /* Removing an image twice must have no effect */
+    plcrash_async_image_list_remove(&_list, 0x1000);
+    STAssertEquals((uint32_t) (count / 2), _list.count, @"Incorrect image count");
+}
+
+/* Test lookups as images are removed from and appended to the address index */
+- (void) testRemoveIndexedImages {
+    const uintptr_t count = PLCRASH_ASYNC_IMAGE_INDEX_REMOVED_MAX * 3;
+    bool loaded[PLCRASH_ASYNC_IMAGE_INDEX_REMOVED_MAX * 3];
+
+    for (uintptr_t i = 0; i < count; i++) {
+        plcrash_async_image_list_append(&_list, 0x1000 * (i + 1), 0x1000, "image_name", NULL, 0);
+        loaded[i] = true;
+    }
+
+    /* Remove every third image, re-appending one of the removed images after every fourth removal. This requires
+     * both in-place removal and compaction of the index. */
+    uint32_t removed = 0;
+    for (uintptr_t i = 0; i < count; i += 3) {
+        plcrash_async_image_list_remove(&_list, 0x1000 * (i + 1));
+        loaded[i] = false;
+
+        if (++removed % 4 == 0) {
+            plcrash_async_image_list_append(&_list, 0x1000 * (i - 2), 0x1000, "image_name", NULL, 0);
+            loaded[i - 3] = true;
+        }
+
+        /* Every image must be found at its position within the list, and removed images must not be found */
+        uint32_t expected = 0;
+        for (plcrash_async_image_t *item = plcrash_async_image_list_next(&_list, NULL); item != NULL; item = plcrash_async_image_list_next(&_list, item)) {
+            uint32_t position;
+
+            STAssertEquals(item, plcrash_async_image_list_find(&_list, item->header + 0x10, &position), @"Image should be found");
+            STAssertEquals(expected, position, @"Incorrect list position");
+            expected++;
+        }
+        STAssertEquals(_list.count, expected, @"Incorrect image count");
+
+        for (uintptr_t j = 0; j < count; j++) {
+            if (!loaded[j])
+                STAssertNULL(plcrash_async_image_list_find(&_list, 0x1000 * (j + 1), NULL), @"Removed image should not be found");
+        }
+    }
+}
+
+/* test plcrash_async_image_list_contains() */
+- (void) testContains {
+    plcrash_async_image_list_append(&_list, 0x1000, 0x100, "image1", NULL, 0);
+    plcrash_async_image_list_append(&_list, 0x2000, 0x100, "image2", NULL, 0);
+
+    STAssertTrue(plcrash_async_image_list_contains(&_list, 0x1000), @"Appended image not found");
+    STAssertTrue(plcrash_async_image_list_contains(&_list, 0x2000), @"Appended image not found");
+    STAssertFalse(plcrash_async_image_list_contains(&_list, 0x1010), @"Image found by a non-header address");
+
+    plcrash_async_image_list_remove(&_list, 0x1000);
+    STAssertFalse(plcrash_async_image_list_contains(&_list, 0x1000), @"Removed image found");
+    STAssertTrue(plcrash_async_image_list_contains(&_list, 0x2000), @"Remaining image not found");
+}
+
+#ifdef __linux__
+/* test plcrash_async_image_elf_list_update() */
+- (void) testELFListUpdate {
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_image_elf_list_update(&_list), @"Could not update the image list");
+    STAssertTrue(_list.count > 0, @"No images were registered");
+
+    /* The image containing our own code must be registered, with a pre-encoded record */
+    plcrash_async_image_t *image = plcrash_async_image_list_find(&_list, (uintptr_t) &plcrash_async_image_elf_list_update, NULL);
+    STAssertNotNULL(image, @"The image containing the test code was not found");
+    STAssertNotNULL(image->name, @"The image has no name");
+    STAssertNotNULL(image->record, @"The image has no record");
+    STAssertTrue(image->record_len > 0, @"The image record is empty");
+
+    /* An update with no change to the loaded objects must leave the list unchanged */
+    uint32_t count = _list.count;
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_image_elf_list_update(&_list), @"Could not update the image list");
+    STAssertEquals(count, _list.count, @"The image count changed");
+    STAssertEquals(image, plcrash_async_image_list_find(&_list, (uintptr_t) &plcrash_async_image_elf_list_update, NULL), @"The image was replaced");
+}
+
+/* test that plcrash_async_image_elf_list_update() removes images that are no longer loaded */
+- (void) testELFListUpdateRemovesUnloaded {
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_image_elf_list_update(&_list), @"Could not update the image list");
+    uint32_t count = _list.count;
+
+    /* Nothing is loaded at this address */
+    plcrash_async_image_list_append(&_list, 0x1000, 0x100, "unloaded", NULL, 0);
+    STAssertEquals(count + 1, _list.count, @"The image was not appended");
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_image_elf_list_update(&_list), @"Could not update the image list");
+    STAssertEquals(count, _list.count, @"The unloaded image was not removed");
+    STAssertFalse(plcrash_async_image_list_contains(&_list, 0x1000), @"The unloaded image was not removed");
+    STAssertNotNULL(plcrash_async_image_list_find(&_list, (uintptr_t) &plcrash_async_image_elf_list_update, NULL), @"A loaded image was removed");
+}
+#endif
+
 @end
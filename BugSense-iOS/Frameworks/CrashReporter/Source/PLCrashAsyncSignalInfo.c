@@ -132,6 +132,85 @@ struct signal_code signal_codes[] = {
 
     { 0, 0, NULL }
 };
+#elif __linux__
+/* Values derived from <bits/signum.h> */
+struct signal_name signal_names[] = {
+    { SIGHUP,   "SIGHUP" },
+    { SIGINT,   "SIGINT" },
+    { SIGQUIT,  "SIGQUIT" },
+    { SIGILL,   "SIGILL" },
+    { SIGTRAP,  "SIGTRAP" },
+    { SIGABRT,  "SIGABRT" },
+    { SIGBUS,   "SIGBUS" },
+    { SIGFPE,   "SIGFPE" },
+    { SIGKILL,  "SIGKILL" },
+    { SIGUSR1,  "SIGUSR1" },
+    { SIGSEGV,  "SIGSEGV" },
+    { SIGUSR2,  "SIGUSR2" },
+    { SIGPIPE,  "SIGPIPE" },
+    { SIGALRM,  "SIGALRM" },
+    { SIGTERM,  "SIGTERM" },
+    { SIGSTKFLT, "SIGSTKFLT" },
+    { SIGCHLD,  "SIGCHLD" },
+    { SIGCONT,  "SIGCONT" },
+    { SIGSTOP,  "SIGSTOP" },
+    { SIGTSTP,  "SIGTSTP" },
+    { SIGTTIN,  "SIGTTIN" },
+    { SIGTTOU,  "SIGTTOU" },
+    { SIGURG,   "SIGURG" },
+    { SIGXCPU,  "SIGXCPU" },
+    { SIGXFSZ,  "SIGXFSZ" },
+    { SIGVTALRM, "SIGVTALRM" },
+    { SIGPROF,  "SIGPROF" },
+    { SIGWINCH, "SIGWINCH" },
+    { SIGIO,    "SIGIO" },
+    { SIGPWR,   "SIGPWR" },
+    { SIGSYS,   "SIGSYS" },
+    { 0, NULL }
+};
+
+/* Values derived from <bits/siginfo.h> */
+struct signal_code signal_codes[] = {
+    /* SIGILL */
+    { SIGILL,   ILL_ILLOPC,     "ILL_ILLOPC"  },
+    { SIGILL,   ILL_ILLOPN,     "ILL_ILLOPN"  },
+    { SIGILL,   ILL_ILLADR,     "ILL_ILLADR"  },
+    { SIGILL,   ILL_ILLTRP,     "ILL_ILLTRP"  },
+    { SIGILL,   ILL_PRVOPC,     "ILL_PRVOPC"  },
+    { SIGILL,   ILL_PRVREG,     "ILL_PRVREG"  },
+    { SIGILL,   ILL_COPROC,     "ILL_COPROC"  },
+    { SIGILL,   ILL_BADSTK,     "ILL_BADSTK"  },
+
+    /* SIGFPE */
+    { SIGFPE,   FPE_INTDIV,     "FPE_INTDIV"  },
+    { SIGFPE,   FPE_INTOVF,     "FPE_INTOVF"  },
+    { SIGFPE,   FPE_FLTDIV,     "FPE_FLTDIV"  },
+    { SIGFPE,   FPE_FLTOVF,     "FPE_FLTOVF"  },
+    { SIGFPE,   FPE_FLTUND,     "FPE_FLTUND"  },
+    { SIGFPE,   FPE_FLTRES,     "FPE_FLTRES"  },
+    { SIGFPE,   FPE_FLTINV,     "FPE_FLTINV"  },
+    { SIGFPE,   FPE_FLTSUB,     "FPE_FLTSUB"  },
+
+    /* SIGSEGV */
+    { SIGSEGV,  SEGV_MAPERR,    "SEGV_MAPERR" },
+    { SIGSEGV,  SEGV_ACCERR,    "SEGV_ACCERR" },
+
+    /* SIGBUS */
+    { SIGBUS,   BUS_ADRALN,     "BUS_ADRALN"  },
+    { SIGBUS,   BUS_ADRERR,     "BUS_ADRERR"  },
+    { SIGBUS,   BUS_OBJERR,     "BUS_OBJERR"  },
+
+#ifdef TRAP_BRKPT
+    /* SIGTRAP (glibc only defines these with _XOPEN_SOURCE or _GNU_SOURCE) */
+    { SIGTRAP,  TRAP_BRKPT,     "TRAP_BRKPT"  },
+    { SIGTRAP,  TRAP_TRACE,     "TRAP_TRACE"  },
+#endif
+
+    /* SIGABRT */
+    { SIGABRT,  0,              "#0"          },
+
+    { 0, 0, NULL }
+};
 #else
 #error Unsupported Platform
 #endif
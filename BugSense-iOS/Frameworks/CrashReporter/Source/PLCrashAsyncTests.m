@@ -31,6 +31,9 @@
 
 #import <fcntl.h>
 #import <sys/stat.h>
+#import <sys/mman.h>
+#import <mach/mach.h>
+#import <mach/mach_time.h>
 
 @interface PLCrashAsyncTests : SenTestCase {
 @private
@@ -108,6 +111,224 @@
     STAssertEquals((off_t)8, fs.st_size, @"File size is not 8 bytes");
 }
 
+- (void) testPatchWrite {
+    plcrash_async_file_t file;
+    unsigned char data[400];
+    const unsigned char patch[] = { 0xA, 0xB, 0xC, 0xD };
+    
+    STAssertTrue(sizeof(data) > PLCRASH_ASYNC_FILE_DEFAULT_BUFFER_SIZE, @"Test is invalid if our buffer is not larger");
+
+    /* Initialize the file instance */
+    plcrash_async_file_init(&file, _testFd, 0);
+    
+    /* Create test data */
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = i & 0xFF;
+
+    /* Write out the test data; the first half is flushed, the second half remains buffered. */
+    STAssertTrue(plcrash_async_file_write(&file, data, sizeof(data) / 2), @"Failed to write to output buffer");
+    STAssertTrue(plcrash_async_file_write(&file, data + sizeof(data) / 2, sizeof(data) / 2), @"Failed to write to output buffer");
+    STAssertEquals((off_t) sizeof(data), plcrash_async_file_offset(&file), @"Incorrect output offset");
+    
+    /* Patch a flushed range, a buffered range, and a range that spans both */
+    STAssertTrue(plcrash_async_file_pwrite(&file, 10, patch, sizeof(patch)), @"Failed to patch flushed data");
+    STAssertTrue(plcrash_async_file_pwrite(&file, sizeof(data) - sizeof(patch), patch, sizeof(patch)), @"Failed to patch buffered data");
+    STAssertTrue(plcrash_async_file_pwrite(&file, sizeof(data) / 2 - 2, patch, sizeof(patch)), @"Failed to patch spanning data");
+    STAssertFalse(plcrash_async_file_pwrite(&file, sizeof(data) - 2, patch, sizeof(patch)), @"Patched beyond the written data");
+    
+    memcpy(data + 10, patch, sizeof(patch));
+    memcpy(data + sizeof(data) - sizeof(patch), patch, sizeof(patch));
+    memcpy(data + sizeof(data) / 2 - 2, patch, sizeof(patch));
+
+    /* Subsequent writes must be appended */
+    STAssertTrue(plcrash_async_file_write(&file, patch, sizeof(patch)), @"Failed to write to output buffer");
+    STAssertTrue(plcrash_async_file_close(&file), @"File not closed");
+
+    /* Validate the test file */
+    NSData *written = [NSData dataWithContentsOfFile: _outputFile];
+    STAssertEquals([written length], sizeof(data) + sizeof(patch), @"Incorrect file length");
+    STAssertTrue(memcmp([written bytes], data, sizeof(data)) == 0, @"Patched data does not match");
+    STAssertTrue(memcmp((const uint8_t *)[written bytes] + sizeof(data), patch, sizeof(patch)) == 0, @"Appended data does not match");
+}
+
+- (void) testReferenceWrite {
+    plcrash_async_file_t file;
+    unsigned char data[PLCRASH_ASYNC_FILE_REF_MIN * 2];
+    unsigned char expected[(PLCRASH_ASYNC_FILE_IOV_MAX + 1) * (sizeof(data) + 1)];
+    const unsigned char patch = 0xFF;
+    size_t len = 0;
+
+    /* Initialize the file instance */
+    plcrash_async_file_init(&file, _testFd, 0);
+
+    /* Create test data */
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = i & 0xFF;
+
+    /* Interleave buffered and referenced writes, overflowing the segment queue */
+    for (unsigned char i = 0; i < PLCRASH_ASYNC_FILE_IOV_MAX + 1; i++) {
+        STAssertTrue(plcrash_async_file_write(&file, &i, sizeof(i)), @"Failed to write to output buffer");
+        STAssertTrue(plcrash_async_file_write_ref(&file, data, sizeof(data)), @"Failed to queue data");
+
+        expected[len++] = i;
+        memcpy(expected + len, data, sizeof(data));
+        len += sizeof(data);
+    }
+    STAssertEquals((off_t) len, plcrash_async_file_offset(&file), @"Incorrect output offset");
+
+    /* Patch a buffered byte that is still queued */
+    STAssertTrue(plcrash_async_file_pwrite(&file, len - sizeof(data) - 1, &patch, sizeof(patch)), @"Failed to patch buffered data");
+    expected[len - sizeof(data) - 1] = patch;
+
+    /* Referenced data may not be patched */
+    STAssertFalse(plcrash_async_file_pwrite(&file, len - 1, &patch, sizeof(patch)), @"Patched referenced data");
+
+    STAssertTrue(plcrash_async_file_close(&file), @"File not closed");
+
+    /* Validate the test file */
+    NSData *written = [NSData dataWithContentsOfFile: _outputFile];
+    STAssertEquals([written length], len, @"Incorrect file length");
+    STAssertTrue(memcmp([written bytes], expected, len) == 0, @"Written data does not match");
+}
+
+/* A referenced write that fails to flush the segment queue must not advance the output offset */
+- (void) testReferenceWriteFailure {
+    plcrash_async_file_t file;
+    unsigned char data[PLCRASH_ASYNC_FILE_REF_MIN * 2];
+    int fd;
+
+    memset(data, 0xA, sizeof(data));
+
+    /* Writes to a read-only descriptor will fail once the queue is flushed */
+    fd = open([_outputFile UTF8String], O_RDONLY);
+    STAssertTrue(fd >= 0, @"Could not open test output file");
+    plcrash_async_file_init(&file, fd, 0);
+
+    for (size_t i = 0; i < PLCRASH_ASYNC_FILE_IOV_MAX; i++)
+        STAssertTrue(plcrash_async_file_write_ref(&file, data, sizeof(data)), @"Failed to queue data");
+
+    STAssertFalse(plcrash_async_file_write_ref(&file, data, sizeof(data)), @"Queue flush should fail");
+    STAssertEquals((off_t) (PLCRASH_ASYNC_FILE_IOV_MAX * sizeof(data)), plcrash_async_file_offset(&file), @"Incorrect output offset");
+
+    close(fd);
+}
+
+- (void) testMemoryWrite {
+    plcrash_async_file_t file;
+    unsigned char output[300];
+    unsigned char data[sizeof(output)];
+    const unsigned char patch[] = { 0xA, 0xB, 0xC, 0xD };
+
+    STAssertTrue(sizeof(data) > PLCRASH_ASYNC_FILE_DEFAULT_BUFFER_SIZE, @"Test is invalid if our buffer is not larger");
+
+    /* Initialize the memory-backed file instance */
+    plcrash_async_file_init_mem(&file, output, sizeof(output));
+
+    /* Create test data */
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = i & 0xFF;
+
+    /* Fill the output buffer; writes beyond its size must fail */
+    STAssertTrue(plcrash_async_file_write(&file, data, sizeof(data) - 1), @"Failed to write to output buffer");
+    STAssertFalse(plcrash_async_file_write(&file, data, 2), @"Wrote beyond the end of the output buffer");
+    STAssertTrue(plcrash_async_file_write(&file, data + sizeof(data) - 1, 1), @"Failed to write to output buffer");
+    STAssertEquals((off_t) sizeof(data), plcrash_async_file_offset(&file), @"Incorrect output offset");
+
+    /* Patch previously written data */
+    STAssertTrue(plcrash_async_file_pwrite(&file, 10, patch, sizeof(patch)), @"Failed to patch data");
+    memcpy(data + 10, patch, sizeof(patch));
+
+    /* Flushing and closing are no-ops */
+    STAssertTrue(plcrash_async_file_flush(&file), @"Flush failed");
+    STAssertTrue(plcrash_async_file_close(&file), @"Close failed");
+
+    STAssertTrue(memcmp(output, data, sizeof(data)) == 0, @"Written data does not match");
+}
+
+- (void) testMappedWrite {
+    plcrash_async_file_t file;
+    unsigned char data[300];
+    size_t size = 4096;
+    void *mapping;
+
+    /* Size and map the test file */
+    STAssertEquals(0, ftruncate(_testFd, size), @"Could not size test file");
+    mapping = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, _testFd, 0);
+    STAssertTrue(mapping != MAP_FAILED, @"Could not map test file");
+
+    plcrash_async_file_init_mapped(&file, _testFd, mapping, size);
+
+    /* Create test data */
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = i & 0xFF;
+
+    /* Write out the test data */
+    STAssertTrue(plcrash_async_file_write(&file, data, sizeof(data)), @"Failed to write to mapped file");
+    STAssertFalse(plcrash_async_file_write(&file, data, size), @"Wrote beyond the end of the mapping");
+    STAssertTrue(plcrash_async_file_close(&file), @"File not closed");
+    munmap(mapping, size);
+
+    /* The file must be truncated to the written data */
+    NSData *written = [NSData dataWithContentsOfFile: _outputFile];
+    STAssertEquals([written length], sizeof(data), @"Incorrect file length");
+    STAssertTrue(memcmp([written bytes], data, sizeof(data)) == 0, @"Written data does not match");
+}
+
+/* Return the number of BSD system calls issued by this task */
+static uint32_t unix_syscall_count (void) {
+    task_events_info_data_t info;
+    mach_msg_type_number_t count = TASK_EVENTS_INFO_COUNT;
+
+    if (task_info(mach_task_self(), TASK_EVENTS_INFO, (task_info_t) &info, &count) != KERN_SUCCESS)
+        return 0;
+
+    return info.syscalls_unix;
+}
+
+/*
+ * Benchmark output of a simulated report (a mix of small tag/varint writes and short strings) against the
+ * output buffer size. Results are logged, and are not validated.
+ */
+- (void) testBufferSizeBenchmark {
+    const size_t buffer_sizes[] = { PLCRASH_ASYNC_FILE_DEFAULT_BUFFER_SIZE, 4 * 1024, 16 * 1024, 64 * 1024 };
+    const size_t report_sizes[] = { 8 * 1024, 32 * 1024, 64 * 1024 };
+    const char field[] = "\x0a\x28/System/Library/Frameworks/Foundation.framework";
+    mach_timebase_info_data_t timebase;
+    void *buffer = malloc(64 * 1024);
+
+    mach_timebase_info(&timebase);
+
+    for (size_t r = 0; r < sizeof(report_sizes) / sizeof(report_sizes[0]); r++) {
+        for (size_t b = 0; b < sizeof(buffer_sizes) / sizeof(buffer_sizes[0]); b++) {
+            plcrash_async_file_t file;
+
+            STAssertEquals(0, ftruncate(_testFd, 0), @"Could not truncate test file");
+            STAssertEquals((off_t) 0, lseek(_testFd, 0, SEEK_SET), @"Could not reset test file");
+
+            uint32_t syscalls = unix_syscall_count();
+            uint64_t start = mach_absolute_time();
+
+            plcrash_async_file_init(&file, _testFd, 0);
+            if (buffer_sizes[b] > PLCRASH_ASYNC_FILE_DEFAULT_BUFFER_SIZE)
+                plcrash_async_file_set_buffer(&file, buffer, buffer_sizes[b]);
+
+            while (plcrash_async_file_offset(&file) < (off_t) report_sizes[r]) {
+                plcrash_async_file_write(&file, field, 2);
+                plcrash_async_file_write(&file, field + 2, sizeof(field) - 3);
+            }
+            plcrash_async_file_flush(&file);
+
+            uint64_t elapsed = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+            syscalls = unix_syscall_count() - syscalls;
+
+            NSLog(@"Report %6zu bytes, buffer %6zu bytes: %5u syscalls, %8llu ns", report_sizes[r], buffer_sizes[b],
+                  syscalls, (unsigned long long) elapsed);
+        }
+    }
+
+    free(buffer);
+}
+
 /*
  * Read in the test file, verify that it matches the given data block. Returns the
  * total number of bytes read (which may be less than the data block, which will
@@ -133,7 +354,7 @@
     unsigned char data[100];
     size_t nread = 0;
     
-    STAssertTrue(sizeof(data) * write_iterations > sizeof(file.buffer), @"Test is invalid if our buffer is not larger");
+    STAssertTrue(sizeof(data) * write_iterations > PLCRASH_ASYNC_FILE_DEFAULT_BUFFER_SIZE, @"Test is invalid if our buffer is not larger");
 
     /* Initialize the file instance */
     plcrash_async_file_init(&file, _testFd, 0);
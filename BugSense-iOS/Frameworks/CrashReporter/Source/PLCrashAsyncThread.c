@@ -0,0 +1,355 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#import "PLCrashAsyncThread.h"
+
+#ifdef __linux__
+
+#import <errno.h>
+#import <fcntl.h>
+#import <signal.h>
+#import <string.h>
+#import <time.h>
+#import <linux/futex.h>
+#import <sys/syscall.h>
+
+/**
+ * @internal
+ * @ingroup plcrash_async
+ * @defgroup plcrash_async_thread Async-safe Thread Access (Linux)
+ *
+ * Implements async-safe enumeration, suspension, and state capture of the current process' threads on Linux,
+ * providing the equivalents of the Mach task_threads(), thread_suspend(), thread_get_state() and thread_resume()
+ * calls used by the frame walker and log writer.
+ *
+ * Linux provides no in-process equivalent of thread_suspend(). Instead, a thread is suspended by sending it a
+ * real-time signal; the signal handler publishes the thread's interrupted context, and then waits (via a futex)
+ * until the thread is resumed. As the handler runs below the interrupted stack pointer, the interrupted frames
+ * are not modified while the thread is suspended.
+ * @{
+ */
+
+/** The signal used to suspend threads, relative to SIGRTMIN. */
+#define PLCRASH_ASYNC_THREAD_SIGNAL_OFFSET 4
+
+/** The maximum time to wait for a thread to handle a suspension request, in milliseconds. */
+#define PLCRASH_ASYNC_THREAD_SUSPEND_TIMEOUT_MS 250
+
+/**
+ * @internal
+ * Suspension slot states.
+ */
+typedef enum {
+    /** A suspension request has been sent to the thread. */
+    PLCRASH_ASYNC_THREAD_REQUESTED = 1,
+
+    /** The thread has published its context and is waiting to be resumed. */
+    PLCRASH_ASYNC_THREAD_PARKED,
+
+    /** The thread has been resumed; the slot will be released by the thread. */
+    PLCRASH_ASYNC_THREAD_RESUMED,
+
+    /** The request timed out before the thread handled it; the slot will be released by the thread, should the
+     * request ever be handled. */
+    PLCRASH_ASYNC_THREAD_ABANDONED
+} plcrash_async_thread_state_t;
+
+/**
+ * @internal
+ * A suspended thread.
+ */
+typedef struct plcrash_async_thread_slot {
+    /** The suspended thread, or 0 if the slot is free. */
+    pid_t thread;
+
+    /** The suspension state. */
+    int state;
+
+    /** The thread's context at the time of suspension. Valid only in the PLCRASH_ASYNC_THREAD_PARKED state. */
+    ucontext_t context;
+} plcrash_async_thread_slot_t;
+
+/** Suspension slots. */
+static plcrash_async_thread_slot_t suspended_threads[PLCRASH_ASYNC_THREAD_MAX_SUSPENDED];
+
+/** The suspension signal, or 0 if plcrash_async_thread_init() has not been called. */
+static int suspend_signal = 0;
+
+/** Wait for *addr to change from value, or for the timeout (if non-NULL) to elapse. */
+static void futex_wait (int *addr, int value, const struct timespec *timeout) {
+    syscall(SYS_futex, addr, FUTEX_WAIT, value, timeout, NULL, 0);
+}
+
+/** Wake all waiters on addr. */
+static void futex_wake (int *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+/** Find the slot for @a thread in the given @a state, or NULL if none. */
+static plcrash_async_thread_slot_t *find_slot (pid_t thread, int state) {
+    for (size_t i = 0; i < PLCRASH_ASYNC_THREAD_MAX_SUSPENDED; i++) {
+        plcrash_async_thread_slot_t *slot = &suspended_threads[i];
+        if (__atomic_load_n(&slot->thread, __ATOMIC_ACQUIRE) == thread && __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == state)
+            return slot;
+    }
+
+    return NULL;
+}
+
+/** Release @a slot for reuse. The state is cleared first, ensuring that the slot is not matched by find_slot()
+ * once it has been claimed for another request. */
+static void release_slot (plcrash_async_thread_slot_t *slot) {
+    __atomic_store_n(&slot->state, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&slot->thread, 0, __ATOMIC_RELEASE);
+}
+
+/* Suspension signal handler. Publishes the thread's context, and waits to be resumed. */
+static void suspend_handler (int signo, siginfo_t *info, void *uap) {
+    int saved_errno = errno;
+    pid_t self = plcrash_async_thread_self();
+    plcrash_async_thread_slot_t *slot;
+
+    /* Release any request that timed out before it could be handled */
+    if ((slot = find_slot(self, PLCRASH_ASYNC_THREAD_REQUESTED)) == NULL) {
+        if ((slot = find_slot(self, PLCRASH_ASYNC_THREAD_ABANDONED)) != NULL)
+            release_slot(slot);
+
+        errno = saved_errno;
+        return;
+    }
+
+    /* Publish our context */
+    plcrash_async_memcpy(&slot->context, uap, sizeof(slot->context));
+
+    int expected = PLCRASH_ASYNC_THREAD_REQUESTED;
+    if (!__atomic_compare_exchange_n(&slot->state, &expected, PLCRASH_ASYNC_THREAD_PARKED, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        /* The request was abandoned */
+        release_slot(slot);
+        errno = saved_errno;
+        return;
+    }
+    futex_wake(&slot->state);
+
+    /* Wait to be resumed */
+    while (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == PLCRASH_ASYNC_THREAD_PARKED)
+        futex_wait(&slot->state, PLCRASH_ASYNC_THREAD_PARKED, NULL);
+
+    release_slot(slot);
+    errno = saved_errno;
+}
+
+/**
+ * Install the thread suspension signal handler. This must be called prior to suspending any threads, and is not
+ * async-safe.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or PLCRASH_EINTERNAL if the handler could not be installed.
+ */
+plcrash_error_t plcrash_async_thread_init (void) {
+    struct sigaction sa;
+    int signo = SIGRTMIN + PLCRASH_ASYNC_THREAD_SIGNAL_OFFSET;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = suspend_handler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+
+    if (sigaction(signo, &sa, NULL) != 0) {
+        PLCF_DEBUG("Could not install thread suspension handler: %d", errno);
+        return PLCRASH_EINTERNAL;
+    }
+
+    suspend_signal = signo;
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Return the current thread's identifier.
+ */
+pid_t plcrash_async_thread_self (void) {
+    return (pid_t) syscall(SYS_gettid);
+}
+
+/**
+ * @internal
+ * A directory entry, as returned by getdents64.
+ */
+struct plcrash_linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/**
+ * Fetch the identifiers of all threads in the current process, as listed in /proc/self/task.
+ *
+ * @param threads On return, the thread identifiers.
+ * @param max_threads The maximum number of identifiers to be written to @a threads. Any additional threads are
+ * omitted.
+ * @param thread_count On return, the number of identifiers written to @a threads.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or PLCRASH_EINTERNAL if the thread list could not be read.
+ */
+plcrash_error_t plcrash_async_thread_list (pid_t *threads, size_t max_threads, size_t *thread_count) {
+    char buffer[1024] __attribute__((aligned(8)));
+    long nread;
+    int fd;
+
+    *thread_count = 0;
+
+    if ((fd = open("/proc/self/task", O_RDONLY | O_DIRECTORY)) < 0) {
+        PLCF_DEBUG("Could not open /proc/self/task: %d", errno);
+        return PLCRASH_EINTERNAL;
+    }
+
+    while ((nread = syscall(SYS_getdents64, fd, buffer, sizeof(buffer))) > 0) {
+        for (long offset = 0; offset < nread;) {
+            struct plcrash_linux_dirent64 *entry = (struct plcrash_linux_dirent64 *) (buffer + offset);
+            offset += entry->d_reclen;
+
+            /* Parse the thread identifier, skipping "." and ".." */
+            pid_t thread = 0;
+            const char *p;
+            for (p = entry->d_name; *p >= '0' && *p <= '9'; p++)
+                thread = thread * 10 + (*p - '0');
+
+            if (*p != '\0' || p == entry->d_name)
+                continue;
+
+            if (*thread_count < max_threads)
+                threads[(*thread_count)++] = thread;
+        }
+    }
+
+    close(fd);
+
+    if (nread < 0) {
+        PLCF_DEBUG("Could not read /proc/self/task: %d", errno);
+        return PLCRASH_EINTERNAL;
+    }
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Suspend @a thread. The thread will not run until resumed via plcrash_async_thread_resume().
+ *
+ * @param thread The thread to suspend. This must not be the current thread.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if @a thread is the current thread or does not exist,
+ * PLCRASH_ENOMEM if PLCRASH_ASYNC_THREAD_MAX_SUSPENDED threads are already suspended, or PLCRASH_EINTERNAL if
+ * plcrash_async_thread_init() has not been called or the thread did not respond to the suspension request.
+ */
+plcrash_error_t plcrash_async_thread_suspend (pid_t thread) {
+    plcrash_async_thread_slot_t *slot = NULL;
+
+    if (suspend_signal == 0)
+        return PLCRASH_EINTERNAL;
+
+    if (thread <= 0 || thread == plcrash_async_thread_self())
+        return PLCRASH_EINVAL;
+
+    /* Claim a free slot */
+    for (size_t i = 0; i < PLCRASH_ASYNC_THREAD_MAX_SUSPENDED && slot == NULL; i++) {
+        pid_t expected = 0;
+        if (__atomic_compare_exchange_n(&suspended_threads[i].thread, &expected, thread, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            slot = &suspended_threads[i];
+    }
+
+    if (slot == NULL)
+        return PLCRASH_ENOMEM;
+
+    __atomic_store_n(&slot->state, PLCRASH_ASYNC_THREAD_REQUESTED, __ATOMIC_RELEASE);
+
+    /* Send the request */
+    if (syscall(SYS_tgkill, getpid(), thread, suspend_signal) != 0) {
+        release_slot(slot);
+        return PLCRASH_EINVAL;
+    }
+
+    /* Wait for the thread to park */
+    struct timespec timeout = { 0, 10 * 1000 * 1000 };
+    for (int waited = 0; waited < PLCRASH_ASYNC_THREAD_SUSPEND_TIMEOUT_MS; waited += 10) {
+        if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != PLCRASH_ASYNC_THREAD_REQUESTED)
+            break;
+
+        futex_wait(&slot->state, PLCRASH_ASYNC_THREAD_REQUESTED, &timeout);
+    }
+
+    /* Abandon the request if the thread has not parked. The thread releases the slot if the request is later handled. */
+    int expected = PLCRASH_ASYNC_THREAD_REQUESTED;
+    if (__atomic_compare_exchange_n(&slot->state, &expected, PLCRASH_ASYNC_THREAD_ABANDONED, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        PLCF_DEBUG("Thread %d did not respond to the suspension request", (int) thread);
+        return PLCRASH_EINTERNAL;
+    }
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Fetch the context of a thread suspended via plcrash_async_thread_suspend().
+ *
+ * @param thread The suspended thread.
+ * @param context On success, the thread's context at the time it was suspended.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or PLCRASH_EINVAL if @a thread is not suspended.
+ */
+plcrash_error_t plcrash_async_thread_get_state (pid_t thread, ucontext_t *context) {
+    plcrash_async_thread_slot_t *slot = find_slot(thread, PLCRASH_ASYNC_THREAD_PARKED);
+    if (slot == NULL)
+        return PLCRASH_EINVAL;
+
+    plcrash_async_memcpy(context, &slot->context, sizeof(*context));
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Resume a thread suspended via plcrash_async_thread_suspend().
+ *
+ * @param thread The suspended thread.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or PLCRASH_EINVAL if @a thread is not suspended.
+ */
+plcrash_error_t plcrash_async_thread_resume (pid_t thread) {
+    plcrash_async_thread_slot_t *slot = find_slot(thread, PLCRASH_ASYNC_THREAD_PARKED);
+    if (slot == NULL)
+        return PLCRASH_EINVAL;
+
+    __atomic_store_n(&slot->state, PLCRASH_ASYNC_THREAD_RESUMED, __ATOMIC_RELEASE);
+    futex_wake(&slot->state);
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * @} plcrash_async_thread
+ */
+
+#endif /* __linux__ */
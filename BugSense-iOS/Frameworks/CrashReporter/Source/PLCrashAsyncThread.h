@@ -0,0 +1,56 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifdef __linux__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/ucontext.h>
+
+#import "PLCrashAsync.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_async_thread
+ *
+ * The maximum number of threads that may be suspended at once.
+ */
+#define PLCRASH_ASYNC_THREAD_MAX_SUSPENDED 256
+
+plcrash_error_t plcrash_async_thread_init (void);
+
+pid_t plcrash_async_thread_self (void);
+plcrash_error_t plcrash_async_thread_list (pid_t *threads, size_t max_threads, size_t *thread_count);
+
+plcrash_error_t plcrash_async_thread_suspend (pid_t thread);
+plcrash_error_t plcrash_async_thread_get_state (pid_t thread, ucontext_t *context);
+plcrash_error_t plcrash_async_thread_resume (pid_t thread);
+
+#endif /* __linux__ */
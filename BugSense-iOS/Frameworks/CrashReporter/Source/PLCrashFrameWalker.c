@@ -28,6 +28,15 @@
 
 
 #import "PLCrashFrameWalker.h"
+#import "PLCrashAsyncThread.h"
+#import "PLCrashAsync.h"
+
+#ifdef __linux__
+#import <errno.h>
+#import <fcntl.h>
+#import <sched.h>
+#import <sys/syscall.h>
+#endif
 
 
 /**
@@ -58,6 +67,8 @@ const char *plframe_strerror (plframe_error_t error) {
 }
 
 
+#if defined(__APPLE__)
+
 /**
  * (Safely) read len bytes from addr, storing in dest. Uses mach vm_read_overwrite to
  * avoid dereferencing a bad pointer.
@@ -67,10 +78,234 @@ kern_return_t plframe_read_addr (const void *source, void *dest, size_t len) {
     return vm_read_overwrite(mach_task_self(), (vm_address_t) source, len, (pointer_t) dest, &read_size);
 }
 
-/* A thread that exists just to give us a stack to iterate */
-static void *test_stack_thr (void *arg) {
-    plframe_test_thead_t *args = arg;
-    
+#elif defined(__linux__)
+
+/**
+ * @internal
+ *
+ * Read len bytes from addr by writing them to a pipe; the kernel validates the source address, and the write
+ * fails with EFAULT rather than faulting. Used when process_vm_readv() is unavailable.
+ */
+static kern_return_t plframe_read_addr_pipe (const void *source, void *dest, size_t len) {
+    kern_return_t kr = KERN_INVALID_ADDRESS;
+    int fds[2];
+
+    /* Reads are limited to the (minimum) pipe buffer size, as both ends are serviced by the current thread */
+    if (len > PLFRAME_STACK_CACHE_LEN || pipe(fds) != 0)
+        return KERN_INVALID_ADDRESS;
+
+    if (write(fds[1], source, len) == (ssize_t) len && read(fds[0], dest, len) == (ssize_t) len)
+        kr = KERN_SUCCESS;
+
+    close(fds[0]);
+    close(fds[1]);
+    return kr;
+}
+
+/**
+ * (Safely) read len bytes from addr, storing in dest. Uses process_vm_readv (or, if unavailable, a pipe) to
+ * avoid dereferencing a bad pointer.
+ */
+kern_return_t plframe_read_addr (const void *source, void *dest, size_t len) {
+    struct iovec local = { dest, len };
+    struct iovec remote = { (void *) source, len };
+    ssize_t nread;
+
+    nread = syscall(SYS_process_vm_readv, getpid(), &local, 1UL, &remote, 1UL, 0UL);
+    if (nread == (ssize_t) len)
+        return KERN_SUCCESS;
+
+    /* The syscall may be unimplemented, or denied by a security policy */
+    if (nread < 0 && (errno == ENOSYS || errno == EPERM))
+        return plframe_read_addr_pipe(source, dest, len);
+
+    return KERN_INVALID_ADDRESS;
+}
+
+#endif
+
+/**
+ * (Safely) read len bytes of stack memory from addr, storing in dest.
+ *
+ * Reads are served from the cursor's stack cache. If the requested range is not cached, the aligned
+ * PLFRAME_STACK_CACHE_LEN block containing it is fetched with a single plframe_read_addr() call; walking a stack
+ * of small frames thus requires a read per block, rather than a read per frame. Ranges that span a block
+ * boundary are read directly.
+ *
+ * The cached data is only valid while the stack is unmodified; the cursor's thread must remain suspended (or,
+ * for the crashed thread, must not return from the frames being walked) for the lifetime of the cursor.
+ *
+ * If the cursor's stack bounds are known, ranges outside of the stack are rejected with KERN_INVALID_ADDRESS,
+ * without issuing a read.
+ */
+kern_return_t plframe_cursor_read_stack (plframe_cursor_t *cursor, const void *source, void *dest, size_t len) {
+    plframe_stack_cache_t *cache = &cursor->stack_cache;
+    uintptr_t addr = (uintptr_t) source;
+    uintptr_t base = addr & ~((uintptr_t) PLFRAME_STACK_CACHE_LEN - 1);
+
+    /* Reject ranges outside of the stack */
+    if (cursor->stack_size != 0) {
+        if (addr < cursor->stack_base || len > cursor->stack_size || addr - cursor->stack_base > cursor->stack_size - len)
+            return KERN_INVALID_ADDRESS;
+    }
+
+    /* Ranges spanning a block boundary are not cached */
+    if (len > PLFRAME_STACK_CACHE_LEN - (addr - base))
+        return plframe_read_addr(source, dest, len);
+
+    /* Fetch the containing block. The block lies within a single page, and is readable if the range is; if the
+     * block read fails regardless, fall back on reading the range directly. */
+    if (!cache->valid || cache->base != base) {
+        cache->valid = false;
+        if (plframe_read_addr((const void *) base, cache->data, PLFRAME_STACK_CACHE_LEN) != KERN_SUCCESS)
+            return plframe_read_addr(source, dest, len);
+
+        cache->base = base;
+        cache->valid = true;
+    }
+
+    plcrash_async_memcpy(dest, cache->data + (addr - base), len);
+    return KERN_SUCCESS;
+}
+
+/**
+ * Determine the bounds of the stack containing @a sp, from the VM region containing @a sp, and save them in
+ * @a cursor. If the region can not be found or is not readable (eg, @a sp lies within a stack guard page following
+ * a stack overflow), the bounds are left unknown and frame pointers are not bounds checked.
+ *
+ * @param cursor The cursor to be initialized.
+ * @param sp The thread's stack pointer.
+ */
+#if defined(__APPLE__)
+void plframe_cursor_init_stack_bounds (plframe_cursor_t *cursor, uintptr_t sp) {
+    vm_address_t address = sp;
+    vm_size_t size = 0;
+    vm_region_basic_info_data_64_t info;
+    mach_msg_type_number_t info_count = VM_REGION_BASIC_INFO_COUNT_64;
+    mach_port_t object_name = MACH_PORT_NULL;
+    kern_return_t kr;
+
+    cursor->stack_base = 0;
+    cursor->stack_size = 0;
+
+    /* Find the first region at or above sp */
+    kr = vm_region_64(mach_task_self(), &address, &size, VM_REGION_BASIC_INFO_64, (vm_region_info_t) &info, &info_count, &object_name);
+    if (object_name != MACH_PORT_NULL)
+        mach_port_deallocate(mach_task_self(), object_name);
+
+    if (kr != KERN_SUCCESS) {
+        PLCF_DEBUG("Could not determine stack bounds for sp 0x%lx: %d", (unsigned long) sp, kr);
+        return;
+    }
+
+    /* The region must contain sp, and be readable */
+    if (address > sp || (info.protection & VM_PROT_READ) == 0)
+        return;
+
+    cursor->stack_base = address;
+    cursor->stack_size = size;
+}
+
+#elif defined(__linux__)
+
+/**
+ * @internal
+ *
+ * Parse a hexadecimal value from @a str, advancing @a str past the parsed digits.
+ */
+static uintptr_t plframe_parse_hex (const char **str) {
+    uintptr_t value = 0;
+
+    for (;; (*str)++) {
+        char c = **str;
+        if (c >= '0' && c <= '9')
+            value = (value << 4) | (uintptr_t) (c - '0');
+        else if (c >= 'a' && c <= 'f')
+            value = (value << 4) | (uintptr_t) (c - 'a' + 10);
+        else
+            return value;
+    }
+}
+
+/* The region containing sp is found by scanning /proc/self/maps */
+void plframe_cursor_init_stack_bounds (plframe_cursor_t *cursor, uintptr_t sp) {
+    char buffer[512];
+    char line[64];
+    size_t line_len = 0;
+    ssize_t nread;
+    int fd;
+
+    cursor->stack_base = 0;
+    cursor->stack_size = 0;
+
+    /* Each /proc/self/maps line begins with the region's "start-end perms" */
+    if ((fd = open("/proc/self/maps", O_RDONLY)) < 0) {
+        PLCF_DEBUG("Could not open /proc/self/maps: %d", errno);
+        return;
+    }
+
+    while ((nread = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < nread; i++) {
+            /* Accumulate the line prefix */
+            if (buffer[i] != '\n') {
+                if (line_len < sizeof(line) - 1)
+                    line[line_len++] = buffer[i];
+                continue;
+            }
+
+            line[line_len] = '\0';
+            line_len = 0;
+
+            const char *p = line;
+            uintptr_t start = plframe_parse_hex(&p);
+            if (*p++ != '-')
+                continue;
+            uintptr_t end = plframe_parse_hex(&p);
+            if (*p++ != ' ')
+                continue;
+
+            /* Regions are sorted by address */
+            if (start > sp)
+                goto done;
+
+            if (sp < end) {
+                if (*p == 'r') {
+                    cursor->stack_base = start;
+                    cursor->stack_size = end - start;
+                }
+                goto done;
+            }
+        }
+    }
+
+done:
+    close(fd);
+}
+
+#endif
+
+/* Recurse through depth frames, and then wait for a shut down request. */
+static uint32_t test_stack_recurse (plframe_test_thead_t *args, uint32_t depth) __attribute__((noinline));
+static uint32_t test_stack_recurse (plframe_test_thead_t *args, uint32_t depth) {
+    /* Referenced after the recursive call, preventing the compiler from eliminating this frame */
+    volatile uint32_t frame_depth = depth;
+
+    if (depth > 0) {
+        test_stack_recurse(args, depth - 1);
+        return frame_depth;
+    }
+
+#ifdef __linux__
+    /* Inform our caller that we're active */
+    pthread_mutex_lock(&args->lock);
+    pthread_cond_signal(&args->cond);
+    pthread_mutex_unlock(&args->lock);
+
+    /* glibc is built without frame pointers, and a thread blocked in pthread_cond_wait() can not be walked past
+     * its first frame. Wait for the shut down request here instead; sched_yield() leaves %rbp intact. */
+    while (!__atomic_load_n(&args->stop, __ATOMIC_ACQUIRE))
+        sched_yield();
+#else
     /* Acquire the lock and inform our caller that we're active */
     pthread_mutex_lock(&args->lock);
     pthread_cond_signal(&args->cond);
@@ -78,6 +313,21 @@ static void *test_stack_thr (void *arg) {
     /* Wait for a shut down request, and then drop the acquired lock immediately */
     pthread_cond_wait(&args->cond, &args->lock);
     pthread_mutex_unlock(&args->lock);
+#endif
+
+    return frame_depth;
+}
+
+/* A thread that exists just to give us a stack to iterate */
+static void *test_stack_thr (void *arg) {
+    plframe_test_thead_t *args = arg;
+
+#ifdef __linux__
+    /* Published to the spawning thread by the condition signal in test_stack_recurse() */
+    args->tid = plcrash_async_thread_self();
+#endif
+
+    test_stack_recurse(args, args->depth);
     
     return NULL;
 }
@@ -85,7 +335,19 @@ static void *test_stack_thr (void *arg) {
 
 /** Spawn a test thread that may be used as an iterable stack. (For testing only!) */
 void plframe_test_thread_spawn (plframe_test_thead_t *args) {
+    plframe_test_thread_spawn_depth(args, 0);
+}
+
+/**
+ * Spawn a test thread that recurses through @a depth additional frames before waiting, providing a deep iterable
+ * stack. (For testing only!)
+ */
+void plframe_test_thread_spawn_depth (plframe_test_thead_t *args, uint32_t depth) {
     /* Initialize the args */
+    args->depth = depth;
+#ifdef __linux__
+    args->stop = false;
+#endif
     pthread_mutex_init(&args->lock, NULL);
     pthread_cond_init(&args->cond, NULL);
     
@@ -99,9 +361,13 @@ void plframe_test_thread_spawn (plframe_test_thead_t *args) {
 /** Stop a test thread. */
 void plframe_test_thread_stop (plframe_test_thead_t *args) {
     /* Signal the thread to exit */
+#ifdef __linux__
+    __atomic_store_n(&args->stop, true, __ATOMIC_RELEASE);
+#else
     pthread_mutex_lock(&args->lock);
     pthread_cond_signal(&args->cond);
     pthread_mutex_unlock(&args->lock);
+#endif
     
     /* Wait for exit */
     pthread_join(args->thread, NULL);
@@ -33,7 +33,30 @@
 #import <stdbool.h>
 #import <unistd.h>
 
+#if defined(__APPLE__)
 #import <mach/mach.h>
+#elif defined(__linux__)
+#import <sys/types.h>
+
+/*
+ * The Linux backend is used to profile and test the frame walker natively on Linux. The Mach types used by the
+ * frame walker API are mapped to their Linux equivalents.
+ */
+
+/** Result of a memory read; KERN_SUCCESS or KERN_INVALID_ADDRESS. */
+typedef int kern_return_t;
+
+/** Read succeeded */
+#define KERN_SUCCESS 0
+
+/** Read failed; the address is not readable */
+#define KERN_INVALID_ADDRESS 1
+
+/** Thread identifier, as returned by gettid(). */
+typedef pid_t thread_t;
+#else
+#error Unsupported Platform
+#endif
 
 /**
  * @internal
@@ -89,6 +112,29 @@ typedef int plframe_regnum_t;
 /** Platform-specific length of stack to be read when iterating frames */
 #define PLFRAME_STACKFRAME_LEN PLFRAME_PDEF_STACKFRAME_LEN
 
+/**
+ * Length of the per-cursor stack cache, in bytes. Stack memory is read in aligned blocks of this size, which must
+ * be a power of two no larger than the smallest supported VM page size; a block is therefore always contained
+ * within a single page.
+ */
+#define PLFRAME_STACK_CACHE_LEN 4096
+
+/**
+ * @internal
+ * Cached stack memory. Frame records are read from the cache where possible, rather than issuing a separate
+ * read for each frame.
+ */
+typedef struct plframe_stack_cache {
+    /** True if data contains the block at base. */
+    bool valid;
+
+    /** The address of the cached block. */
+    uintptr_t base;
+
+    /** Cached stack data. */
+    uint8_t data[PLFRAME_STACK_CACHE_LEN];
+} plframe_stack_cache_t;
+
 /**
  * @internal
  * Frame cursor context.
@@ -102,13 +148,24 @@ typedef struct plframe_cursor {
     
     /** Stack frame data */
     void *fp[PLFRAME_STACKFRAME_LEN];
+
+    /** Stack memory cache */
+    plframe_stack_cache_t stack_cache;
+
+    /** The lowest address of the thread's stack. Valid only if stack_size is non-zero. */
+    uintptr_t stack_base;
+
+    /** The size of the thread's stack, or 0 if the stack bounds are unknown. */
+    size_t stack_size;
     
     // for thread-initialized cursors
     /** Generated ucontext_t */
     ucontext_t _uap_data;
 
+#ifdef __APPLE__
     /** Generated mcontext_t */
     _STRUCT_MCONTEXT _mcontext_data;
+#endif
 } plframe_cursor_t;
 
 /**
@@ -146,14 +203,28 @@ typedef struct plframe_test_thread {
 
     /** Thread signaling (used to inform waiting callee that thread is active) */
     pthread_cond_t cond;
+
+    /** Number of additional frames the thread recurses through before waiting */
+    uint32_t depth;
+
+#ifdef __linux__
+    /** Kernel thread ID of the test thread, as returned by plcrash_async_thread_self() */
+    thread_t tid;
+
+    /** Set to request that the test thread exit */
+    volatile bool stop;
+#endif
 } plframe_test_thead_t;
 
 
 /* Shared functions */
 const char *plframe_strerror (plframe_error_t error);
 kern_return_t plframe_read_addr (const void *source, void *dest, size_t len);
+kern_return_t plframe_cursor_read_stack (plframe_cursor_t *cursor, const void *source, void *dest, size_t len);
+void plframe_cursor_init_stack_bounds (plframe_cursor_t *cursor, uintptr_t sp);
 
 void plframe_test_thread_spawn (plframe_test_thead_t *args);
+void plframe_test_thread_spawn_depth (plframe_test_thead_t *args, uint32_t depth);
 void plframe_test_thread_stop (plframe_test_thead_t *args);
 
 /* Platform specific funtions */
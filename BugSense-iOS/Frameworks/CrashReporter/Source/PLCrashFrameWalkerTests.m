@@ -29,6 +29,20 @@
 #import "GTMSenTestCase.h"
 
 #import "PLCrashFrameWalker.h"
+#import "PLCrashAsyncThread.h"
+
+#ifdef __APPLE__
+#import <mach/mach_time.h>
+#endif
+
+/* Return the thread_t of the given test thread. */
+static thread_t test_thread_id (plframe_test_thead_t *args) {
+#ifdef __APPLE__
+    return pthread_mach_thread_np(args->thread);
+#else
+    return args->tid;
+#endif
+}
 
 
 @interface PLCrashFrameWalkerTests : SenTestCase {
@@ -41,9 +55,18 @@
     
 - (void) setUp {
     plframe_test_thread_spawn(&_thr_args);
+
+#ifdef __linux__
+    /* The state of a running thread is not available on Linux */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_thread_init(), @"Could not initialize thread suspension");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_thread_suspend(_thr_args.tid), @"Could not suspend the test thread");
+#endif
 }
 
 - (void) tearDown {
+#ifdef __linux__
+    plcrash_async_thread_resume(_thr_args.tid);
+#endif
     plframe_test_thread_stop(&_thr_args);
 }
 
@@ -68,13 +91,43 @@
     STAssertNotEquals(KERN_SUCCESS, plframe_read_addr(NULL, dest, sizeof(bytes)), @"Bad read was performed");
 }
 
+/* test plframe_cursor_read_stack() */
+- (void) testCursorReadStack {
+    plframe_cursor_t cursor;
+    uint8_t *buffer;
+    uint8_t dest[32];
+
+    /* Populate two cache blocks with a known pattern */
+    buffer = valloc(PLFRAME_STACK_CACHE_LEN * 2);
+    for (size_t i = 0; i < PLFRAME_STACK_CACHE_LEN * 2; i++)
+        buffer[i] = (uint8_t) (i * 7);
+
+    STAssertEquals(PLFRAME_ESUCCESS, plframe_cursor_thread_init(&cursor, test_thread_id(&_thr_args)), @"Initialization failed");
+
+    /* The buffer is not within the thread's stack; disable bounds checking */
+    cursor.stack_size = 0;
+
+    /* Reads within a block, across the block boundary, and within the next block */
+    size_t offsets[] = { 0, 64, PLFRAME_STACK_CACHE_LEN - sizeof(dest), PLFRAME_STACK_CACHE_LEN - 8, PLFRAME_STACK_CACHE_LEN + 16, 64 };
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        memset(dest, 0, sizeof(dest));
+        STAssertEquals(KERN_SUCCESS, plframe_cursor_read_stack(&cursor, buffer + offsets[i], dest, sizeof(dest)), @"Read failed");
+        STAssertTrue(memcmp(buffer + offsets[i], dest, sizeof(dest)) == 0, @"Incorrect data read at offset %zu", offsets[i]);
+    }
+
+    /* Verify that reading off the page at 0x0 fails */
+    STAssertNotEquals(KERN_SUCCESS, plframe_cursor_read_stack(&cursor, NULL, dest, sizeof(dest)), @"Bad read was performed");
+
+    free(buffer);
+}
+
 
 /* test plframe_cursor_init() */
 - (void) testInitFrame {
     plframe_cursor_t cursor;
 
     /* Initialize the cursor */
-    STAssertEquals(PLFRAME_ESUCCESS, plframe_cursor_thread_init(&cursor, pthread_mach_thread_np(_thr_args.thread)), @"Initialization failed");
+    STAssertEquals(PLFRAME_ESUCCESS, plframe_cursor_thread_init(&cursor, test_thread_id(&_thr_args)), @"Initialization failed");
 
     /* Try fetching the first frame */
     plframe_error_t ferr = plframe_cursor_next(&cursor);
@@ -87,4 +140,141 @@
     }
 }
 
+/* test plframe_cursor_init_stack_bounds() */
+- (void) testStackBounds {
+    plframe_cursor_t cursor;
+    char *heap;
+
+    STAssertEquals(PLFRAME_ESUCCESS, plframe_cursor_thread_init(&cursor, test_thread_id(&_thr_args)), @"Initialization failed");
+    STAssertNotEquals((size_t)0, cursor.stack_size, @"Stack bounds were not determined");
+
+    /* The stack must be walkable within the bounds */
+    STAssertEquals(PLFRAME_ESUCCESS, plframe_cursor_next(&cursor), @"Could not fetch the first frame");
+    STAssertEquals(PLFRAME_ESUCCESS, plframe_cursor_next(&cursor), @"Could not fetch the second frame");
+
+    uintptr_t fp = (uintptr_t) cursor.fp[0];
+    STAssertTrue(fp >= cursor.stack_base && fp - cursor.stack_base < cursor.stack_size, @"Frame pointer is outside of the stack bounds");
+
+    /* Readable addresses outside of the stack must be rejected */
+    heap = malloc(16);
+    STAssertEquals(KERN_SUCCESS, plframe_read_addr(heap, heap + 8, 8), @"Could not read heap address");
+    STAssertNotEquals(KERN_SUCCESS, plframe_cursor_read_stack(&cursor, heap, heap + 8, 8), @"Read outside of the stack bounds was performed");
+    free(heap);
+}
+
+#ifdef __APPLE__
+/* Benchmark walking a deep stack. The stack memory is read in PLFRAME_STACK_CACHE_LEN blocks, rather than
+ * once per frame. */
+- (void) testDeepStackBenchmark {
+    plframe_test_thead_t thr_args;
+    const uint32_t depth = 500;
+    const int iterations = 1000;
+    mach_timebase_info_data_t timebase;
+    uint32_t frame_count = 0;
+
+    mach_timebase_info(&timebase);
+
+    /* Spawn and suspend a thread with a deep stack */
+    plframe_test_thread_spawn_depth(&thr_args, depth);
+    thread_t thread = pthread_mach_thread_np(thr_args.thread);
+    STAssertEquals(KERN_SUCCESS, thread_suspend(thread), @"Could not suspend thread");
+
+    /* Walk the stack */
+    uint64_t start = mach_absolute_time();
+    for (int i = 0; i < iterations; i++) {
+        plframe_cursor_t cursor;
+
+        STAssertEquals(PLFRAME_ESUCCESS, plframe_cursor_thread_init(&cursor, thread), @"Initialization failed");
+
+        frame_count = 0;
+        while (plframe_cursor_next(&cursor) == PLFRAME_ESUCCESS)
+            frame_count++;
+    }
+    uint64_t elapsed = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    thread_resume(thread);
+    plframe_test_thread_stop(&thr_args);
+
+    STAssertTrue(frame_count > depth, @"Only %u of at least %u frames were walked", frame_count, depth);
+    NSLog(@"Walked %u frames in %.1f us (%.1f ns per frame)", frame_count,
+          (double) elapsed / iterations / 1000.0, (double) elapsed / iterations / frame_count);
+}
+#endif
+
+#ifdef __linux__
+/* test plcrash_async_thread_list() */
+- (void) testThreadList {
+    pid_t threads[PLCRASH_ASYNC_THREAD_MAX_SUSPENDED];
+    size_t count;
+    bool found_self = false;
+    bool found_test = false;
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_thread_list(threads, PLCRASH_ASYNC_THREAD_MAX_SUSPENDED, &count), @"Could not list threads");
+    STAssertTrue(count >= 2, @"Only %zu threads were listed", count);
+
+    for (size_t i = 0; i < count; i++) {
+        if (threads[i] == plcrash_async_thread_self())
+            found_self = true;
+        if (threads[i] == test_thread_id(&_thr_args))
+            found_test = true;
+    }
+
+    STAssertTrue(found_self, @"The current thread was not listed");
+    STAssertTrue(found_test, @"The test thread was not listed");
+}
+
+/* test plcrash_async_thread_suspend() and plcrash_async_thread_resume() */
+- (void) testThreadSuspendResume {
+    plframe_test_thead_t thr_args;
+    ucontext_t context;
+
+    plframe_test_thread_spawn(&thr_args);
+    thread_t thread = test_thread_id(&thr_args);
+
+    /* The current thread can not be suspended */
+    STAssertEquals(PLCRASH_EINVAL, plcrash_async_thread_suspend(plcrash_async_thread_self()), @"The current thread was suspended");
+
+    /* Only suspended threads provide their state */
+    STAssertNotEquals(PLCRASH_ESUCCESS, plcrash_async_thread_get_state(thread, &context), @"State was returned for a running thread");
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_thread_suspend(thread), @"Could not suspend the test thread");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_thread_get_state(thread, &context), @"Could not fetch the thread state");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_thread_resume(thread), @"Could not resume the test thread");
+
+    /* A thread that is not suspended can not be resumed */
+    STAssertEquals(PLCRASH_EINVAL, plcrash_async_thread_resume(thread), @"A running thread was resumed");
+
+    /* Repeated suspension must release each suspension slot */
+    for (int i = 0; i < PLCRASH_ASYNC_THREAD_MAX_SUSPENDED * 2; i++) {
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_thread_suspend(thread), @"Could not suspend the test thread");
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_thread_resume(thread), @"Could not resume the test thread");
+    }
+
+    plframe_test_thread_stop(&thr_args);
+}
+
+/* Walk the stack of a suspended thread */
+- (void) testThreadWalk {
+    plframe_test_thead_t thr_args;
+    plframe_cursor_t cursor;
+    const uint32_t depth = 500;
+    uint32_t frame_count = 0;
+
+    plframe_test_thread_spawn_depth(&thr_args, depth);
+    thread_t thread = test_thread_id(&thr_args);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_thread_suspend(thread), @"Could not suspend thread");
+
+    STAssertEquals(PLFRAME_ESUCCESS, plframe_cursor_thread_init(&cursor, thread), @"Initialization failed");
+    STAssertNotEquals((size_t)0, cursor.stack_size, @"Stack bounds were not determined");
+
+    while (plframe_cursor_next(&cursor) == PLFRAME_ESUCCESS)
+        frame_count++;
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_thread_resume(thread), @"Could not resume thread");
+    plframe_test_thread_stop(&thr_args);
+
+    STAssertTrue(frame_count > depth, @"Only %u of at least %u frames were walked", frame_count, depth);
+}
+#endif
+
 @end
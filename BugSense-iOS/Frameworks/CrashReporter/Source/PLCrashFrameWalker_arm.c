@@ -45,6 +45,8 @@ plframe_error_t plframe_cursor_init (plframe_cursor_t *cursor, ucontext_t *uap)
     cursor->uap = uap;
     cursor->init_frame = true;
     cursor->fp[0] = NULL;
+    cursor->stack_cache.valid = false;
+    plframe_cursor_init_stack_bounds(cursor, (uintptr_t) uap->uc_mcontext->__ss.__sp);
     
     return PLFRAME_ESUCCESS;
 }
@@ -114,10 +116,10 @@ plframe_error_t plframe_cursor_next (plframe_cursor_t *cursor) {
     } else {
         if (cursor->fp[0] == NULL) {
             /* No frame data has been loaded, fetch it from register state */
-            kr = plframe_read_addr((void *) cursor->uap->uc_mcontext->__ss.__r[7], cursor->fp, sizeof(cursor->fp));
+            kr = plframe_cursor_read_stack(cursor, (void *) cursor->uap->uc_mcontext->__ss.__r[7], cursor->fp, sizeof(cursor->fp));
         } else {
             /* Frame data loaded, walk the stack */
-            kr = plframe_read_addr(cursor->fp[0], cursor->fp, sizeof(cursor->fp));
+            kr = plframe_cursor_read_stack(cursor, cursor->fp[0], cursor->fp, sizeof(cursor->fp));
         }
     }
     
@@ -0,0 +1,205 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Required for the REG_* ucontext register indices */
+#define _GNU_SOURCE
+
+#import "PLCrashFrameWalker.h"
+#import "PLCrashAsync.h"
+#import "PLCrashAsyncThread.h"
+
+#import <signal.h>
+#import <stdlib.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+
+/*
+ * Like the Darwin backend, frames are walked via the %rbp chain. Unlike Darwin, the Linux x86-64 ABI does not
+ * require frame pointers; code must be built with -fno-omit-frame-pointer to be walkable past its first frame.
+ */
+
+#define RETGEN(name, uap, result) {\
+    *result = (uap->uc_mcontext.gregs[REG_ ## name]); \
+    return PLFRAME_ESUCCESS; \
+}
+
+/* Fetch a segment register from the packed cs/gs/fs greg */
+#define RETSEG(shift, uap, result) {\
+    *result = ((uap->uc_mcontext.gregs[REG_CSGSFS] >> shift) & 0xFFFF); \
+    return PLFRAME_ESUCCESS; \
+}
+
+// PLFrameWalker API
+plframe_error_t plframe_cursor_init (plframe_cursor_t *cursor, ucontext_t *uap) {
+    cursor->uap = uap;
+    cursor->init_frame = true;
+    cursor->fp[0] = NULL;
+    cursor->stack_cache.valid = false;
+    plframe_cursor_init_stack_bounds(cursor, (uintptr_t) uap->uc_mcontext.gregs[REG_RSP]);
+
+    return PLFRAME_ESUCCESS;
+}
+
+// PLFrameWalker API
+plframe_error_t plframe_cursor_thread_init (plframe_cursor_t *cursor, thread_t thread) {
+    /* Fetch the context published by the suspended thread */
+    if (plcrash_async_thread_get_state(thread, &cursor->_uap_data) != PLCRASH_ESUCCESS) {
+        PLCF_DEBUG("Fetch of thread %d state failed; the thread must be suspended", (int) thread);
+        return PLFRAME_INTERNAL;
+    }
+
+    /* Perform standard initialization */
+    plframe_cursor_init(cursor, &cursor->_uap_data);
+
+    return PLFRAME_ESUCCESS;
+}
+
+
+// PLFrameWalker API
+plframe_error_t plframe_cursor_next (plframe_cursor_t *cursor) {
+    kern_return_t kr;
+    void *prevfp = cursor->fp[0];
+    
+    /* Fetch the next stack address */
+    if (cursor->init_frame) {
+        /* The first frame is already available, so there's nothing to do */
+        cursor->init_frame = false;
+        return PLFRAME_ESUCCESS;
+    } else {
+        if (cursor->fp[0] == NULL) {
+            /* No frame data has been loaded, fetch it from register state */
+            kr = plframe_cursor_read_stack(cursor, (void *) cursor->uap->uc_mcontext.gregs[REG_RBP], cursor->fp, sizeof(cursor->fp));
+        } else {
+            /* Frame data loaded, walk the stack */
+            kr = plframe_cursor_read_stack(cursor, cursor->fp[0], cursor->fp, sizeof(cursor->fp));
+        }
+    }
+    
+    /* Was the read successful? */
+    if (kr != KERN_SUCCESS)
+        return PLFRAME_EBADFRAME;
+    
+    /* Check for completion */
+    if (cursor->fp[0] == NULL)
+        return PLFRAME_ENOFRAME;
+    
+    /* Is the stack growing in the right direction? */
+    if (!cursor->init_frame && prevfp > cursor->fp[0])
+        return PLFRAME_EBADFRAME;
+    
+    /* New frame fetched */
+    return PLFRAME_ESUCCESS;
+}
+
+
+// PLFrameWalker API
+plframe_error_t plframe_get_reg (plframe_cursor_t *cursor, plframe_regnum_t regnum, plframe_greg_t *reg) {
+    ucontext_t *uap = cursor->uap;
+    
+    /* Supported register for this context state? */
+    if (cursor->fp[0] != NULL) {
+        if (regnum == PLFRAME_X86_64_RIP) {
+            *reg = (plframe_greg_t) cursor->fp[1];
+            return PLFRAME_ESUCCESS;
+        }
+        
+        return PLFRAME_ENOTSUP;
+    }
+
+    switch (regnum) {
+        case PLFRAME_X86_64_RAX:
+            RETGEN(RAX, uap, reg);
+
+        case PLFRAME_X86_64_RBX:
+            RETGEN(RBX, uap, reg);
+
+        case PLFRAME_X86_64_RCX:
+            RETGEN(RCX, uap, reg);
+            
+        case PLFRAME_X86_64_RDX:
+            RETGEN(RDX, uap, reg);
+            
+        case PLFRAME_X86_64_RDI:
+            RETGEN(RDI, uap, reg);
+            
+        case PLFRAME_X86_64_RSI:
+            RETGEN(RSI, uap, reg);
+            
+        case PLFRAME_X86_64_RBP:
+            RETGEN(RBP, uap, reg);
+            
+        case PLFRAME_X86_64_RSP:
+            RETGEN(RSP, uap, reg);
+            
+        case PLFRAME_X86_64_R10:
+            RETGEN(R10, uap, reg);
+            
+        case PLFRAME_X86_64_R11:
+            RETGEN(R11, uap, reg);
+            
+        case PLFRAME_X86_64_R12:
+            RETGEN(R12, uap, reg);
+            
+        case PLFRAME_X86_64_R13:
+            RETGEN(R13, uap, reg);
+            
+        case PLFRAME_X86_64_R14:
+            RETGEN(R14, uap, reg);
+            
+        case PLFRAME_X86_64_R15:
+            RETGEN(R15, uap, reg);
+            
+        case PLFRAME_X86_64_RIP:
+            RETGEN(RIP, uap, reg);
+            
+        case PLFRAME_X86_64_RFLAGS:
+            RETGEN(EFL, uap, reg);
+            
+        case PLFRAME_X86_64_CS:
+            RETSEG(0, uap, reg);
+            
+        case PLFRAME_X86_64_FS:
+            RETSEG(32, uap, reg);
+            
+        case PLFRAME_X86_64_GS:
+            RETSEG(16, uap, reg);
+            
+        default:
+            // Unsupported register
+            break;
+    }
+    
+    return PLFRAME_ENOTSUP;
+}
+
+// PLFrameWalker API
+plframe_error_t plframe_get_freg (plframe_cursor_t *cursor, plframe_regnum_t regnum, plframe_fpreg_t *fpreg) {
+    return PLFRAME_ENOTSUP;
+}
+
+#endif
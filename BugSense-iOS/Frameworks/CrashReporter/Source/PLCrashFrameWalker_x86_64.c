@@ -40,11 +40,16 @@
 
 #ifdef __x86_64__
 
+/* The Linux implementation of the cursor API is provided by PLCrashFrameWalker_linux_x86_64.c */
+#ifdef __APPLE__
+
 // PLFrameWalker API
 plframe_error_t plframe_cursor_init (plframe_cursor_t *cursor, ucontext_t *uap) {
     cursor->uap = uap;
     cursor->init_frame = true;
     cursor->fp[0] = NULL;
+    cursor->stack_cache.valid = false;
+    plframe_cursor_init_stack_bounds(cursor, (uintptr_t) uap->uc_mcontext->__ss.__rsp);
     
     return PLFRAME_ESUCCESS;
 }
@@ -113,10 +118,10 @@ plframe_error_t plframe_cursor_next (plframe_cursor_t *cursor) {
     } else {
         if (cursor->fp[0] == NULL) {
             /* No frame data has been loaded, fetch it from register state */
-            kr = plframe_read_addr((void *) cursor->uap->uc_mcontext->__ss.__rbp, cursor->fp, sizeof(cursor->fp));
+            kr = plframe_cursor_read_stack(cursor, (void *) cursor->uap->uc_mcontext->__ss.__rbp, cursor->fp, sizeof(cursor->fp));
         } else {
             /* Frame data loaded, walk the stack */
-            kr = plframe_read_addr(cursor->fp[0], cursor->fp, sizeof(cursor->fp));
+            kr = plframe_cursor_read_stack(cursor, cursor->fp[0], cursor->fp, sizeof(cursor->fp));
         }
     }
     
@@ -222,6 +227,8 @@ plframe_error_t plframe_get_freg (plframe_cursor_t *cursor, plframe_regnum_t reg
     return PLFRAME_ENOTSUP;
 }
 
+#endif /* __APPLE__ */
+
 // PLFrameWalker API
 const char *plframe_get_regname (plframe_regnum_t regnum) {
     switch (regnum) {
@@ -0,0 +1,2461 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2010 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <stdlib.h>
+#import <fcntl.h>
+#import <errno.h>
+#import <string.h>
+#import <stdbool.h>
+#import <inttypes.h>
+#import <assert.h>
+#import <time.h>
+#import <dlfcn.h>
+
+#import <sys/param.h>
+
+#import "PLCrashReport.h"
+#import "PLCrashLogWriter.h"
+#import "PLCrashLogWriterEncoding.h"
+#import "PLCrashAsync.h"
+#import "PLCrashAsyncSignalInfo.h"
+#import "PLCrashFrameWalker.h"
+
+#if defined(__APPLE__)
+#import <mach-o/dyld.h>
+#import <mach-o/loader.h>
+#elif defined(__linux__)
+#import <elf.h>
+#import <sys/utsname.h>
+
+#import "PLCrashAsyncThread.h"
+#import "PLCrashAsyncImageELF.h"
+#endif
+
+/**
+ * @internal
+ * Maximum number of frames that will be written to the crash report for a single thread. Used as a safety measure
+ * to avoid overrunning our output limit when writing a crash report triggered by frame recursion.
+ */
+#define MAX_THREAD_FRAMES 512 // matches Apple's crash reporting on Snow Leopard
+
+/**
+ * @internal
+ * Number of slots in the backtrace interning table. Must be a power of two. Once full, additional distinct backtraces
+ * are written without being interned.
+ */
+#define MAX_INTERNED_STACKS 64
+
+/**
+ * @internal
+ * Number of PCs that may be held by the backtrace interning table's arena.
+ */
+#define MAX_INTERNED_STACK_PCS 4096
+
+/**
+ * @internal
+ * Size of the buffer holding the uncompressed crash report when compression is enabled. Reports larger than this
+ * are truncated prior to compression. The report is further truncated if its compressed size would exceed the
+ * output file's limit.
+ */
+#define MAX_UNCOMPRESSED_REPORT_BYTES (192 * 1024)
+
+/**
+ * @internal
+ * Maximum number of threads that will be captured prior to writing the crash report. Any additional threads are
+ * omitted from the report.
+ */
+#define MAX_SNAPSHOT_THREADS 256
+
+/**
+ * @internal
+ * Number of PCs that may be held by the frame arena's snapshot region, shared by all captured threads. Backtraces
+ * that do not fit are truncated to the innermost frames that fit.
+ */
+#define MAX_SNAPSHOT_PCS 16384
+
+/**
+ * @internal
+ * Number of slots in the table of binary images written to the crash report. Must be a power of two. Once full, no
+ * additional binary image records are written.
+ */
+#define MAX_REPORT_IMAGE_SLOTS 1024
+
+/**
+ * @internal
+ * Protobuf Field IDs, as defined in crashreport.proto
+ */
+enum {
+    /** CrashReport.system_info */
+    PLCRASH_PROTO_SYSTEM_INFO_ID = 1,
+
+    /** CrashReport.system_info.operating_system */
+    PLCRASH_PROTO_SYSTEM_INFO_OS_ID = 1,
+
+    /** CrashReport.system_info.os_version */
+    PLCRASH_PROTO_SYSTEM_INFO_OS_VERSION_ID = 2,
+
+    /** CrashReport.system_info.architecture */
+    PLCRASH_PROTO_SYSTEM_INFO_ARCHITECTURE_TYPE_ID = 3,
+
+    /** CrashReport.system_info.timestamp */
+    PLCRASH_PROTO_SYSTEM_INFO_TIMESTAMP_ID = 4,
+
+    /** CrashReport.system_info.os_build */
+    PLCRASH_PROTO_SYSTEM_INFO_OS_BUILD_ID = 5,
+
+    /** CrashReport.app_info */
+    PLCRASH_PROTO_APP_INFO_ID = 2,
+    
+    /** CrashReport.app_info.app_identifier */
+    PLCRASH_PROTO_APP_INFO_APP_IDENTIFIER_ID = 1,
+    
+    /** CrashReport.app_info.app_version */
+    PLCRASH_PROTO_APP_INFO_APP_VERSION_ID = 2,
+
+
+    /** CrashReport.threads */
+    PLCRASH_PROTO_THREADS_ID = 3,
+    
+
+    /** CrashReports.thread.thread_number */
+    PLCRASH_PROTO_THREAD_THREAD_NUMBER_ID = 1,
+
+    /** CrashReports.thread.frames */
+    PLCRASH_PROTO_THREAD_FRAMES_ID = 2,
+
+    /** CrashReport.thread.crashed */
+    PLCRASH_PROTO_THREAD_CRASHED_ID = 3,
+
+
+    /** CrashReport.thread.frame.pc */
+    PLCRASH_PROTO_THREAD_FRAME_PC_ID = 3,
+
+
+    /** CrashReport.thread.registers */
+    PLCRASH_PROTO_THREAD_REGISTERS_ID = 4,
+
+    /** CrashReport.thread.pcs */
+    PLCRASH_PROTO_THREAD_PCS_ID = 5,
+
+    /** CrashReport.thread.image_relative_pcs */
+    PLCRASH_PROTO_THREAD_IMAGE_RELATIVE_PCS_ID = 6,
+
+    /** CrashReport.thread.interned_stack */
+    PLCRASH_PROTO_THREAD_INTERNED_STACK_ID = 7,
+
+    /** CrashReport.thread.register_set */
+    PLCRASH_PROTO_THREAD_REGISTER_SET_ID = 8,
+
+    /** CrashReport.thread.register_values */
+    PLCRASH_PROTO_THREAD_REGISTER_VALUES_ID = 9,
+
+
+    /** CrashReport.images */
+    PLCRASH_PROTO_BINARY_IMAGES_ID = 4,
+
+    /** CrashReport.BinaryImage.base_address */
+    PLCRASH_PROTO_BINARY_IMAGE_ADDR_ID = 1,
+
+    /** CrashReport.BinaryImage.size */
+    PLCRASH_PROTO_BINARY_IMAGE_SIZE_ID = 2,
+
+    /** CrashReport.BinaryImage.name */
+    PLCRASH_PROTO_BINARY_IMAGE_NAME_ID = 3,
+    
+    /** CrashReport.BinaryImage.uuid */
+    PLCRASH_PROTO_BINARY_IMAGE_UUID_ID = 4,
+
+    /** CrashReport.BinaryImage.code_type */
+    PLCRASH_PROTO_BINARY_IMAGE_CODE_TYPE_ID = 5,
+
+    
+    /** CrashReport.exception */
+    PLCRASH_PROTO_EXCEPTION_ID = 5,
+
+    /** CrashReport.exception.name */
+    PLCRASH_PROTO_EXCEPTION_NAME_ID = 1,
+    
+    /** CrashReport.exception.reason */
+    PLCRASH_PROTO_EXCEPTION_REASON_ID = 2,
+    
+    /** CrashReports.exception.frames */
+    PLCRASH_PROTO_EXCEPTION_FRAMES_ID = 3,
+
+    /** CrashReports.exception.pcs */
+    PLCRASH_PROTO_EXCEPTION_PCS_ID = 4,
+
+    /** CrashReports.exception.image_relative_pcs */
+    PLCRASH_PROTO_EXCEPTION_IMAGE_RELATIVE_PCS_ID = 5,
+
+
+    /** CrashReport.signal */
+    PLCRASH_PROTO_SIGNAL_ID = 6,
+
+    /** CrashReport.signal.name */
+    PLCRASH_PROTO_SIGNAL_NAME_ID = 1,
+
+    /** CrashReport.signal.code */
+    PLCRASH_PROTO_SIGNAL_CODE_ID = 2,
+    
+    /** CrashReport.signal.address */
+    PLCRASH_PROTO_SIGNAL_ADDRESS_ID = 3,
+    
+    
+    /** CrashReport.process_info */
+    PLCRASH_PROTO_PROCESS_INFO_ID = 7,
+    
+    /** CrashReport.process_info.process_name */
+    PLCRASH_PROTO_PROCESS_INFO_PROCESS_NAME_ID = 1,
+    
+    /** CrashReport.process_info.process_id */
+    PLCRASH_PROTO_PROCESS_INFO_PROCESS_ID_ID = 2,
+    
+    /** CrashReport.process_info.process_path */
+    PLCRASH_PROTO_PROCESS_INFO_PROCESS_PATH_ID = 3,
+    
+    /** CrashReport.process_info.parent_process_name */
+    PLCRASH_PROTO_PROCESS_INFO_PARENT_PROCESS_NAME_ID = 4,
+    
+    /** CrashReport.process_info.parent_process_id */
+    PLCRASH_PROTO_PROCESS_INFO_PARENT_PROCESS_ID_ID = 5,
+    
+    /** CrashReport.process_info.native */
+    PLCRASH_PROTO_PROCESS_INFO_NATIVE_ID = 6,
+
+    
+    /** CrashReport.Processor.encoding */
+    PLCRASH_PROTO_PROCESSOR_ENCODING_ID = 1,
+    
+    /** CrashReport.Processor.encoding */
+    PLCRASH_PROTO_PROCESSOR_TYPE_ID = 2,
+    
+    /** CrashReport.Processor.encoding */
+    PLCRASH_PROTO_PROCESSOR_SUBTYPE_ID = 3,
+
+
+    /** CrashReport.machine_info */
+    PLCRASH_PROTO_MACHINE_INFO_ID = 8,
+
+    /** CrashReport.machine_info.model */
+    PLCRASH_PROTO_MACHINE_INFO_MODEL_ID = 1,
+
+    /** CrashReport.machine_info.processor */
+    PLCRASH_PROTO_MACHINE_INFO_PROCESSOR_ID = 2,
+
+    /** CrashReport.machine_info.processor_count */
+    PLCRASH_PROTO_MACHINE_INFO_PROCESSOR_COUNT_ID = 3,
+
+    /** CrashReport.machine_info.logical_processor_count */
+    PLCRASH_PROTO_MACHINE_INFO_LOGICAL_PROCESSOR_COUNT_ID = 4,
+
+
+    /** CrashReport.Processor.TypeEncoding.TYPE_ENCODING_MACH */
+    PLCRASH_PROTO_PROCESSOR_ENCODING_MACH = 1,
+
+    /** CrashReport.Processor.TypeEncoding.TYPE_ENCODING_ELF */
+    PLCRASH_PROTO_PROCESSOR_ENCODING_ELF = 2,
+
+
+    /** CrashReport.SystemInfo.OperatingSystem.OS_UNKNOWN */
+    PLCRASH_PROTO_OPERATING_SYSTEM_UNKNOWN = 3,
+
+    /** CrashReport.Architecture.X86_64 */
+    PLCRASH_PROTO_ARCHITECTURE_X86_64 = 1,
+};
+
+/**
+ * @internal
+ *
+ * The CrashReport.Processor.TypeEncoding of the host's CPU type, as recorded in the machine info.
+ */
+#if defined(__APPLE__)
+#define PLCRASH_WRITER_HOST_PROCESSOR_ENCODING PLCRASH_PROTO_PROCESSOR_ENCODING_MACH
+#elif defined(__linux__)
+#define PLCRASH_WRITER_HOST_PROCESSOR_ENCODING PLCRASH_PROTO_PROCESSOR_ENCODING_ELF
+#else
+#error Unsupported Platform
+#endif
+
+static size_t plcrash_writer_write_static_sections (plcrash_async_file_t *file, plcrash_log_writer_t *writer);
+
+#ifdef __APPLE__
+/**
+ * @internal
+ *
+ * Binary image data required to encode a BinaryImage message, as parsed from the image's Mach-O header.
+ */
+typedef struct plcrash_writer_image_info {
+    /** The image's __TEXT segment size. */
+    uint64_t size;
+
+    /** The image's CPU type. */
+    cpu_type_t cpu_type;
+
+    /** The image's CPU subtype. */
+    cpu_subtype_t cpu_subtype;
+
+    /** True if the image has an LC_UUID load command. */
+    bool has_uuid;
+
+    /** The image's 128-bit UUID, if has_uuid is true. */
+    uint8_t uuid[16];
+} plcrash_writer_image_info_t;
+
+static bool plcrash_writer_parse_binary_image (const void *header, plcrash_writer_image_info_t *info);
+static size_t plcrash_writer_write_binary_image_record (plcrash_async_file_t *file, const char *name, const void *header,
+                                                        const plcrash_writer_image_info_t *info);
+#endif /* __APPLE__ */
+
+/**
+ * Initialize a new crash log writer instance and issue a memory barrier upon completion. This fetches all necessary
+ * environment information, and pre-encodes the report sections that will not change prior to a crash.
+ *
+ * @param writer Writer instance to be initialized.
+ * @param app_identifier Unique per-application identifier. On Mac OS X, this is likely the CFBundleIdentifier.
+ * @param app_version Application version string.
+ *
+ * @note If this function fails, plcrash_log_writer_free() should be called
+ * to free any partially allocated data.
+ *
+ * @warning This function is not guaranteed to be async-safe, and must be called prior to enabling the crash handler.
+ *
+ * @sa plcrash_log_writer_init(), which accepts Foundation strings.
+ */
+plcrash_error_t plcrash_log_writer_init_c (plcrash_log_writer_t *writer, const char *app_identifier, const char *app_version) {
+    plcrash_error_t err;
+
+    /* Default to 0 */
+    memset(writer, 0, sizeof(*writer));
+
+    /* Initialize the image info list. */
+    plcrash_async_image_list_init(&writer->image_info.image_list);
+
+    /* Fetch the application information */
+    {
+        writer->application_info.app_identifier = strdup(app_identifier);
+        writer->application_info.app_version = strdup(app_version);
+    }
+
+    /* Fetch the process, machine, and OS information */
+    if ((err = plcrash_log_writer_init_host_info(writer)) != PLCRASH_ESUCCESS)
+        return err;
+
+#ifdef __linux__
+    /* Install the thread suspension handler, used to capture the other threads at crash time */
+    if ((err = plcrash_async_thread_init()) != PLCRASH_ESUCCESS)
+        return err;
+#endif
+
+    /* Pre-encode the static report sections, leaving only the timestamp to be written at crash time. */
+    {
+        plcrash_async_file_t buffer;
+        size_t length;
+
+        length = plcrash_writer_write_static_sections(NULL, writer);
+        writer->static_sections.data = malloc(length);
+        if (writer->static_sections.data == NULL) {
+            PLCF_DEBUG("Could not allocate static report section buffer");
+            return PLCRASH_ENOMEM;
+        }
+
+        plcrash_async_file_init_mem(&buffer, writer->static_sections.data, length);
+        writer->static_sections.length = plcrash_writer_write_static_sections(&buffer, writer);
+        assert(writer->static_sections.length == length);
+    }
+
+    /* Pre-allocate the frame arena, holding the crashed thread's backtrace, and the backtraces of all captured
+     * threads. */
+    writer->frame_arena.capacity = MAX_THREAD_FRAMES + MAX_SNAPSHOT_PCS;
+    writer->frame_arena.pcs = malloc(writer->frame_arena.capacity * sizeof(uint64_t));
+    writer->frame_arena.thread_capacity = MAX_SNAPSHOT_THREADS;
+    writer->frame_arena.threads = calloc(writer->frame_arena.thread_capacity, sizeof(plcrash_log_writer_thread_snapshot_t));
+    if (writer->frame_arena.pcs == NULL || writer->frame_arena.threads == NULL) {
+        PLCF_DEBUG("Could not allocate frame arena");
+        return PLCRASH_ENOMEM;
+    }
+
+#ifdef __linux__
+    /* Pre-allocate the thread list, populated from /proc/self/task at crash time */
+    writer->frame_arena.thread_list = calloc(writer->frame_arena.thread_capacity, sizeof(pid_t));
+    if (writer->frame_arena.thread_list == NULL) {
+        PLCF_DEBUG("Could not allocate thread list");
+        return PLCRASH_ENOMEM;
+    }
+#endif
+
+    /* Pre-allocate the backtrace interning table. This is not fatal; if unavailable, all backtraces are written
+     * in full. */
+    writer->stack_table.stacks = calloc(MAX_INTERNED_STACKS, sizeof(plcrash_log_writer_stack_t));
+    writer->stack_table.pcs = malloc(MAX_INTERNED_STACK_PCS * sizeof(uint64_t));
+    if (writer->stack_table.stacks != NULL && writer->stack_table.pcs != NULL) {
+        writer->stack_table.capacity = MAX_INTERNED_STACKS;
+        writer->stack_table.pcs_capacity = MAX_INTERNED_STACK_PCS;
+    } else {
+        PLCF_DEBUG("Could not allocate backtrace interning table");
+    }
+
+    /* Pre-allocate the written image table, used to determine which binary image records have been written */
+    writer->report_images.capacity = MAX_REPORT_IMAGE_SLOTS;
+    writer->report_images.slots = calloc(writer->report_images.capacity, sizeof(plcrash_log_writer_report_image_t));
+    if (writer->report_images.slots == NULL) {
+        PLCF_DEBUG("Could not allocate written image table");
+        return PLCRASH_ENOMEM;
+    }
+
+    /* Ensure that any signal handler has a consistent view of the above initialization. */
+    OSMemoryBarrier();
+
+    return PLCRASH_ESUCCESS;
+}
+
+#if defined(__APPLE__)
+
+/**
+ * Register a binary image with this writer. The image's Mach-O header is parsed once, and its report record
+ * is encoded immediately; no further parsing of the image is required at crash time. Images that have already been
+ * registered are ignored; this is checked by the image list when the image is appended.
+ *
+ * @param writer The writer to which the image's information will be added.
+ * @param header_addr The image's address.
+ *
+ * @warning This function is not async safe, and must be called outside of a signal handler.
+ */
+void plcrash_log_writer_add_image (plcrash_log_writer_t *writer, const void *header_addr) {
+    plcrash_writer_image_info_t image_info;
+    plcrash_async_file_t buffer;
+    void *record = NULL;
+    size_t record_len = 0;
+    Dl_info info;
+
+    /* Look up the image info */
+    if (dladdr(header_addr, &info) == 0) {
+        PLCF_DEBUG("dladdr(%p, ...) failed", header_addr);
+        return;
+    }
+
+    /* Parse the image once. Images that can not be parsed are never written to the report, and are not registered. */
+    if (!plcrash_writer_parse_binary_image(header_addr, &image_info))
+        return;
+
+    /* Pre-encode the image's report record */
+    record_len = plcrash_writer_write_binary_image_record(NULL, info.dli_fname, header_addr, &image_info);
+    if ((record = malloc(record_len)) != NULL) {
+        plcrash_async_file_init_mem(&buffer, record, record_len);
+        plcrash_writer_write_binary_image_record(&buffer, info.dli_fname, header_addr, &image_info);
+    }
+
+    /* Register the image */
+    plcrash_async_image_list_append(&writer->image_info.image_list, (uintptr_t)header_addr, image_info.size, info.dli_fname,
+                                    record, record_len);
+
+    if (record != NULL)
+        free(record);
+}
+
+/**
+ * Register multiple binary images with this writer, in order. This is equivalent to calling
+ * plcrash_log_writer_add_image() for each image, but encodes all image records into a single allocation, and appends
+ * them to the image list as a single batch. Images that have already been registered are ignored.
+ *
+ * @param writer The writer to which the images' information will be added.
+ * @param header_addrs The images' addresses.
+ * @param names The images' names, or NULL. If NULL, or if an individual name is NULL, the image's name will be
+ * resolved via dladdr().
+ * @param count The number of images.
+ *
+ * @warning This function is not async safe, and must be called outside of a signal handler.
+ */
+void plcrash_log_writer_add_images (plcrash_log_writer_t *writer, const void * const *header_addrs, const char * const *names,
+                                    size_t count)
+{
+    plcrash_writer_image_info_t *image_info;
+    plcrash_async_image_entry_t *entries;
+    plcrash_async_file_t buffer;
+    uint8_t *records = NULL;
+    size_t records_len = 0;
+    size_t entry_count = 0;
+
+    if (count == 0)
+        return;
+
+    image_info = malloc(count * sizeof(*image_info));
+    entries = malloc(count * sizeof(*entries));
+    if (image_info == NULL || entries == NULL) {
+        PLCF_DEBUG("Could not allocate image batch");
+        goto cleanup;
+    }
+
+    /* Parse the images once, and determine the total record length. */
+    for (size_t i = 0; i < count; i++) {
+        plcrash_async_image_entry_t *entry = &entries[entry_count];
+        const void *header_addr = header_addrs[i];
+        Dl_info info;
+
+        entry->name = (names != NULL) ? names[i] : NULL;
+        if (entry->name == NULL) {
+            if (dladdr(header_addr, &info) == 0) {
+                PLCF_DEBUG("dladdr(%p, ...) failed", header_addr);
+                continue;
+            }
+            entry->name = info.dli_fname;
+        }
+
+        /* As with plcrash_log_writer_add_image(), images that can not be parsed are not registered. */
+        if (!plcrash_writer_parse_binary_image(header_addr, &image_info[entry_count]))
+            continue;
+
+        entry->header = (uintptr_t) header_addr;
+        entry->size = image_info[entry_count].size;
+        entry->record_len = plcrash_writer_write_binary_image_record(NULL, entry->name, header_addr, &image_info[entry_count]);
+        records_len += entry->record_len;
+        entry_count++;
+    }
+
+    /* Pre-encode the image records. If unavailable, the records will be encoded at crash time. */
+    if (records_len > 0 && (records = malloc(records_len)) != NULL) {
+        plcrash_async_file_init_mem(&buffer, records, records_len);
+        for (size_t i = 0; i < entry_count; i++) {
+            entries[i].record = records + buffer.total_bytes;
+            plcrash_writer_write_binary_image_record(&buffer, entries[i].name, (const void *) entries[i].header, &image_info[i]);
+        }
+    } else {
+        for (size_t i = 0; i < entry_count; i++)
+            entries[i].record = NULL;
+    }
+
+    /* Register the images */
+    plcrash_async_image_list_append_batch(&writer->image_info.image_list, entries, entry_count);
+
+cleanup:
+    if (records != NULL)
+        free(records);
+    if (entries != NULL)
+        free(entries);
+    if (image_info != NULL)
+        free(image_info);
+}
+
+#elif defined(__linux__)
+
+/**
+ * @internal
+ *
+ * Read the first line of the file at @a path.
+ *
+ * @return Returns a malloc-allocated string, or NULL if the file could not be read.
+ */
+static char *plcrash_writer_read_line (const char *path) {
+    char buffer[MAXPATHLEN];
+    ssize_t len;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+
+    len = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (len <= 0)
+        return NULL;
+
+    buffer[len] = '\0';
+    buffer[strcspn(buffer, "\n")] = '\0';
+    return strdup(buffer);
+}
+
+/**
+ * @internal
+ *
+ * Fetch the process, machine, and operating system information of the host. Called by plcrash_log_writer_init_c().
+ *
+ * The crash report format has no Linux operating system value; the operating system is reported as unknown, and the
+ * kernel release and version are reported as the OS version and build. CPU types are reported as ELF machine types.
+ *
+ * @param writer Writer instance to be populated.
+ *
+ * @warning This function is not async-safe.
+ */
+plcrash_error_t plcrash_log_writer_init_host_info (plcrash_log_writer_t *writer) {
+    /* Fetch the process information */
+    {
+        char path[MAXPATHLEN];
+        ssize_t len;
+
+        /* Current process */
+        writer->process_info.process_id = getpid();
+        writer->process_info.process_name = plcrash_writer_read_line("/proc/self/comm");
+        if (writer->process_info.process_name == NULL) {
+            PLCF_DEBUG("Could not retrieve process name: %s", strerror(errno));
+        }
+
+        if ((len = readlink("/proc/self/exe", path, sizeof(path) - 1)) > 0) {
+            path[len] = '\0';
+            writer->process_info.process_path = strdup(path);
+        }
+
+        /* Parent process */
+        writer->process_info.parent_process_id = getppid();
+        snprintf(path, sizeof(path), "/proc/%d/comm", (int) writer->process_info.parent_process_id);
+        writer->process_info.parent_process_name = plcrash_writer_read_line(path);
+        if (writer->process_info.parent_process_name == NULL) {
+            PLCF_DEBUG("Could not retrieve parent process name: %s", strerror(errno));
+        }
+
+        /* Emulation is not detected */
+        writer->process_info.native = true;
+    }
+
+    /* Fetch the machine information. The model is not available. */
+    {
+        long count;
+
+#if defined(__x86_64__)
+        writer->machine_info.cpu_type = EM_X86_64;
+#else
+#error Unsupported Platform
+#endif
+        writer->machine_info.cpu_subtype = 0;
+
+        /* The physical core count is not available without parsing /proc/cpuinfo; the logical count is used for both */
+        if ((count = sysconf(_SC_NPROCESSORS_CONF)) > 0) {
+            writer->machine_info.processor_count = (uint32_t) count;
+            writer->machine_info.logical_processor_count = (uint32_t) count;
+        } else {
+            PLCF_DEBUG("Could not retrieve the processor count: %s", strerror(errno));
+        }
+    }
+
+    /* Fetch the OS information */
+    {
+        struct utsname uts;
+
+        if (uname(&uts) != 0) {
+            PLCF_DEBUG("Could not retrieve the kernel version: %s", strerror(errno));
+            return PLCRASH_EINTERNAL;
+        }
+
+        writer->system_info.version = strdup(uts.release);
+        writer->system_info.build = strdup(uts.version);
+        writer->system_info.operating_system = PLCRASH_PROTO_OPERATING_SYSTEM_UNKNOWN;
+        writer->system_info.architecture = PLCRASH_PROTO_ARCHITECTURE_X86_64;
+    }
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Bring the writer's binary images up to date with the ELF objects currently loaded in the process. On Linux, this
+ * takes the place of plcrash_log_writer_add_image() and plcrash_log_writer_remove_image(), and should be called once
+ * the writer is initialized, and again whenever objects may have been loaded or unloaded.
+ *
+ * @param writer The writer whose images will be updated.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or PLCRASH_ENOMEM if the loaded objects could not be recorded.
+ *
+ * @warning This function is not async safe, and must be called outside of a signal handler.
+ */
+plcrash_error_t plcrash_log_writer_update_images (plcrash_log_writer_t *writer) {
+    return plcrash_async_image_elf_list_update(&writer->image_info.image_list);
+}
+
+#endif /* __linux__ */
+
+/**
+ * Deregister a binary image from this writer.
+ *
+ * @param writer The writer from which the image's information will be removed.
+ * @param header_addr The image's address.
+ *
+ * @warning This function is not async safe, and must be called outside of a signal handler.
+ */
+void plcrash_log_writer_remove_image (plcrash_log_writer_t *writer, const void *header_addr) {
+    plcrash_async_image_list_remove(&writer->image_info.image_list, (uintptr_t)header_addr);
+}
+
+/**
+ * Set the encoding options to be used when writing a crash report.
+ *
+ * @param writer The writer to configure.
+ * @param options A bitwise OR of plcrash_log_writer_option_t values.
+ *
+ * @warning This function is not async safe, and must be called outside of a signal handler.
+ */
+void plcrash_log_writer_set_options (plcrash_log_writer_t *writer, uint32_t options) {
+    /* Pre-allocate the compression buffers. This is not fatal; if unavailable, the report is written uncompressed. */
+    if ((options & PLCRASH_LOG_WRITER_OPTION_COMPRESS) && writer->compression.buffer == NULL) {
+        writer->compression.state = malloc(sizeof(plcrash_async_lz_state_t));
+        writer->compression.buffer = malloc(MAX_UNCOMPRESSED_REPORT_BYTES);
+
+        if (writer->compression.state != NULL && writer->compression.buffer != NULL) {
+            writer->compression.size = MAX_UNCOMPRESSED_REPORT_BYTES;
+        } else {
+            PLCF_DEBUG("Could not allocate crash report compression buffers");
+            free(writer->compression.state);
+            free(writer->compression.buffer);
+            writer->compression.state = NULL;
+            writer->compression.buffer = NULL;
+        }
+    }
+
+    writer->options = options;
+
+    /* Ensure that any signal handler has a consistent view of the above initialization. */
+    OSMemoryBarrier();
+}
+
+/**
+ * Close the plcrash_writer_t output.
+ *
+ * @param writer Writer instance to be closed.
+ */
+plcrash_error_t plcrash_log_writer_close (plcrash_log_writer_t *writer) {
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Free any crash log writer resources.
+ *
+ * @warning This method is not async safe.
+ */
+void plcrash_log_writer_free (plcrash_log_writer_t *writer) {
+    /* Free the app info */
+    if (writer->application_info.app_identifier != NULL)
+        free(writer->application_info.app_identifier);
+    if (writer->application_info.app_version != NULL)
+        free(writer->application_info.app_version);
+
+    /* Free the process info */
+    if (writer->process_info.process_name != NULL) 
+        free(writer->process_info.process_name);
+    if (writer->process_info.process_path != NULL) 
+        free(writer->process_info.process_path);
+    if (writer->process_info.parent_process_name != NULL) 
+        free(writer->process_info.parent_process_name);
+    
+    /* Free the system info */
+    if (writer->system_info.version != NULL)
+        free(writer->system_info.version);
+    
+    if (writer->system_info.build != NULL)
+        free(writer->system_info.build);
+    
+    /* Free the machine info */
+    if (writer->machine_info.model != NULL)
+        free(writer->machine_info.model);
+
+    /* Free the pre-encoded report sections */
+    if (writer->static_sections.data != NULL)
+        free(writer->static_sections.data);
+
+    /* Free the frame arena */
+    if (writer->frame_arena.pcs != NULL)
+        free(writer->frame_arena.pcs);
+    if (writer->frame_arena.threads != NULL)
+        free(writer->frame_arena.threads);
+#ifdef __linux__
+    if (writer->frame_arena.thread_list != NULL)
+        free(writer->frame_arena.thread_list);
+#endif
+
+    /* Free the backtrace interning table */
+    if (writer->stack_table.stacks != NULL)
+        free(writer->stack_table.stacks);
+    if (writer->stack_table.pcs != NULL)
+        free(writer->stack_table.pcs);
+
+    /* Free the written image table */
+    if (writer->report_images.slots != NULL)
+        free(writer->report_images.slots);
+
+    /* Free the compression buffers */
+    if (writer->compression.state != NULL)
+        free(writer->compression.state);
+    if (writer->compression.buffer != NULL)
+        free(writer->compression.buffer);
+
+    /* Free the binary image info */
+    plcrash_async_image_list_free(&writer->image_info.image_list);
+
+    /* Free the exception data */
+    if (writer->uncaught_exception.has_exception) {
+        if (writer->uncaught_exception.name != NULL)
+            free(writer->uncaught_exception.name);
+
+        if (writer->uncaught_exception.reason != NULL)
+            free(writer->uncaught_exception.reason);
+        
+        if (writer->uncaught_exception.callstack != NULL)
+            free(writer->uncaught_exception.callstack);
+    }
+}
+
+/**
+ * @internal
+ *
+ * Write the system info message, excluding the timestamp field. The timestamp is not known until crash time, and
+ * must be written separately via plcrash_writer_pack_padded_varint().
+ *
+ * @param file Output file
+ */
+static size_t plcrash_writer_write_system_info (plcrash_async_file_t *file, plcrash_log_writer_t *writer) {
+    size_t rv = 0;
+    uint32_t enumval;
+
+    /* OS */
+    enumval = writer->system_info.operating_system;
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_SYSTEM_INFO_OS_ID, PLPROTOBUF_C_TYPE_ENUM, &enumval);
+
+    /* OS Version */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_SYSTEM_INFO_OS_VERSION_ID, PLPROTOBUF_C_TYPE_STRING, writer->system_info.version);
+    
+    /* OS Build */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_SYSTEM_INFO_OS_BUILD_ID, PLPROTOBUF_C_TYPE_STRING, writer->system_info.build);
+
+    /* Machine type */
+    enumval = writer->system_info.architecture;
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_SYSTEM_INFO_ARCHITECTURE_TYPE_ID, PLPROTOBUF_C_TYPE_ENUM, &enumval);
+
+    return rv;
+}
+
+/**
+ * @internal
+ *
+ * Write the processor info message.
+ *
+ * @param file Output file
+ * @param encoding The CPU type encoding; either PLCRASH_PROTO_PROCESSOR_ENCODING_MACH or
+ * PLCRASH_PROTO_PROCESSOR_ENCODING_ELF.
+ * @param cpu_type The CPU type.
+ * @param cpu_subtype_t The CPU subtype
+ */
+static size_t plcrash_writer_write_processor_info (plcrash_async_file_t *file, uint32_t encoding, uint64_t cpu_type,
+                                                   uint64_t cpu_subtype)
+{
+    size_t rv = 0;
+    
+    /* Encoding */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_PROCESSOR_ENCODING_ID, PLPROTOBUF_C_TYPE_ENUM, &encoding);
+
+    /* Type */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_PROCESSOR_TYPE_ID, PLPROTOBUF_C_TYPE_UINT64, &cpu_type);
+
+    /* Subtype */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_PROCESSOR_SUBTYPE_ID, PLPROTOBUF_C_TYPE_UINT64, &cpu_subtype);
+    
+    return rv;
+}
+
+/**
+ * @internal
+ *
+ * Write the machine info message.
+ *
+ * @param file Output file
+ */
+static size_t plcrash_writer_write_machine_info (plcrash_async_file_t *file, plcrash_log_writer_t *writer) {
+    size_t rv = 0;
+    
+    /* Model */
+    if (writer->machine_info.model != NULL)
+        rv += plcrash_writer_pack(file, PLCRASH_PROTO_MACHINE_INFO_MODEL_ID, PLPROTOBUF_C_TYPE_STRING, writer->machine_info.model);
+
+    /* Processor */
+    {
+        uint32_t size;
+
+        /* Determine size */
+        size = plcrash_writer_write_processor_info(NULL, PLCRASH_WRITER_HOST_PROCESSOR_ENCODING, writer->machine_info.cpu_type,
+                                                   writer->machine_info.cpu_subtype);
+
+        /* Write message */
+        rv += plcrash_writer_pack(file, PLCRASH_PROTO_MACHINE_INFO_PROCESSOR_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+        rv += plcrash_writer_write_processor_info(file, PLCRASH_WRITER_HOST_PROCESSOR_ENCODING, writer->machine_info.cpu_type,
+                                                  writer->machine_info.cpu_subtype);
+    }
+
+    /* Physical Processor Count */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_MACHINE_INFO_PROCESSOR_COUNT_ID, PLPROTOBUF_C_TYPE_UINT32, &writer->machine_info.processor_count);
+    
+    /* Logical Processor Count */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_MACHINE_INFO_LOGICAL_PROCESSOR_COUNT_ID, PLPROTOBUF_C_TYPE_UINT32, &writer->machine_info.logical_processor_count);
+    
+    return rv;
+}
+
+/**
+ * @internal
+ *
+ * Write the app info message.
+ *
+ * @param file Output file
+ * @param app_identifier Application identifier
+ * @param app_version Application version
+ */
+static size_t plcrash_writer_write_app_info (plcrash_async_file_t *file, const char *app_identifier, const char *app_version) {
+    size_t rv = 0;
+
+    /* App identifier */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_APP_INFO_APP_IDENTIFIER_ID, PLPROTOBUF_C_TYPE_STRING, app_identifier);
+    
+    /* App version */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_APP_INFO_APP_VERSION_ID, PLPROTOBUF_C_TYPE_STRING, app_version);
+    
+    return rv;
+}
+
+/**
+ * @internal
+ *
+ * Write the process info message.
+ *
+ * @param file Output file
+ * @param process_name Process name
+ * @param process_id Process ID
+ * @param process_path Process path
+ * @param parent_process_name Parent process name
+ * @param parent_process_id Parent process ID
+ * @param native If false, process is running under emulation.
+ */
+static size_t plcrash_writer_write_process_info (plcrash_async_file_t *file, const char *process_name, 
+                                                 const pid_t process_id, const char *process_path, 
+                                                 const char *parent_process_name, const pid_t parent_process_id,
+                                                 bool native) 
+{
+    size_t rv = 0;
+
+    /* Process name */
+    if (process_name != NULL)
+        rv += plcrash_writer_pack(file, PLCRASH_PROTO_PROCESS_INFO_PROCESS_NAME_ID, PLPROTOBUF_C_TYPE_STRING, process_name);
+
+    /* Process ID */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_PROCESS_INFO_PROCESS_ID_ID, PLPROTOBUF_C_TYPE_UINT64, &process_id);
+
+    /* Process path */
+    if (process_path != NULL)
+        rv += plcrash_writer_pack(file, PLCRASH_PROTO_PROCESS_INFO_PROCESS_PATH_ID, PLPROTOBUF_C_TYPE_STRING, process_path);
+
+    /* Parent process name */
+    if (parent_process_name != NULL)
+        rv += plcrash_writer_pack(file, PLCRASH_PROTO_PROCESS_INFO_PARENT_PROCESS_NAME_ID, PLPROTOBUF_C_TYPE_STRING, parent_process_name);
+
+    /* Parent process ID */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_PROCESS_INFO_PARENT_PROCESS_ID_ID, PLPROTOBUF_C_TYPE_UINT64, &parent_process_id);
+
+    /* Native process. */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_PROCESS_INFO_NATIVE_ID, PLPROTOBUF_C_TYPE_BOOL, &native);
+
+    return rv;
+}
+
+/**
+ * @internal
+ *
+ * Write the report sections that do not change after writer initialization: the machine, application, process,
+ * and system info messages. The system info message is written last, and its length includes a trailing
+ * padded timestamp field that must be written immediately afterwards via plcrash_writer_pack_padded_varint().
+ *
+ * @param file Output file
+ * @param writer Writer context
+ */
+static size_t plcrash_writer_write_static_sections (plcrash_async_file_t *file, plcrash_log_writer_t *writer) {
+    size_t rv = 0;
+    uint32_t size;
+
+    /* Machine Info */
+    size = plcrash_writer_write_machine_info(NULL, writer);
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_MACHINE_INFO_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+    rv += plcrash_writer_write_machine_info(file, writer);
+
+    /* App info */
+    size = plcrash_writer_write_app_info(NULL, writer->application_info.app_identifier, writer->application_info.app_version);
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_APP_INFO_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+    rv += plcrash_writer_write_app_info(file, writer->application_info.app_identifier, writer->application_info.app_version);
+
+    /* Process info */
+    size = plcrash_writer_write_process_info(NULL, writer->process_info.process_name, writer->process_info.process_id,
+                                             writer->process_info.process_path, writer->process_info.parent_process_name,
+                                             writer->process_info.parent_process_id, writer->process_info.native);
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_PROCESS_INFO_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+    rv += plcrash_writer_write_process_info(file, writer->process_info.process_name, writer->process_info.process_id,
+                                            writer->process_info.process_path, writer->process_info.parent_process_name,
+                                            writer->process_info.parent_process_id, writer->process_info.native);
+
+    /* System Info (sans timestamp) */
+    size = plcrash_writer_write_system_info(NULL, writer);
+    size += plcrash_writer_pack_padded_varint(NULL, PLCRASH_PROTO_SYSTEM_INFO_TIMESTAMP_ID, 0);
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_SYSTEM_INFO_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+    rv += plcrash_writer_write_system_info(file, writer);
+
+    return rv;
+}
+
+/**
+ * @internal
+ *
+ * The CrashReport.thread.register_set value corresponding to the host's plframe_regnum_t register numbering.
+ */
+#if defined(__x86_64__)
+#define PLCRASH_WRITER_HOST_REGISTER_SET 2
+#elif defined(__i386__)
+#define PLCRASH_WRITER_HOST_REGISTER_SET 1
+#elif defined(__arm__)
+#define PLCRASH_WRITER_HOST_REGISTER_SET 3
+#elif defined(__ppc__)
+#define PLCRASH_WRITER_HOST_REGISTER_SET 4
+#else
+#error Unsupported Platform
+#endif
+
+/** @internal The number of registers captured for the crashed thread. */
+#define PLCRASH_WRITER_REGISTER_COUNT (PLFRAME_REG_LAST + 1)
+
+/**
+ * @internal
+ *
+ * Write the thread register set and packed register values.
+ *
+ * The values are written in plframe_regnum_t order, identified by the host's register set; the register names
+ * are supplied by the reader.
+ *
+ * @param file Output file
+ * @param regs The register values, as captured by plcrash_writer_capture_backtrace().
+ * @param reg_count The number of values in @a regs. If 0, nothing will be written.
+ */
+static size_t plcrash_writer_write_thread_registers (plcrash_async_file_t *file, const plframe_greg_t *regs, uint32_t reg_count) {
+    plcrash_writer_message_t msg;
+    size_t rv = 0;
+
+    if (reg_count == 0)
+        return 0;
+
+    /* Write the register set */
+    rv += plcrash_writer_pack_uint32(file, PLCRASH_PROTO_THREAD_REGISTER_SET_ID, PLCRASH_WRITER_HOST_REGISTER_SET);
+
+    /* Write the packed values */
+    size_t header = plcrash_writer_pack_message_begin(file, PLCRASH_PROTO_THREAD_REGISTER_VALUES_ID, &msg);
+    if (header == 0)
+        return rv;
+
+    rv += header;
+    for (uint32_t i = 0; i < reg_count; i++)
+        rv += plcrash_writer_pack_packed_varint(file, regs[i]);
+    plcrash_writer_pack_message_end(file, &msg);
+
+    return rv;
+}
+
+/**
+ * @internal
+ *
+ * Return the written image table slot at which the search for @a image begins.
+ */
+static inline size_t plcrash_writer_report_image_slot (plcrash_log_writer_t *writer, plcrash_async_image_t *image) {
+    uint64_t hash = (uint64_t) (uintptr_t) image * 0x9E3779B97F4A7C15ULL;
+    return (size_t) (hash ^ (hash >> 32)) & (writer->report_images.capacity - 1);
+}
+
+/**
+ * @internal
+ *
+ * Reset the written image table. Must be called prior to writing the binary image records.
+ */
+static void plcrash_writer_report_images_reset (plcrash_log_writer_t *writer) {
+    for (size_t i = 0; i < writer->report_images.capacity; i++)
+        writer->report_images.slots[i].image = NULL;
+
+    writer->report_images.count = 0;
+}
+
+/**
+ * @internal
+ *
+ * Record that the record of @a image has been written to the crash report at @a index. The table must not be full.
+ */
+static void plcrash_writer_report_images_add (plcrash_log_writer_t *writer, plcrash_async_image_t *image, uint32_t index) {
+    size_t mask = writer->report_images.capacity - 1;
+    size_t slot;
+
+    for (slot = plcrash_writer_report_image_slot(writer, image); writer->report_images.slots[slot].image != NULL; slot = (slot + 1) & mask) {
+        if (writer->report_images.slots[slot].image == image)
+            return;
+    }
+
+    writer->report_images.slots[slot].image = image;
+    writer->report_images.slots[slot].index = index;
+    writer->report_images.count++;
+}
+
+/**
+ * @internal
+ *
+ * Look up the index at which the record of @a image was written to the crash report.
+ *
+ * @return Returns true if the image's record was written, or false if the image was not registered at the time the
+ * binary image records were written.
+ */
+static bool plcrash_writer_report_images_find (plcrash_log_writer_t *writer, plcrash_async_image_t *image, uint32_t *index) {
+    size_t mask = writer->report_images.capacity - 1;
+
+    if (writer->report_images.count == 0)
+        return false;
+
+    for (size_t slot = plcrash_writer_report_image_slot(writer, image); writer->report_images.slots[slot].image != NULL; slot = (slot + 1) & mask) {
+        if (writer->report_images.slots[slot].image == image) {
+            *index = writer->report_images.slots[slot].index;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @internal
+ *
+ * Maximum number of distinct binary images that may be referenced by a single image-relative backtrace. Frames
+ * in any additional images are written as absolute instruction pointers.
+ */
+#define MAX_BACKTRACE_IMAGES 32
+
+/**
+ * @internal
+ *
+ * A binary image referenced by an image-relative backtrace.
+ */
+typedef struct plcrash_writer_backtrace_image {
+    /** The image's index in the binary image list. */
+    uint32_t index;
+
+    /** The image's base address. */
+    uint64_t base;
+
+    /** The image's size. */
+    uint64_t size;
+
+    /** The previous frame in this image, or the image's base address. */
+    uint64_t last_pc;
+} plcrash_writer_backtrace_image_t;
+
+/**
+ * @internal
+ *
+ * Backtrace writer state.
+ *
+ * Frames are written as the elements of a packed repeated field, rather than as individual StackFrame
+ * messages; this avoids the per-frame field tag, message tag, and length prefix.
+ *
+ * If image-relative encoding is enabled, each frame is written as a pair of varints: the index of its binary
+ * image plus one (or 0 for an absolute instruction pointer), followed by the zigzag-encoded delta from the previous
+ * frame in the same image (or from the image's base address, for the first such frame).
+ */
+typedef struct plcrash_writer_backtrace {
+    /** The packed field state. */
+    plcrash_writer_message_t msg;
+
+    /** The packed field ID. */
+    uint32_t field_id;
+
+    /** The number of frames written. */
+    uint32_t frame_count;
+
+    /** If true, the packed field's header could not be written, and no further frames will be written. */
+    bool failed;
+
+    /** The binary image list, or NULL if image-relative encoding is disabled. The list must be marked for
+     * reading for the lifetime of the backtrace. */
+    plcrash_async_image_list_t *image_list;
+
+    /** The writer, holding the indices at which the binary image records were written. */
+    plcrash_log_writer_t *writer;
+
+    /** The number of images referenced by this backtrace. */
+    size_t image_count;
+
+    /** Images referenced by this backtrace. */
+    plcrash_writer_backtrace_image_t images[MAX_BACKTRACE_IMAGES];
+} plcrash_writer_backtrace_t;
+
+/**
+ * @internal
+ *
+ * Initialize a backtrace writer.
+ *
+ * @param bt The backtrace state to initialize.
+ * @param writer The log writer.
+ * @param pcs_field_id The field ID to be used for absolute packed frames.
+ * @param relative_field_id The field ID to be used for image-relative packed frames.
+ */
+static void plcrash_writer_backtrace_init (plcrash_writer_backtrace_t *bt, plcrash_log_writer_t *writer, uint32_t pcs_field_id,
+                                           uint32_t relative_field_id)
+{
+    bt->frame_count = 0;
+    bt->failed = false;
+    bt->image_count = 0;
+    bt->writer = writer;
+
+    if (writer->options & PLCRASH_LOG_WRITER_OPTION_IMAGE_RELATIVE_FRAMES) {
+        bt->field_id = relative_field_id;
+        bt->image_list = &writer->image_info.image_list;
+    } else {
+        bt->field_id = pcs_field_id;
+        bt->image_list = NULL;
+    }
+}
+
+/**
+ * @internal
+ *
+ * Find the backtrace image entry containing @a pc, adding it if necessary. Returns NULL if @a pc is not
+ * within an image whose record was written to the crash report, or the backtrace's image table is full.
+ *
+ * Images are referenced by the index at which their record was written, rather than by their current position in
+ * the image list; images may have been added or removed since the records were written.
+ */
+static plcrash_writer_backtrace_image_t *plcrash_writer_backtrace_image (plcrash_writer_backtrace_t *bt, uint64_t pc) {
+    /* Check the images already referenced by this backtrace; consecutive frames are frequently in the same image. */
+    for (size_t i = 0; i < bt->image_count; i++) {
+        if (pc >= bt->images[i].base && pc - bt->images[i].base < bt->images[i].size)
+            return &bt->images[i];
+    }
+
+    if (bt->image_count == MAX_BACKTRACE_IMAGES)
+        return NULL;
+
+    /* Search the image list's address index, and look up the index at which the image's record was written */
+    uint32_t index;
+    plcrash_async_image_t *image = plcrash_async_image_list_find(bt->image_list, (uintptr_t) pc, NULL);
+    if (image == NULL || !plcrash_writer_report_images_find(bt->writer, image, &index))
+        return NULL;
+
+    bt->images[bt->image_count].index = index;
+    bt->images[bt->image_count].base = image->header;
+    bt->images[bt->image_count].size = image->size;
+    bt->images[bt->image_count].last_pc = image->header;
+    return &bt->images[bt->image_count++];
+}
+
+/**
+ * @internal
+ *
+ * Append a frame to the backtrace, starting the backtrace's packed field on the first frame.
+ *
+ * @param file Output file
+ * @param bt The backtrace state.
+ * @param pcval The frame PC value.
+ */
+static size_t plcrash_writer_backtrace_append (plcrash_async_file_t *file, plcrash_writer_backtrace_t *bt, uint64_t pcval) {
+    size_t rv = 0;
+
+    if (bt->frame_count == 0) {
+        rv += plcrash_writer_pack_message_begin(file, bt->field_id, &bt->msg);
+        bt->frame_count++;
+
+        /* If the packed field's header could not be written, its frames must not be written */
+        if (rv == 0)
+            bt->failed = true;
+    } else {
+        bt->frame_count++;
+    }
+
+    if (bt->failed)
+        return 0;
+
+    /* Absolute encoding */
+    if (bt->image_list == NULL) {
+        rv += plcrash_writer_pack_packed_varint(file, pcval);
+        return rv;
+    }
+
+    /* Image-relative encoding */
+    plcrash_writer_backtrace_image_t *image = plcrash_writer_backtrace_image(bt, pcval);
+    if (image == NULL) {
+        rv += plcrash_writer_pack_packed_varint(file, 0);
+        rv += plcrash_writer_pack_packed_varint(file, pcval);
+        return rv;
+    }
+
+    int64_t delta = (int64_t) (pcval - image->last_pc);
+    image->last_pc = pcval;
+
+    rv += plcrash_writer_pack_packed_varint(file, (uint64_t) image->index + 1);
+    rv += plcrash_writer_pack_packed_varint(file, ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63));
+
+    return rv;
+}
+
+/**
+ * @internal
+ *
+ * Complete the backtrace's packed field, if any frames were written.
+ *
+ * @param file Output file
+ * @param bt The backtrace state.
+ */
+static void plcrash_writer_backtrace_finish (plcrash_async_file_t *file, plcrash_writer_backtrace_t *bt) {
+    if (bt->frame_count > 0 && !bt->failed)
+        plcrash_writer_pack_message_end(file, &bt->msg);
+}
+
+/**
+ * @internal
+ *
+ * Reset the backtrace interning table. Must be called prior to writing a crash report.
+ */
+static void plcrash_writer_stack_table_reset (plcrash_log_writer_t *writer) {
+    for (size_t i = 0; i < writer->stack_table.capacity; i++)
+        writer->stack_table.stacks[i].hash = 0;
+
+    writer->stack_table.count = 0;
+    writer->stack_table.pcs_count = 0;
+}
+
+/**
+ * @internal
+ *
+ * Look up a backtrace in the interning table, adding it if not found and space is available.
+ *
+ * @param writer The writer containing the interning table.
+ * @param thread_number The number of the thread for which the backtrace will be written if it is not found.
+ * @param pcs The backtrace's frames.
+ * @param frame_count The number of frames in @a pcs.
+ * @param interned_thread On return, if an identical backtrace has previously been written, the number of
+ * the thread for which it was written.
+ *
+ * @return Returns true if an identical backtrace has previously been written, or false if the backtrace must be
+ * written in full.
+ */
+static bool plcrash_writer_stack_table_intern (plcrash_log_writer_t *writer, uint32_t thread_number, const uint64_t *pcs,
+                                               uint32_t frame_count, uint32_t *interned_thread)
+{
+    size_t mask = writer->stack_table.capacity - 1;
+    uint64_t hash = 14695981039346656037ULL;
+    size_t slot;
+
+    if (writer->stack_table.stacks == NULL || frame_count == 0)
+        return false;
+
+    /* FNV-1a, over the frame PCs. 0 is reserved for unused slots. */
+    for (uint32_t i = 0; i < frame_count; i++) {
+        hash ^= pcs[i];
+        hash *= 1099511628211ULL;
+    }
+    if (hash == 0)
+        hash = 1;
+
+    /* Probe for a matching backtrace */
+    for (slot = hash & mask; writer->stack_table.stacks[slot].hash != 0; slot = (slot + 1) & mask) {
+        plcrash_log_writer_stack_t *stack = &writer->stack_table.stacks[slot];
+        if (stack->hash != hash || stack->frame_count != frame_count)
+            continue;
+
+        const uint64_t *interned_pcs = &writer->stack_table.pcs[stack->offset];
+        uint32_t i;
+        for (i = 0; i < frame_count && interned_pcs[i] == pcs[i]; i++);
+
+        if (i == frame_count) {
+            *interned_thread = stack->thread_number;
+            return true;
+        }
+    }
+
+    /* Not found; record the backtrace if space is available. One slot is always left free to terminate probing. */
+    if (writer->stack_table.count + 1 >= writer->stack_table.capacity ||
+        writer->stack_table.pcs_capacity - writer->stack_table.pcs_count < frame_count)
+    {
+        return false;
+    }
+
+    plcrash_log_writer_stack_t *stack = &writer->stack_table.stacks[slot];
+    stack->hash = hash;
+    stack->thread_number = thread_number;
+    stack->frame_count = frame_count;
+    stack->offset = writer->stack_table.pcs_count;
+    plcrash_async_memcpy(&writer->stack_table.pcs[stack->offset], pcs, frame_count * sizeof(uint64_t));
+
+    writer->stack_table.pcs_count += frame_count;
+    writer->stack_table.count++;
+
+    return false;
+}
+
+/**
+ * @internal
+ *
+ * Walk a thread's stack, recording the PC of each frame.
+ *
+ * @param thread The thread to be walked. Must be suspended, unless @a crashed_thread is true.
+ * @param crashed_thread If true, the stack will be walked using @a crashctx, rather than the thread's current state.
+ * @param crashctx Context to use for currently running thread (rather than fetching the thread
+ * context, which we've invalidated by running at all)
+ * @param pcs On return, the PCs of the thread's frames, starting with the innermost frame.
+ * @param max_frames The maximum number of frames to be written to @a pcs.
+ * @param regs If non-NULL, on return, the innermost frame's register values in plframe_regnum_t order. Must have
+ * space for PLCRASH_WRITER_REGISTER_COUNT values.
+ * @param reg_count If non-NULL, on return, the number of values written to @a regs, or 0 if the innermost frame
+ * could not be read.
+ *
+ * @return Returns the number of frames written to @a pcs.
+ */
+static uint32_t plcrash_writer_capture_backtrace (thread_t thread, bool crashed_thread, ucontext_t *crashctx, uint64_t *pcs,
+                                                  uint32_t max_frames, plframe_greg_t *regs, uint32_t *reg_count)
+{
+    plframe_cursor_t cursor;
+    plframe_error_t ferr;
+    uint32_t frame_count = 0;
+    bool fetch_regs = (regs != NULL);
+
+    if (reg_count != NULL)
+        *reg_count = 0;
+
+    /* Use the crashctx if we're running on the crashed thread */
+    if (crashed_thread) {
+        ferr = plframe_cursor_init(&cursor, crashctx);
+    } else {
+        ferr = plframe_cursor_thread_init(&cursor, thread);
+    }
+
+    /* Did cursor initialization succeed? If not, it is impossible to proceed */
+    if (ferr != PLFRAME_ESUCCESS) {
+        PLCF_DEBUG("An error occured initializing the frame cursor: %s", plframe_strerror(ferr));
+        return 0;
+    }
+
+    /* Walk the stack, limiting the total number of frames that are output. */
+    while ((ferr = plframe_cursor_next(&cursor)) == PLFRAME_ESUCCESS && frame_count < max_frames) {
+        /* Fetch the innermost frame's registers, reusing the cursor rather than initializing another */
+        if (fetch_regs) {
+            fetch_regs = false;
+
+            for (plframe_regnum_t i = 0; i < PLCRASH_WRITER_REGISTER_COUNT; i++) {
+                if ((ferr = plframe_get_reg(&cursor, i, &regs[i])) != PLFRAME_ESUCCESS) {
+                    // Should never happen
+                    PLCF_DEBUG("Could not fetch register %i value: %s", i, plframe_strerror(ferr));
+                    regs[i] = 0;
+                }
+            }
+
+            if (reg_count != NULL)
+                *reg_count = PLCRASH_WRITER_REGISTER_COUNT;
+        }
+
+        /* Fetch the PC value */
+        plframe_greg_t pc = 0;
+        if ((ferr = plframe_get_reg(&cursor, PLFRAME_REG_IP, &pc)) != PLFRAME_ESUCCESS) {
+            PLCF_DEBUG("Could not retrieve frame PC register: %s", plframe_strerror(ferr));
+            break;
+        }
+
+        pcs[frame_count++] = pc;
+    }
+
+    /* Did we reach the end successfully? */
+    if (ferr != PLFRAME_ENOFRAME) {
+        /* This is non-fatal, and in some circumstances -could- be caused by reaching the end of the stack if the
+         * final frame pointer is not NULL. */
+        PLCF_DEBUG("Terminated stack walking early: %s", plframe_strerror(ferr));
+    }
+
+    return frame_count;
+}
+
+/**
+ * @internal
+ *
+ * Return true if @a a and @a b identify the same thread. Mach thread ports are compared by their name index.
+ */
+static inline bool plcrash_writer_thread_equal (thread_t a, thread_t b) {
+#if defined(__APPLE__)
+    return MACH_PORT_INDEX(a) == MACH_PORT_INDEX(b);
+#elif defined(__linux__)
+    return a == b;
+#endif
+}
+
+/**
+ * @internal
+ *
+ * Suspend @a thread. On Linux, the thread is suspended via PLCrashAsyncThread.
+ *
+ * @return Returns true if the thread was suspended.
+ */
+static inline bool plcrash_writer_thread_suspend (thread_t thread) {
+#if defined(__APPLE__)
+    return thread_suspend(thread) == KERN_SUCCESS;
+#elif defined(__linux__)
+    return plcrash_async_thread_suspend(thread) == PLCRASH_ESUCCESS;
+#endif
+}
+
+/**
+ * @internal
+ *
+ * Resume a thread suspended via plcrash_writer_thread_suspend().
+ */
+static inline void plcrash_writer_thread_resume (thread_t thread) {
+#if defined(__APPLE__)
+    thread_resume(thread);
+#elif defined(__linux__)
+    plcrash_async_thread_resume(thread);
+#endif
+}
+
+/**
+ * @internal
+ *
+ * Fetch the list of the task's threads, which must be released via plcrash_writer_thread_list_free().
+ *
+ * On Linux, the threads are listed from /proc/self/task into the writer's pre-allocated thread list, and any threads
+ * beyond its capacity are omitted. The current thread is always listed, replacing the final entry if necessary.
+ *
+ * @param writer The writer containing the pre-allocated thread list.
+ * @param threads On success, the task's threads.
+ * @param thread_count On success, the number of threads in @a threads.
+ * @param self_thr On return, the current thread.
+ *
+ * @return Returns true on success, or false if the thread list could not be fetched.
+ */
+static bool plcrash_writer_thread_list (plcrash_log_writer_t *writer, thread_t **threads, uint32_t *thread_count, thread_t *self_thr) {
+#if defined(__APPLE__)
+    thread_act_array_t list;
+    mach_msg_type_number_t count;
+
+    *self_thr = mach_thread_self();
+    if (task_threads(mach_task_self(), &list, &count) != KERN_SUCCESS)
+        return false;
+
+    *threads = list;
+    *thread_count = count;
+    return true;
+#elif defined(__linux__)
+    thread_t *list = writer->frame_arena.thread_list;
+    size_t capacity = writer->frame_arena.thread_capacity;
+    size_t count;
+    size_t i;
+
+    *self_thr = plcrash_async_thread_self();
+    if (plcrash_async_thread_list(list, capacity, &count) != PLCRASH_ESUCCESS)
+        return false;
+
+    for (i = 0; i < count && list[i] != *self_thr; i++);
+    if (i == count) {
+        if (count == capacity)
+            count--;
+        list[count++] = *self_thr;
+    }
+
+    *threads = list;
+    *thread_count = (uint32_t) count;
+    return true;
+#endif
+}
+
+/**
+ * @internal
+ *
+ * Release a thread list fetched via plcrash_writer_thread_list().
+ */
+static void plcrash_writer_thread_list_free (thread_t *threads, uint32_t thread_count) {
+#if defined(__APPLE__)
+    for (uint32_t i = 0; i < thread_count; i++)
+        mach_port_deallocate(mach_task_self(), threads[i]);
+    vm_deallocate(mach_task_self(), (vm_address_t)threads, sizeof(thread_t) * thread_count);
+#endif
+}
+
+/**
+ * @internal
+ *
+ * Suspend all threads other than the current thread, capture their backtraces to the frame arena, and then resume
+ * them. This provides a consistent snapshot of all threads, and ensures that no thread remains suspended while the
+ * crash report is encoded.
+ *
+ * Threads beyond the writer's snapshot capacity are not captured. Backtraces that do not fit within the remaining
+ * space in the frame arena are truncated to their innermost frames.
+ *
+ * @param writer The writer containing the frame arena.
+ * @param threads The threads to be captured.
+ * @param thread_count The number of threads in @a threads.
+ * @param self_thr The current thread, which will not be suspended or captured.
+ */
+static void plcrash_writer_snapshot_threads (plcrash_log_writer_t *writer, thread_t *threads, uint32_t thread_count,
+                                             thread_t self_thr)
+{
+    plcrash_log_writer_thread_snapshot_t *snapshots = writer->frame_arena.threads;
+    size_t snapshot_count = MIN(thread_count, writer->frame_arena.thread_capacity);
+    size_t offset = MAX_THREAD_FRAMES;
+
+    /* Suspend all threads */
+    for (size_t i = 0; i < snapshot_count; i++) {
+        snapshots[i].suspended = false;
+        snapshots[i].captured = false;
+        snapshots[i].frame_count = 0;
+
+        if (plcrash_writer_thread_equal(self_thr, threads[i]))
+            continue;
+
+        if (!plcrash_writer_thread_suspend(threads[i])) {
+            PLCF_DEBUG("Could not suspend thread %zu", i);
+            continue;
+        }
+
+        snapshots[i].suspended = true;
+    }
+
+    /* Walk each stack into the frame arena */
+    for (size_t i = 0; i < snapshot_count; i++) {
+        size_t available = MIN(writer->frame_arena.capacity - offset, MAX_THREAD_FRAMES);
+        uint32_t frame_count;
+
+        if (!snapshots[i].suspended || available == 0)
+            continue;
+
+        frame_count = plcrash_writer_capture_backtrace(threads[i], false, NULL, writer->frame_arena.pcs + offset, available,
+                                                       NULL, NULL);
+
+        snapshots[i].captured = true;
+        snapshots[i].offset = offset;
+        snapshots[i].frame_count = frame_count;
+        offset += frame_count;
+    }
+
+    /* Resume all threads */
+    for (size_t i = 0; i < snapshot_count; i++) {
+        if (snapshots[i].suspended)
+            plcrash_writer_thread_resume(threads[i]);
+    }
+}
+
+/**
+ * @internal
+ *
+ * The state of the task's threads, as captured by plcrash_writer_capture_threads(). The threads are captured once;
+ * the report may then be encoded more than once from the same capture.
+ */
+typedef struct plcrash_writer_capture {
+    /** The number of threads in the task. Threads are numbered by their position in the task's thread list. */
+    uint32_t thread_count;
+
+    /** The number of the crashed thread, or UINT32_MAX if it was not found in the thread list. */
+    uint32_t crashed_thread;
+
+    /** The number of frames in the crashed thread's backtrace, which is held at the start of the frame arena. */
+    uint32_t crashed_frame_count;
+
+    /** The crashed thread's register values. */
+    plframe_greg_t crashed_regs[PLCRASH_WRITER_REGISTER_COUNT];
+
+    /** The number of values in crashed_regs. */
+    uint32_t crashed_reg_count;
+} plcrash_writer_capture_t;
+
+static plcrash_error_t plcrash_writer_write_report (plcrash_log_writer_t *writer, plcrash_async_file_t *file, siginfo_t *siginfo,
+                                                    const plcrash_writer_capture_t *capture);
+
+/**
+ * @internal
+ *
+ * Capture the backtraces of all threads to the frame arena. All threads other than the current thread are suspended,
+ * captured, and resumed via plcrash_writer_snapshot_threads(); the current thread's backtrace and registers are
+ * captured using @a crashctx.
+ *
+ * @param writer The writer containing the frame arena.
+ * @param crashctx Context of the crashed thread.
+ * @param capture On return, the captured thread state.
+ */
+static void plcrash_writer_capture_threads (plcrash_log_writer_t *writer, ucontext_t *crashctx, plcrash_writer_capture_t *capture) {
+    thread_t *threads;
+    uint32_t thread_count;
+    thread_t self_thr;
+
+    capture->thread_count = 0;
+    capture->crashed_thread = UINT32_MAX;
+    capture->crashed_frame_count = 0;
+    capture->crashed_reg_count = 0;
+
+    /* Get a list of all threads */
+    if (!plcrash_writer_thread_list(writer, &threads, &thread_count, &self_thr)) {
+        PLCF_DEBUG("Fetching thread list failed");
+        return;
+    }
+
+    capture->thread_count = thread_count;
+    for (uint32_t i = 0; i < thread_count; i++) {
+        if (plcrash_writer_thread_equal(self_thr, threads[i]))
+            capture->crashed_thread = i;
+    }
+
+    /* Snapshot all other threads */
+    plcrash_writer_snapshot_threads(writer, threads, thread_count, self_thr);
+
+    /* Capture the crashed thread */
+    capture->crashed_frame_count = plcrash_writer_capture_backtrace(self_thr, true, crashctx, writer->frame_arena.pcs, MAX_THREAD_FRAMES,
+                                                                    capture->crashed_regs, &capture->crashed_reg_count);
+
+    /* Clean up the thread array */
+    plcrash_writer_thread_list_free(threads, thread_count);
+}
+
+/**
+ * @internal
+ *
+ * Compute the number of leading frames of a backtrace that may be written within @a max_bytes.
+ *
+ * @param writer Writer containing the encoding options and binary image list.
+ * @param pcs The backtrace's frames.
+ * @param frame_count The number of frames in @a pcs.
+ * @param max_bytes The maximum encoded size of the backtrace.
+ * @param size On return, the encoded size of the returned number of frames.
+ */
+static uint32_t plcrash_writer_backtrace_fit (plcrash_log_writer_t *writer, const uint64_t *pcs, uint32_t frame_count,
+                                              size_t max_bytes, size_t *size)
+{
+    plcrash_writer_backtrace_t bt;
+    size_t rv = 0;
+    uint32_t i;
+
+    plcrash_writer_backtrace_init(&bt, writer, PLCRASH_PROTO_THREAD_PCS_ID, PLCRASH_PROTO_THREAD_IMAGE_RELATIVE_PCS_ID);
+    for (i = 0; i < frame_count; i++) {
+        size_t frame_size = plcrash_writer_backtrace_append(NULL, &bt, pcs[i]);
+        if (rv + frame_size > max_bytes)
+            break;
+
+        rv += frame_size;
+    }
+
+    *size = rv;
+    return i;
+}
+
+/**
+ * @internal
+ *
+ * Write a thread message
+ *
+ * @param file Output file. May be NULL, in which case the encoded size of the thread's fixed fields and registers
+ * (excluding the backtrace) is returned.
+ * @param writer Writer containing the encoding options and binary image list.
+ * @param thread_number The thread's number.
+ * @param crashed_thread True if this is the crashed thread.
+ * @param pcs The thread's backtrace, as captured by plcrash_writer_capture_backtrace().
+ * @param frame_count The number of frames in @a pcs to be written.
+ * @param regs The crashed thread's register values, as captured by plcrash_writer_capture_backtrace().
+ * @param reg_count The number of values in @a regs.
+ */
+static size_t plcrash_writer_write_thread (plcrash_async_file_t *file, plcrash_log_writer_t *writer, uint32_t thread_number,
+                                           bool crashed_thread, const uint64_t *pcs, uint32_t frame_count,
+                                           const plframe_greg_t *regs, uint32_t reg_count)
+{
+    size_t rv = 0;
+
+    /* Write the thread ID */
+    rv += plcrash_writer_pack_uint32(file, PLCRASH_PROTO_THREAD_THREAD_NUMBER_ID, thread_number);
+
+    /* Note crashed status */
+    rv += plcrash_writer_pack_bool(file, PLCRASH_PROTO_THREAD_CRASHED_ID, crashed_thread);
+
+    /* Write out the stack frames. Reference an identical, previously written backtrace if possible. */
+    if (file != NULL) {
+        uint32_t interned_thread;
+        if (plcrash_writer_stack_table_intern(writer, thread_number, pcs, frame_count, &interned_thread)) {
+            rv += plcrash_writer_pack_uint32(file, PLCRASH_PROTO_THREAD_INTERNED_STACK_ID, interned_thread);
+        } else {
+            plcrash_writer_backtrace_t bt;
+            plcrash_writer_backtrace_init(&bt, writer, PLCRASH_PROTO_THREAD_PCS_ID, PLCRASH_PROTO_THREAD_IMAGE_RELATIVE_PCS_ID);
+            for (uint32_t i = 0; i < frame_count; i++)
+                rv += plcrash_writer_backtrace_append(file, &bt, pcs[i]);
+            plcrash_writer_backtrace_finish(file, &bt);
+        }
+    }
+
+    /* Dump registers for the crashed thread */
+    if (crashed_thread) {
+        rv += plcrash_writer_write_thread_registers(file, regs, reg_count);
+    }
+
+    return rv;
+}
+
+/**
+ * @internal
+ *
+ * Write a thread message, truncating its backtrace to the innermost frames that fit within @a budget bytes.
+ *
+ * @param file Output file.
+ * @param writer Writer containing the encoding options and binary image list.
+ * @param thread_number The thread's number.
+ * @param crashed_thread True if this is the crashed thread.
+ * @param pcs The thread's backtrace, as captured by plcrash_writer_capture_backtrace().
+ * @param frame_count The number of frames in @a pcs.
+ * @param regs The crashed thread's register values.
+ * @param reg_count The number of values in @a regs.
+ * @param budget The maximum number of bytes to be written, including the message header.
+ *
+ * @return Returns the number of bytes written, or 0 if the thread's required fields do not fit within @a budget.
+ */
+static size_t plcrash_writer_write_thread_message (plcrash_async_file_t *file, plcrash_log_writer_t *writer, uint32_t thread_number,
+                                                   bool crashed_thread, const uint64_t *pcs, uint32_t frame_count,
+                                                   const plframe_greg_t *regs, uint32_t reg_count, size_t budget)
+{
+    plcrash_writer_message_t msg;
+    size_t fixed;
+    size_t bt_size;
+
+    /* Size the message header and the fixed fields */
+    fixed = plcrash_writer_pack_message_begin(NULL, PLCRASH_PROTO_THREADS_ID, &msg);
+    fixed += plcrash_writer_write_thread(NULL, writer, thread_number, crashed_thread, pcs, frame_count, regs, reg_count);
+    if (fixed > budget) {
+        PLCF_DEBUG("Omitting thread %" PRIu32 "; report size limit reached", thread_number);
+        return 0;
+    }
+
+    /* Truncate the backtrace to fit */
+    uint32_t written_frames = plcrash_writer_backtrace_fit(writer, pcs, frame_count, budget - fixed, &bt_size);
+    if (written_frames < frame_count)
+        PLCF_DEBUG("Truncated thread %" PRIu32 " to %" PRIu32 " frames; report size limit reached", thread_number, written_frames);
+
+    /* Write message */
+    if (plcrash_writer_pack_message_begin(file, PLCRASH_PROTO_THREADS_ID, &msg) == 0)
+        return 0;
+
+    plcrash_writer_write_thread(file, writer, thread_number, crashed_thread, pcs, written_frames, regs, reg_count);
+    plcrash_writer_pack_message_end(file, &msg);
+
+    return fixed + bt_size;
+}
+
+/**
+ * @internal
+ *
+ * Compute the space required to write the crashed thread's message in full.
+ *
+ * @param writer Writer containing the encoding options and binary image list.
+ * @param capture The captured thread state.
+ *
+ * @return Returns the encoded size of the crashed thread's message, or 0 if the crashed thread was not captured.
+ */
+static size_t plcrash_writer_crashed_thread_size (plcrash_log_writer_t *writer, const plcrash_writer_capture_t *capture) {
+    plcrash_writer_message_t msg;
+    size_t rv = 0;
+    size_t bt_size;
+
+    if (capture->crashed_thread == UINT32_MAX)
+        return 0;
+
+    plcrash_writer_backtrace_fit(writer, writer->frame_arena.pcs, capture->crashed_frame_count, SIZE_MAX, &bt_size);
+
+    rv += plcrash_writer_pack_message_begin(NULL, PLCRASH_PROTO_THREADS_ID, &msg);
+    rv += plcrash_writer_write_thread(NULL, writer, capture->crashed_thread, true, writer->frame_arena.pcs,
+                                      capture->crashed_frame_count, capture->crashed_regs, capture->crashed_reg_count);
+    rv += bt_size;
+
+    return rv;
+}
+
+#ifdef __APPLE__
+
+/**
+ * @internal
+ *
+ * Parse the Mach-O load commands of the image at @a header.
+ *
+ * @param header Mach-O image header.
+ * @param info On success, will be populated with the image's data.
+ *
+ * @return Returns true on success, or false if the header is not a valid Mach-O header.
+ */
+static bool plcrash_writer_parse_binary_image (const void *header, plcrash_writer_image_info_t *info) {
+    uint32_t ncmds;
+    const struct mach_header *header32 = (const struct mach_header *) header;
+    const struct mach_header_64 *header64 = (const struct mach_header_64 *) header;
+
+    struct load_command *cmd;
+
+    memset(info, 0, sizeof(*info));
+
+    /* Check for 32-bit/64-bit header and extract required values */
+    switch (header32->magic) {
+        /* 32-bit */
+        case MH_MAGIC:
+        case MH_CIGAM:
+            ncmds = header32->ncmds;
+            info->cpu_type = header32->cputype;
+            info->cpu_subtype = header32->cpusubtype;
+            cmd = (struct load_command *) (header32 + 1);
+            break;
+
+        /* 64-bit */
+        case MH_MAGIC_64:
+        case MH_CIGAM_64:
+            ncmds = header64->ncmds;
+            info->cpu_type = header64->cputype;
+            info->cpu_subtype = header64->cpusubtype;
+            cmd = (struct load_command *) (header64 + 1);
+            break;
+
+        default:
+            PLCF_DEBUG("Invalid Mach-O header magic value: %x", header32->magic);
+            return false;
+    }
+
+    /* Compute the image size and search for a UUID */
+    for (uint32_t i = 0; cmd != NULL && i < ncmds; i++) {
+        /* 32-bit text segment */
+        if (cmd->cmd == LC_SEGMENT) {
+            struct segment_command *segment = (struct segment_command *) cmd;
+            if (strcmp(segment->segname, SEG_TEXT) == 0) {
+                info->size = segment->vmsize;
+            }
+        }
+        /* 64-bit text segment */
+        else if (cmd->cmd == LC_SEGMENT_64) {
+            struct segment_command_64 *segment = (struct segment_command_64 *) cmd;
+
+            if (strcmp(segment->segname, SEG_TEXT) == 0) {
+                info->size = segment->vmsize;
+            }
+        }
+        /* DWARF dSYM UUID */
+        else if (cmd->cmd == LC_UUID && cmd->cmdsize == sizeof(struct uuid_command)) {
+            struct uuid_command *uuid = (struct uuid_command *) cmd;
+
+            info->has_uuid = true;
+            plcrash_async_memcpy(info->uuid, uuid->uuid, sizeof(info->uuid));
+        }
+
+        cmd = (struct load_command *) ((uint8_t *) cmd + cmd->cmdsize);
+    }
+
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Write a binary image frame
+ *
+ * @param file Output file
+ * @param name binary image path (or name).
+ * @param header Mach-O image base.
+ * @param info The image data, as returned by plcrash_writer_parse_binary_image().
+ */
+static size_t plcrash_writer_write_binary_image (plcrash_async_file_t *file, const char *name, const void *header,
+                                                 const plcrash_writer_image_info_t *info)
+{
+    size_t rv = 0;
+    uint64_t mach_size = info->size;
+
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_BINARY_IMAGE_SIZE_ID, PLPROTOBUF_C_TYPE_UINT64, &mach_size);
+    
+    /* Base address */
+    {
+        uintptr_t base_addr;
+        uint64_t u64;
+
+        base_addr = (uintptr_t) header;
+        u64 = base_addr;
+        rv += plcrash_writer_pack(file, PLCRASH_PROTO_BINARY_IMAGE_ADDR_ID, PLPROTOBUF_C_TYPE_UINT64, &u64);
+    }
+
+    /* Name */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_BINARY_IMAGE_NAME_ID, PLPROTOBUF_C_TYPE_STRING, name);
+
+    /* UUID */
+    if (info->has_uuid) {
+        PLProtobufCBinaryData binary;
+    
+        /* Write the 128-bit UUID */
+        binary.len = sizeof(info->uuid);
+        binary.data = (void *) info->uuid;
+        rv += plcrash_writer_pack(file, PLCRASH_PROTO_BINARY_IMAGE_UUID_ID, PLPROTOBUF_C_TYPE_BYTES, &binary);
+    }
+    
+    /* Get the processor message size */
+    uint32_t msgsize = plcrash_writer_write_processor_info(NULL, PLCRASH_PROTO_PROCESSOR_ENCODING_MACH, info->cpu_type, info->cpu_subtype);
+
+    /* Write the header and message */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_BINARY_IMAGE_CODE_TYPE_ID, PLPROTOBUF_C_TYPE_MESSAGE, &msgsize);
+    rv += plcrash_writer_write_processor_info(file, PLCRASH_PROTO_PROCESSOR_ENCODING_MACH, info->cpu_type, info->cpu_subtype);
+
+    return rv;
+}
+
+/**
+ * @internal
+ *
+ * Write a complete CrashReport.images record, including the field tag and length prefix.
+ *
+ * @param file Output file
+ * @param name binary image path (or name).
+ * @param header Mach-O image base.
+ * @param info The image data, as returned by plcrash_writer_parse_binary_image().
+ */
+static size_t plcrash_writer_write_binary_image_record (plcrash_async_file_t *file, const char *name, const void *header,
+                                                        const plcrash_writer_image_info_t *info)
+{
+    size_t rv = 0;
+    uint32_t size;
+
+    size = plcrash_writer_write_binary_image(NULL, name, header, info);
+    rv += plcrash_writer_pack(NULL, PLCRASH_PROTO_BINARY_IMAGES_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+
+    /* The record's fields must not be written without its header; omit the record if it will not fit */
+    if (file != NULL && plcrash_async_file_remaining(file) < rv + size)
+        return 0;
+
+    plcrash_writer_pack(file, PLCRASH_PROTO_BINARY_IMAGES_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+    rv += plcrash_writer_write_binary_image(file, name, header, info);
+
+    return rv;
+}
+
+#endif /* __APPLE__ */
+
+/**
+ * @internal
+ *
+ * Write the record of the binary image containing @a pc, if it has not already been written and fits within the
+ * output limit less @a reserve bytes. The index at which the record is written is recorded in the writer's written
+ * image table.
+ *
+ * @param file Output file
+ * @param writer Writer containing the binary image list and the written image table.
+ * @param pc An instruction pointer referenced by a captured backtrace.
+ * @param reserve The number of bytes that must remain available once the record has been written.
+ */
+static void plcrash_writer_write_referenced_image (plcrash_async_file_t *file, plcrash_log_writer_t *writer, uint64_t pc,
+                                                   size_t reserve)
+{
+#ifdef __APPLE__
+    plcrash_writer_image_info_t info;
+#endif
+    plcrash_async_image_t *image;
+    uint32_t index;
+    size_t size;
+
+    /* Skip frames outside of any known image, and images that have already been written */
+    image = plcrash_async_image_list_find(&writer->image_info.image_list, (uintptr_t) pc, NULL);
+    if (image == NULL || plcrash_writer_report_images_find(writer, image, &index))
+        return;
+
+    /* One slot is always left free to terminate probing */
+    if (writer->report_images.count + 1 >= writer->report_images.capacity)
+        return;
+
+    if (image->record != NULL) {
+        size = image->record_len;
+    } else {
+#ifdef __APPLE__
+        /* The record could not be allocated at registration time; fall back to parsing the image header. */
+        // TODO - switch to plframe_read_addr()
+        if (!plcrash_writer_parse_binary_image((const void *) image->header, &info))
+            return;
+        size = plcrash_writer_write_binary_image_record(NULL, image->name, (const void *) image->header, &info);
+#else
+        /* ELF images are not parsed at crash time; an image whose record could not be allocated is not written. */
+        return;
+#endif
+    }
+
+    if (plcrash_async_file_remaining(file) < size + reserve)
+        return;
+
+    if (image->record != NULL) {
+        if (!plcrash_async_file_write_ref(file, image->record, image->record_len))
+            return;
+    } else {
+#ifdef __APPLE__
+        if (plcrash_writer_write_binary_image_record(file, image->name, (const void *) image->header, &info) == 0)
+            return;
+#endif
+    }
+
+    plcrash_writer_report_images_add(writer, image, (uint32_t) writer->report_images.count);
+}
+
+/**
+ * @internal
+ *
+ * Write the crash Exception message
+ *
+ * @param file Output file
+ * @param writer Writer containing exception data
+ */
+static size_t plcrash_writer_write_exception (plcrash_async_file_t *file, plcrash_log_writer_t *writer) {
+    size_t rv = 0;
+
+    /* Write the name and reason */
+    assert(writer->uncaught_exception.has_exception);
+    rv += plcrash_writer_pack_string(file, PLCRASH_PROTO_EXCEPTION_NAME_ID, writer->uncaught_exception.name);
+    rv += plcrash_writer_pack_string(file, PLCRASH_PROTO_EXCEPTION_REASON_ID, writer->uncaught_exception.reason);
+    
+    /* Write the stack frames, if any */
+    plcrash_writer_backtrace_t bt;
+    plcrash_writer_backtrace_init(&bt, writer, PLCRASH_PROTO_EXCEPTION_PCS_ID, PLCRASH_PROTO_EXCEPTION_IMAGE_RELATIVE_PCS_ID);
+    for (size_t i = 0; i < writer->uncaught_exception.callstack_count && bt.frame_count < MAX_THREAD_FRAMES; i++) {
+        uint64_t pc = (uint64_t)(uintptr_t) writer->uncaught_exception.callstack[i];
+        rv += plcrash_writer_backtrace_append(file, &bt, pc);
+    }
+
+    plcrash_writer_backtrace_finish(file, &bt);
+
+    return rv;
+}
+
+/**
+ * @internal
+ *
+ * Write the crash signal message
+ *
+ * @param file Output file
+ * @param siginfo The signal information
+ */
+static size_t plcrash_writer_write_signal (plcrash_async_file_t *file, siginfo_t *siginfo) {
+    size_t rv = 0;
+    
+    /* Fetch the signal name */
+    char name_buf[10];
+    const char *name;
+    if ((name = plcrash_async_signal_signame(siginfo->si_signo)) == NULL) {
+        PLCF_DEBUG("Warning -- unhandled signal number (signo=%d). This is a bug.", siginfo->si_signo);
+        snprintf(name_buf, sizeof(name_buf), "#%d", siginfo->si_signo);
+        name = name_buf;
+    }
+
+    /* Fetch the signal code string */
+    char code_buf[10];
+    const char *code;
+    if ((code = plcrash_async_signal_sigcode(siginfo->si_signo, siginfo->si_code)) == NULL) {
+        PLCF_DEBUG("Warning -- unhandled signal sicode (signo=%d, code=%d). This is a bug.", siginfo->si_signo, siginfo->si_code);
+        snprintf(code_buf, sizeof(code_buf), "#%d", siginfo->si_code);
+        code = code_buf;
+    }
+    
+    /* Address value */
+    uint64_t addr = (uintptr_t) siginfo->si_addr;
+
+    /* Write it out */
+    rv += plcrash_writer_pack_string(file, PLCRASH_PROTO_SIGNAL_NAME_ID, name);
+    rv += plcrash_writer_pack_string(file, PLCRASH_PROTO_SIGNAL_CODE_ID, code);
+    rv += plcrash_writer_pack_uint64(file, PLCRASH_PROTO_SIGNAL_ADDRESS_ID, addr);
+
+    return rv;
+}
+
+/**
+ * @internal
+ *
+ * Write the crash log file header.
+ *
+ * @param file Output file.
+ * @param version The file format version.
+ */
+static void plcrash_writer_write_file_header (plcrash_async_file_t *file, uint8_t version) {
+    /* Write the magic string (with no trailing NULL) and the version number */
+    plcrash_async_file_write(file, PLCRASH_REPORT_FILE_MAGIC, strlen(PLCRASH_REPORT_FILE_MAGIC));
+    plcrash_async_file_write(file, &version, sizeof(version));
+}
+
+/**
+ * @internal
+ *
+ * Write a compressed crash report. The report is written to the writer's pre-allocated compression buffer, and
+ * then compressed to @a file.
+ *
+ * The report is first written using the full compression buffer. If the compressed result exceeds @a file's output
+ * limit, the report is written again, with its size budgeted against the output limit scaled by the observed
+ * compression ratio. The compressed report is only written if it fits within the output limit in full; a truncated
+ * compressed stream can not be decoded. Otherwise, nothing is written, and PLCRASH_OUTPUT_ERR is returned.
+ *
+ * Each attempt only re-encodes the report from @a capture; the threads are not captured again.
+ *
+ * @param writer The writer context. The compression buffers must be available.
+ * @param file The output file.
+ * @param siginfo Signal information
+ * @param capture The captured thread state.
+ */
+static plcrash_error_t plcrash_writer_write_compressed (plcrash_log_writer_t *writer, plcrash_async_file_t *file, siginfo_t *siginfo,
+                                                       const plcrash_writer_capture_t *capture)
+{
+    plcrash_async_file_t report;
+    plcrash_error_t err;
+    uint8_t length[4];
+    size_t report_len;
+    size_t compressed_len;
+    size_t budget = writer->compression.size;
+    size_t available = plcrash_async_file_remaining(file);
+
+    /* Space available to the compressed report, following the header and uncompressed length */
+    if (available < sizeof(struct PLCrashReportFileHeader) + sizeof(length))
+        return PLCRASH_OUTPUT_ERR;
+    available -= sizeof(struct PLCrashReportFileHeader) + sizeof(length);
+
+    for (int attempt = 0; ; attempt++) {
+        /* Write the uncompressed report */
+        plcrash_async_file_init_mem(&report, writer->compression.buffer, budget);
+        if ((err = plcrash_writer_write_report(writer, &report, siginfo, capture)) != PLCRASH_ESUCCESS)
+            return err;
+
+        report_len = plcrash_async_file_offset(&report);
+        compressed_len = plcrash_async_lz_compressed_size(writer->compression.state, writer->compression.buffer, report_len);
+        if (compressed_len <= available)
+            break;
+
+        if (attempt == 1) {
+            PLCF_DEBUG("Compressed report (%zu bytes) exceeds the output limit", compressed_len);
+            return PLCRASH_OUTPUT_ERR;
+        }
+
+        /* Budget the report against the output limit at the observed compression ratio. A margin is left, as a
+         * truncated report may compress less well. */
+        budget = (size_t) ((uint64_t) report_len * available / compressed_len) / 8 * 7;
+    }
+
+    /* Header, followed by the little-endian uncompressed length */
+    length[0] = report_len & 0xFF;
+    length[1] = (report_len >> 8) & 0xFF;
+    length[2] = (report_len >> 16) & 0xFF;
+    length[3] = (report_len >> 24) & 0xFF;
+
+    plcrash_writer_write_file_header(file, PLCRASH_REPORT_FILE_VERSION_COMPRESSED);
+    plcrash_async_file_write(file, length, sizeof(length));
+
+    /* Compressed report. The compression buffer remains valid until the file is flushed. */
+    return plcrash_async_lz_compress(writer->compression.state, file, writer->compression.buffer, report_len);
+}
+
+/**
+ * Write the crash report. All other running threads are suspended while their backtraces are captured, and are
+ * resumed before the crash report is encoded.
+ *
+ * The threads are captured once, prior to encoding. The report is then written in a single pass; the length prefixes
+ * of nested messages are reserved as fixed-width varints and back-patched once each message has been written.
+ *
+ * If compression is enabled via PLCRASH_LOG_WRITER_OPTION_COMPRESS, the report is first written to a
+ * pre-allocated buffer, and is then written to @a file in the #PLCRASH_REPORT_FILE_VERSION_COMPRESSED format. If
+ * the compressed report would exceed @a file's output limit, the report is written uncompressed instead. In either
+ * case, the report is only re-encoded from the original capture.
+ *
+ * @param writer The writer context
+ * @param file The output file.
+ * @param siginfo Signal information
+ * @param crashctx Context of the crashed thread.
+ *
+ * @warning This method must only be called from the thread that has triggered the crash. This must correspond
+ * to the provided crashctx. Failure to adhere to this requirement will result in an invalid stack trace
+ * and thread dump.
+ */
+plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_async_file_t *file, siginfo_t *siginfo, ucontext_t *crashctx) {
+    plcrash_writer_capture_t capture;
+    plcrash_error_t err;
+
+    /* Mark the image list for reading. Image list entries are not reused while the list is marked, ensuring that the
+     * entries recorded in the written image table remain valid until the report has been written. */
+    plcrash_async_image_list_set_reading(&writer->image_info.image_list, true);
+
+    /* Capture all threads */
+    plcrash_writer_capture_threads(writer, crashctx, &capture);
+
+    /* If the compressed report does not fit within the output limit, fall back to the uncompressed format, which
+     * is budgeted against the output limit directly. */
+    if ((writer->options & PLCRASH_LOG_WRITER_OPTION_COMPRESS) && writer->compression.buffer != NULL) {
+        off_t start = plcrash_async_file_offset(file);
+
+        if ((err = plcrash_writer_write_compressed(writer, file, siginfo, &capture)) == PLCRASH_ESUCCESS)
+            goto cleanup;
+
+        if (plcrash_async_file_offset(file) != start) {
+            PLCF_DEBUG("Failed to write the compressed crash report");
+            err = PLCRASH_OUTPUT_ERR;
+            goto cleanup;
+        }
+    }
+
+    plcrash_writer_write_file_header(file, PLCRASH_REPORT_FILE_VERSION);
+    err = plcrash_writer_write_report(writer, file, siginfo, &capture);
+
+cleanup:
+    /* Image records are queued by reference; they must be written before the list may release them. */
+    plcrash_async_file_flush(file);
+    plcrash_async_image_list_set_reading(&writer->image_info.image_list, false);
+
+    return err;
+}
+
+/**
+ * @internal
+ *
+ * Write the crash report's message data, following the file header.
+ *
+ * @param writer The writer context
+ * @param file The output file.
+ * @param siginfo Signal information
+ * @param capture The captured thread state.
+ */
+static plcrash_error_t plcrash_writer_write_report (plcrash_log_writer_t *writer, plcrash_async_file_t *file, siginfo_t *siginfo,
+                                                    const plcrash_writer_capture_t *capture)
+{
+    /* Machine, app, process, and system info. These are pre-encoded at initialization time when possible. */
+    if (writer->static_sections.data != NULL) {
+        plcrash_async_file_write_ref(file, writer->static_sections.data, writer->static_sections.length);
+    } else {
+        plcrash_writer_write_static_sections(file, writer);
+    }
+
+    /* System info timestamp. This is the final field of the system info message written above. */
+    {
+        time_t timestamp;
+
+        /* Fetch the timestamp */
+        if (time(&timestamp) == (time_t)-1) {
+            PLCF_DEBUG("Failed to fetch timestamp: %s", strerror(errno));
+            timestamp = 0;
+        }
+
+        plcrash_writer_pack_padded_varint(file, PLCRASH_PROTO_SYSTEM_INFO_TIMESTAMP_ID, (uint64_t) (int64_t) timestamp);
+    }
+
+    /* The signal and exception are written prior to the threads, ensuring that they are not lost if the report size
+     * limit is reached. The binary images are written between them, as the exception's frames may reference them. */
+
+    /* Signal */
+    {
+        plcrash_writer_message_t msg;
+
+        if (plcrash_writer_pack_message_begin(file, PLCRASH_PROTO_SIGNAL_ID, &msg) > 0) {
+            plcrash_writer_write_signal(file, siginfo);
+            plcrash_writer_pack_message_end(file, &msg);
+        }
+    }
+
+    /* Binary Images. The records are pre-encoded as images are registered.
+     *
+     * Only the images containing captured frames are written: first those referenced by the crashed thread, then
+     * those referenced by the exception, and then those referenced by the other threads. The crashed thread's and the
+     * exception's space is reserved first, with their frames sized as absolute instruction pointers.
+     *
+     * Images may be added or removed by other threads while the report is written. The index at which each record is
+     * written is recorded, and image-relative frames only reference the recorded images; frames in any other image are
+     * written as absolute instruction pointers. */
+    plcrash_writer_report_images_reset(writer);
+    {
+        plcrash_log_writer_thread_snapshot_t *snapshots = writer->frame_arena.threads;
+        size_t reserve = plcrash_writer_crashed_thread_size(writer, capture);
+
+        if (writer->uncaught_exception.has_exception) {
+            plcrash_writer_message_t msg;
+
+            reserve += plcrash_writer_pack_message_begin(NULL, PLCRASH_PROTO_EXCEPTION_ID, &msg);
+            reserve += plcrash_writer_write_exception(NULL, writer);
+        }
+
+        /* Crashed thread */
+        for (uint32_t i = 0; i < capture->crashed_frame_count; i++)
+            plcrash_writer_write_referenced_image(file, writer, writer->frame_arena.pcs[i], reserve);
+
+        /* Exception */
+        for (size_t i = 0; i < writer->uncaught_exception.callstack_count && i < MAX_THREAD_FRAMES; i++) {
+            uint64_t pc = (uint64_t)(uintptr_t) writer->uncaught_exception.callstack[i];
+            plcrash_writer_write_referenced_image(file, writer, pc, reserve);
+        }
+
+        /* Other threads */
+        for (uint32_t i = 0; i < capture->thread_count && i < writer->frame_arena.thread_capacity; i++) {
+            if (!snapshots[i].captured)
+                continue;
+
+            for (uint32_t j = 0; j < snapshots[i].frame_count; j++)
+                plcrash_writer_write_referenced_image(file, writer, writer->frame_arena.pcs[snapshots[i].offset + j], reserve);
+        }
+    }
+
+    /* Exception */
+    if (writer->uncaught_exception.has_exception) {
+        plcrash_writer_message_t msg;
+
+        if (plcrash_writer_pack_message_begin(file, PLCRASH_PROTO_EXCEPTION_ID, &msg) > 0) {
+            plcrash_writer_write_exception(file, writer);
+            plcrash_writer_pack_message_end(file, &msg);
+        }
+    }
+
+    /* Threads. Identical backtraces are written once, and referenced by subsequent threads.
+     *
+     * All threads were captured to the frame arena, and resumed, before the report was encoded. The crashed thread's
+     * space is reserved; the remaining space is shared between the other threads, with each thread's backtrace
+     * truncated to the innermost frames that fit within its share. Space left unused by a thread is made available
+     * to the threads that follow. */
+    plcrash_writer_stack_table_reset(writer);
+    {
+        plcrash_log_writer_thread_snapshot_t *snapshots = writer->frame_arena.threads;
+        const uint64_t *crashed_pcs = writer->frame_arena.pcs;
+        size_t crashed_reserve = plcrash_writer_crashed_thread_size(writer, capture);
+
+        /* Count the threads sharing the remaining space */
+        uint32_t threads_remaining = 0;
+        for (uint32_t i = 0; i < capture->thread_count; i++) {
+            if (i != capture->crashed_thread && i < writer->frame_arena.thread_capacity && snapshots[i].captured)
+                threads_remaining++;
+        }
+
+        /* Write out each thread's state */
+        for (uint32_t i = 0; i < capture->thread_count; i++) {
+            size_t remaining = plcrash_async_file_remaining(file);
+
+            /* Check if this is the crashed thread */
+            if (i == capture->crashed_thread) {
+                plcrash_writer_write_thread_message(file, writer, i, true, crashed_pcs, capture->crashed_frame_count,
+                                                    capture->crashed_regs, capture->crashed_reg_count, remaining);
+                crashed_reserve = 0;
+                continue;
+            }
+
+            /* Threads that could not be captured are omitted */
+            if (i >= writer->frame_arena.thread_capacity || !snapshots[i].captured) {
+                PLCF_DEBUG("Omitting thread %" PRIu32 "; the thread was not captured", i);
+                continue;
+            }
+
+            /* Compute this thread's share of the space remaining after the crashed thread's reservation */
+            size_t budget = 0;
+            if (remaining > crashed_reserve)
+                budget = (remaining - crashed_reserve) / threads_remaining;
+            threads_remaining--;
+
+            /* Write message */
+            plcrash_writer_write_thread_message(file, writer, i, false, writer->frame_arena.pcs + snapshots[i].offset,
+                                                snapshots[i].frame_count, NULL, 0, budget);
+        }
+    }
+
+    return PLCRASH_ESUCCESS;
+}
+
+
+/**
+ * @} plcrash_log_writer
+ */
@@ -26,11 +26,23 @@
  * OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#ifdef __APPLE__
 #import <TargetConditionals.h>
+#endif
+
+#ifdef __OBJC__
 #import <Foundation/Foundation.h>
+#endif
+
+#import <signal.h>
+#import <stdbool.h>
+#import <stdint.h>
+#import <sys/types.h>
+#import <sys/ucontext.h>
 
 #import "PLCrashAsync.h"
 #import "PLCrashAsyncImage.h"
+#import "PLCrashAsyncCompress.h"
 
 /**
  * @internal
@@ -43,6 +55,73 @@
  * @{
  */
 
+/**
+ * @internal
+ *
+ * Crash log writer encoding options. Options are disabled by default, and may be enabled via
+ * plcrash_log_writer_set_options().
+ */
+typedef enum {
+    /** Encode backtrace frames as deltas relative to their containing binary image, rather than as absolute
+     * instruction pointers. */
+    PLCRASH_LOG_WRITER_OPTION_IMAGE_RELATIVE_FRAMES = 1 << 0,
+
+    /** Compress the crash report. The report is written to a pre-allocated buffer, and compressed once complete. */
+    PLCRASH_LOG_WRITER_OPTION_COMPRESS = 1 << 1,
+} plcrash_log_writer_option_t;
+
+/**
+ * @internal
+ *
+ * A thread's state, as captured prior to writing the crash report.
+ */
+typedef struct plcrash_log_writer_thread_snapshot {
+    /** True if the thread was suspended for capture. */
+    bool suspended;
+
+    /** True if the thread's backtrace was captured to the frame arena. */
+    bool captured;
+
+    /** The offset of the thread's backtrace within the frame arena. */
+    size_t offset;
+
+    /** The number of frames in the thread's backtrace. */
+    uint32_t frame_count;
+} plcrash_log_writer_thread_snapshot_t;
+
+/**
+ * @internal
+ *
+ * A thread backtrace that has been written to the crash report, and may be referenced by subsequent threads
+ * with an identical backtrace.
+ */
+typedef struct plcrash_log_writer_stack {
+    /** The backtrace hash, or 0 if the slot is unused. */
+    uint64_t hash;
+
+    /** The number of the thread for which the backtrace was written. */
+    uint32_t thread_number;
+
+    /** The number of frames in the backtrace. */
+    uint32_t frame_count;
+
+    /** The offset of the backtrace's frames within the stack table's PC arena. */
+    size_t offset;
+} plcrash_log_writer_stack_t;
+
+/**
+ * @internal
+ *
+ * A binary image whose record has been written to the crash report.
+ */
+typedef struct plcrash_log_writer_report_image {
+    /** The image list entry, or NULL if the slot is unused. */
+    plcrash_async_image_t *image;
+
+    /** The index at which the image's record was written. */
+    uint32_t index;
+} plcrash_log_writer_report_image_t;
+
 /**
  * @internal
  *
@@ -56,6 +135,12 @@ typedef struct plcrash_log_writer {
 
         /** The host OS build number. This may be NULL. */
         char *build;
+
+        /** The host OS, as a CrashReport.SystemInfo.OperatingSystem value. */
+        uint32_t operating_system;
+
+        /** The host architecture, as a CrashReport.SystemInfo.Architecture value. */
+        uint32_t architecture;
     } system_info;
 
     /* Machine data */
@@ -106,12 +191,36 @@ typedef struct plcrash_log_writer {
         bool native;
     } process_info;
     
+    /** Report sections that do not change after initialization, pre-encoded by plcrash_log_writer_init(). */
+    struct {
+        /** The encoded machine, application, process, and system info messages, or NULL if unavailable. The
+         * system info message is encoded last, and its trailing timestamp field must be appended at crash time. */
+        void *data;
+
+        /** Length of the encoded data, in bytes. */
+        size_t length;
+    } static_sections;
+
     /** Binary image data */
     struct {
         /** The list of the processes' loaded images, as provided by dyld. */
         plcrash_async_image_list_t image_list;
     } image_info;
 
+    /** The binary images written to the current crash report, pre-allocated at initialization. Image-relative
+     * backtraces reference images by the index at which their record was written, as recorded here, rather than by
+     * their current position in the image list. */
+    struct {
+        /** Open-addressed hash table of written images, keyed by image list entry. */
+        plcrash_log_writer_report_image_t *slots;
+
+        /** The number of slots in the table. Must be a power of two. */
+        size_t capacity;
+
+        /** The number of slots in use. */
+        size_t count;
+    } report_images;
+
     /** Uncaught exception (if any) */
     struct {
         /** Flag specifying wether an uncaught exception is available. */
@@ -129,13 +238,92 @@ typedef struct plcrash_log_writer {
         /** Call stack frame count, or 0 if the call stack is unavailable */
         size_t callstack_count;
     } uncaught_exception;
+
+    /** Enabled encoding options (a bitwise OR of plcrash_log_writer_option_t values) */
+    uint32_t options;
+
+    /** Backtrace interning table, pre-allocated at initialization and used to write each distinct thread
+     * backtrace only once. */
+    struct {
+        /** Open-addressed hash table of written backtraces, or NULL if unavailable. */
+        plcrash_log_writer_stack_t *stacks;
+
+        /** The number of slots in the table. Must be a power of two. */
+        size_t capacity;
+
+        /** The number of slots in use. */
+        size_t count;
+
+        /** PC arena holding the frames of all written backtraces. */
+        uint64_t *pcs;
+
+        /** The size of the PC arena, in elements. */
+        size_t pcs_capacity;
+
+        /** The number of PC arena elements in use. */
+        size_t pcs_count;
+    } stack_table;
+
+    /** Pre-allocated PC arena, into which thread backtraces are captured prior to encoding. All threads are
+     * suspended, captured, and resumed once, before the report is encoded. */
+    struct {
+        /** The arena, holding the crashed thread's backtrace, followed by the backtraces of the captured threads. */
+        uint64_t *pcs;
+
+        /** The size of the arena, in elements. */
+        size_t capacity;
+
+        /** Per-thread capture state, indexed by thread number. */
+        plcrash_log_writer_thread_snapshot_t *threads;
+
+        /** The number of elements in threads. */
+        size_t thread_capacity;
+
+#ifdef __linux__
+        /** Thread list of thread_capacity elements, populated from /proc/self/task at crash time. */
+        pid_t *thread_list;
+#endif
+    } frame_arena;
+
+    /** Compression buffers, pre-allocated when compression is enabled via plcrash_log_writer_set_options(). */
+    struct {
+        /** Compressor state, or NULL if unavailable. */
+        plcrash_async_lz_state_t *state;
+
+        /** Buffer holding the uncompressed report, or NULL if unavailable. */
+        uint8_t *buffer;
+
+        /** The size of buffer, in bytes. */
+        size_t size;
+    } compression;
 } plcrash_log_writer_t;
 
 
+plcrash_error_t plcrash_log_writer_init_c (plcrash_log_writer_t *writer, const char *app_identifier, const char *app_version);
+void plcrash_log_writer_set_options (plcrash_log_writer_t *writer, uint32_t options);
+
+/**
+ * @internal
+ *
+ * Populate the process, machine, and system info of @a writer. Implemented per-platform: by the Foundation
+ * writer on Mac OS X and iOS, and via /proc and uname() on Linux.
+ *
+ * @param writer Writer instance being initialized by plcrash_log_writer_init_c().
+ */
+plcrash_error_t plcrash_log_writer_init_host_info (plcrash_log_writer_t *writer);
+
+#ifdef __OBJC__
 plcrash_error_t plcrash_log_writer_init (plcrash_log_writer_t *writer, NSString *app_identifier, NSString *app_version);
 void plcrash_log_writer_set_exception (plcrash_log_writer_t *writer, NSException *exception);
+#endif
 
+#if defined(__APPLE__)
 void plcrash_log_writer_add_image (plcrash_log_writer_t *writer, const void *header_addr);
+void plcrash_log_writer_add_images (plcrash_log_writer_t *writer, const void * const *header_addrs, const char * const *names,
+                                    size_t count);
+#elif defined(__linux__)
+plcrash_error_t plcrash_log_writer_update_images (plcrash_log_writer_t *writer);
+#endif
 void plcrash_log_writer_remove_image (plcrash_log_writer_t *writer, const void *header_addr);
 
 plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_async_file_t *file, siginfo_t *siginfo, ucontext_t *crashctx);
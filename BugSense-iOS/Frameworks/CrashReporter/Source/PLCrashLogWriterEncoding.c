@@ -29,61 +29,25 @@
 
 #define MAX_UINT64_ENCODED_SIZE 10
 
-/* --- wire format enums --- */
-typedef enum {
-        PLPROTOBUF_C_WIRE_TYPE_VARINT,
-        PLPROTOBUF_C_WIRE_TYPE_64BIT,
-        PLPROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED,
-        PLPROTOBUF_C_WIRE_TYPE_START_GROUP,     /* unsupported */
-        PLPROTOBUF_C_WIRE_TYPE_END_GROUP,       /* unsupported */
-        PLPROTOBUF_C_WIRE_TYPE_32BIT
-} PLProtobufCWireType;
+/* Width of a reserved (padded) single-pass message length prefix. Sufficient for any uint32_t length. */
+#define MESSAGE_LENGTH_PREFIX_SIZE 5
 
 /* === get_packed_size() === */
 static inline size_t
 get_tag_size (unsigned number)
 {
-    if (number < (1<<4))
-        return 1;
-    else if (number < (1<<11))
-        return 2;
-    else if (number < (1<<18))
-        return 3;
-    else if (number < (1<<25))
-        return 4;
-    else
-        return 5;
+    return protobuf_c_varint_size32 (number << 3);
 }
 static inline size_t
 uint32_size (uint32_t v)
 {
-    if (v < (1<<7))
-        return 1;
-    else if (v < (1<<14))
-        return 2;
-    else if (v < (1<<21))
-        return 3;
-    else if (v < (1<<28))
-        return 4;
-    else
-        return 5;
+    return protobuf_c_varint_size32 (v);
 }
 static inline size_t
 int32_size (int32_t v)
 {
-    if (v < 0)
-        return 10;
-    else
-        if (v < (1<<7))
-            return 1;
-        else if (v < (1<<14))
-            return 2;
-        else if (v < (1<<21))
-            return 3;
-        else if (v < (1<<28))
-            return 4;
-        else
-            return 5;
+    /* negative values are sign-extended to 10 bytes */
+    return protobuf_c_varint_size64 ((uint64_t)(int64_t) v);
 }
 static inline uint32_t
 zigzag32 (int32_t v)
@@ -101,21 +65,7 @@ sint32_size (int32_t v)
 static inline size_t
 uint64_size (uint64_t v)
 {
-    uint32_t upper_v = (v>>32);
-    if (upper_v == 0)
-        return uint32_size ((uint32_t)v);
-    else if (upper_v < (1<<3))
-        return 5;
-    else if (upper_v < (1<<10))
-        return 6;
-    else if (upper_v < (1<<17))
-        return 7;
-    else if (upper_v < (1<<24))
-        return 8;
-    else if (upper_v < (1U<<31))
-        return 9;
-    else
-        return 10;
+    return protobuf_c_varint_size64 (v);
 }
 static inline uint64_t
 zigzag64 (int64_t v)
@@ -252,6 +202,17 @@ static inline size_t string_pack (const char * str, uint8_t *out)
     return rv + len;
 }
 
+/* Encode value as a varint padded to exactly width bytes. Decoders accept the redundant continuation bytes. */
+static inline size_t padded_varint_pack (uint64_t value, size_t width, uint8_t *out)
+{
+    for (size_t i = 0; i < width - 1; i++) {
+        out[i] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[width - 1] = value & 0x7F;
+    return width;
+}
+
 /* wire-type will be added in required_field_pack() */
 static size_t tag_pack (uint32_t id, uint8_t *out)
 {
@@ -263,6 +224,7 @@ static size_t tag_pack (uint32_t id, uint8_t *out)
 
 /* === pack_to_buffer() === */
 // file argument may be NULL
+// STRING and BYTES values are queued by reference, and must remain valid until the file is flushed
 size_t plcrash_writer_pack (plcrash_async_file_t *file, uint32_t field_id, PLProtobufCType field_type, const void *value) {
     size_t rv;
     uint8_t scratch[MAX_UINT64_ENCODED_SIZE * 2];
@@ -331,7 +293,7 @@ size_t plcrash_writer_pack (plcrash_async_file_t *file, uint32_t field_id, PLPro
             rv += uint32_pack (sublen, scratch + rv);
             if (file != NULL) {
                 plcrash_async_file_write(file, scratch, rv);
-                plcrash_async_file_write(file, value, sublen);
+                plcrash_async_file_write_ref(file, value, sublen);
             }
             rv += sublen;
             break;
@@ -345,7 +307,7 @@ size_t plcrash_writer_pack (plcrash_async_file_t *file, uint32_t field_id, PLPro
             rv += uint32_pack (sublen, scratch + rv);
             if (file != NULL) {
                 plcrash_async_file_write(file, scratch, rv);
-                plcrash_async_file_write(file, bd->data, sublen);
+                plcrash_async_file_write_ref(file, bd->data, sublen);
             }
             rv += sublen;
             break;
@@ -366,3 +328,84 @@ size_t plcrash_writer_pack (plcrash_async_file_t *file, uint32_t field_id, PLPro
     }
     return rv;
 }
+
+/**
+ * Begin a nested message. The message's tag is written, and a fixed-width length prefix is reserved; the
+ * message's fields may then be written directly, without requiring a separate pass to determine the
+ * message size. The message must be completed via plcrash_writer_pack_message_end().
+ *
+ * Any length-delimited field may be written this way, including packed repeated fields.
+ *
+ * If the header can not be written (eg, because the output limit has been reached), 0 is returned, and the caller
+ * must not write the message's fields; a later, shorter write could otherwise succeed, and the message's fields
+ * would be written to the enclosing message without a header.
+ *
+ * @param file Output file. May be NULL, in which case only the header size is returned.
+ * @param field_id The message's field ID.
+ * @param msg Message state to be initialized.
+ *
+ * @return Returns the number of bytes in the message header, or 0 if the header could not be written to @a file.
+ */
+size_t plcrash_writer_pack_message_begin (plcrash_async_file_t *file, uint32_t field_id, plcrash_writer_message_t *msg) {
+    size_t rv;
+    uint8_t scratch[MAX_UINT64_ENCODED_SIZE + MESSAGE_LENGTH_PREFIX_SIZE];
+
+    rv = tag_pack (field_id, scratch);
+    scratch[0] |= PLPROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED;
+    rv += padded_varint_pack(0, MESSAGE_LENGTH_PREFIX_SIZE, scratch + rv);
+
+    msg->length_offset = -1;
+    if (file == NULL)
+        return rv;
+
+    if (!plcrash_async_file_write(file, scratch, rv))
+        return 0;
+
+    msg->length_offset = plcrash_async_file_offset(file) - MESSAGE_LENGTH_PREFIX_SIZE;
+    return rv;
+}
+
+/**
+ * Complete a nested message started with plcrash_writer_pack_message_begin(), back-patching
+ * its reserved length prefix.
+ *
+ * @param file Output file. May be NULL.
+ * @param msg The message state.
+ */
+void plcrash_writer_pack_message_end (plcrash_async_file_t *file, plcrash_writer_message_t *msg) {
+    uint8_t prefix[MESSAGE_LENGTH_PREFIX_SIZE];
+    uint32_t len;
+
+    /* Nothing to patch if the header was never written */
+    if (file == NULL || msg->length_offset < 0)
+        return;
+
+    len = (uint32_t) (plcrash_async_file_offset(file) - (msg->length_offset + MESSAGE_LENGTH_PREFIX_SIZE));
+    padded_varint_pack(len, sizeof(prefix), prefix);
+    if (!plcrash_async_file_pwrite(file, msg->length_offset, prefix, sizeof(prefix)))
+        PLCF_DEBUG("Failed to write message length prefix");
+}
+
+/**
+ * Pack a varint field, padded to the maximum 64-bit varint width. As the encoded size does not depend on
+ * @a value, this may be used to write a field that trails a message whose length prefix was computed in advance.
+ *
+ * @param file Output file. May be NULL, in which case only the field size is returned.
+ * @param field_id The field ID.
+ * @param value The value to be written. Signed (int64) values may be cast directly.
+ *
+ * @return Returns the number of bytes written, which is always equal to plcrash_writer_pack_padded_varint(NULL, ...).
+ */
+size_t plcrash_writer_pack_padded_varint (plcrash_async_file_t *file, uint32_t field_id, uint64_t value) {
+    size_t rv;
+    uint8_t scratch[MAX_UINT64_ENCODED_SIZE * 2];
+
+    rv = tag_pack (field_id, scratch);
+    scratch[0] |= PLPROTOBUF_C_WIRE_TYPE_VARINT;
+    rv += padded_varint_pack(value, MAX_UINT64_ENCODED_SIZE, scratch + rv);
+
+    if (file != NULL)
+        plcrash_async_file_write(file, scratch, rv);
+
+    return rv;
+}
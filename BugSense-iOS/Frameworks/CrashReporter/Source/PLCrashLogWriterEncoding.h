@@ -16,6 +16,10 @@
 
 #import "PLCrashAsync.h"
 
+#import <string.h>
+
+#import <google/protobuf-c/protobuf-c-varint.h>
+
 typedef enum {
         PLPROTOBUF_C_TYPE_INT32,
         PLPROTOBUF_C_TYPE_SINT32,
@@ -42,4 +46,150 @@ typedef struct PLProtobufCBinaryData {
     void *data;
 } PLProtobufCBinaryData;
 
-size_t plcrash_writer_pack (plcrash_async_file_t *file, uint32_t field_id, PLProtobufCType field_type, const void *value);
\ No newline at end of file
+/* --- wire format enums --- */
+typedef enum {
+        PLPROTOBUF_C_WIRE_TYPE_VARINT,
+        PLPROTOBUF_C_WIRE_TYPE_64BIT,
+        PLPROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED,
+        PLPROTOBUF_C_WIRE_TYPE_START_GROUP,     /* unsupported */
+        PLPROTOBUF_C_WIRE_TYPE_END_GROUP,       /* unsupported */
+        PLPROTOBUF_C_WIRE_TYPE_32BIT
+} PLProtobufCWireType;
+
+/**
+ * @internal
+ *
+ * Single-pass nested message state. The message's length prefix is reserved as a fixed-width varint
+ * when the message is started, and back-patched once the message's contents have been written.
+ */
+typedef struct plcrash_writer_message {
+    /** Output offset of the reserved length prefix, or -1 if the prefix could not be written. */
+    off_t length_offset;
+} plcrash_writer_message_t;
+
+size_t plcrash_writer_pack (plcrash_async_file_t *file, uint32_t field_id, PLProtobufCType field_type, const void *value);
+size_t plcrash_writer_pack_padded_varint (plcrash_async_file_t *file, uint32_t field_id, uint64_t value);
+
+size_t plcrash_writer_pack_message_begin (plcrash_async_file_t *file, uint32_t field_id, plcrash_writer_message_t *msg);
+void plcrash_writer_pack_message_end (plcrash_async_file_t *file, plcrash_writer_message_t *msg);
+
+/*
+ * Type-specialized field encoders.
+ *
+ * These encode directly into the output buffer via plcrash_async_file_reserve(), avoiding the type dispatch and
+ * scratch buffer copy of plcrash_writer_pack(). As with plcrash_writer_pack(), the file argument may be NULL, in
+ * which case only the encoded size is returned.
+ */
+
+/**
+ * @internal
+ * Return the encoded size of @a value as a varint.
+ */
+static inline size_t plcrash_writer_varint_size (uint64_t value) {
+    return protobuf_c_varint_size64(value);
+}
+
+/**
+ * @internal
+ * Encode @a value as a varint to @a out, returning the number of bytes written.
+ */
+static inline size_t plcrash_writer_varint_pack (uint64_t value, uint8_t *out) {
+    size_t rv = 0;
+    while (value >= 0x80) {
+        out[rv++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[rv++] = value;
+    return rv;
+}
+
+/**
+ * @internal
+ * Write a field tag of @a wire_type, followed by a varint @a value.
+ */
+static inline size_t plcrash_writer_pack_varint_field (plcrash_async_file_t *file, uint32_t field_id,
+                                                       PLProtobufCWireType wire_type, uint64_t value)
+{
+    uint64_t tag = ((uint64_t) field_id << 3) | wire_type;
+    size_t rv = plcrash_writer_varint_size(tag) + plcrash_writer_varint_size(value);
+    uint8_t *out;
+
+    if (file == NULL || (out = plcrash_async_file_reserve(file, rv)) == NULL)
+        return rv;
+
+    out += plcrash_writer_varint_pack(tag, out);
+    plcrash_writer_varint_pack(value, out);
+    plcrash_async_file_commit(file, rv);
+
+    return rv;
+}
+
+/**
+ * @internal
+ * Write an untagged varint @a value, as used for the elements of a packed repeated field. The
+ * field's tag and length prefix must be written via plcrash_writer_pack_message_begin().
+ */
+static inline size_t plcrash_writer_pack_packed_varint (plcrash_async_file_t *file, uint64_t value) {
+    size_t rv = plcrash_writer_varint_size(value);
+    uint8_t *out;
+
+    if (file == NULL || (out = plcrash_async_file_reserve(file, rv)) == NULL)
+        return rv;
+
+    plcrash_writer_varint_pack(value, out);
+    plcrash_async_file_commit(file, rv);
+
+    return rv;
+}
+
+/**
+ * @internal
+ * Write a uint64 (or int64) field.
+ */
+static inline size_t plcrash_writer_pack_uint64 (plcrash_async_file_t *file, uint32_t field_id, uint64_t value) {
+    return plcrash_writer_pack_varint_field(file, field_id, PLPROTOBUF_C_WIRE_TYPE_VARINT, value);
+}
+
+/**
+ * @internal
+ * Write a uint32 (or enum) field.
+ */
+static inline size_t plcrash_writer_pack_uint32 (plcrash_async_file_t *file, uint32_t field_id, uint32_t value) {
+    return plcrash_writer_pack_varint_field(file, field_id, PLPROTOBUF_C_WIRE_TYPE_VARINT, value);
+}
+
+/**
+ * @internal
+ * Write a bool field.
+ */
+static inline size_t plcrash_writer_pack_bool (plcrash_async_file_t *file, uint32_t field_id, bool value) {
+    return plcrash_writer_pack_varint_field(file, field_id, PLPROTOBUF_C_WIRE_TYPE_VARINT, value ? 1 : 0);
+}
+
+/**
+ * @internal
+ * Write a nested message's tag and length prefix. The message's @a length bytes must be written immediately
+ * afterwards.
+ */
+static inline size_t plcrash_writer_pack_message_header (plcrash_async_file_t *file, uint32_t field_id, uint32_t length) {
+    return plcrash_writer_pack_varint_field(file, field_id, PLPROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED, length);
+}
+
+/**
+ * @internal
+ * Write a bytes field. The data is queued by reference, and must remain valid until the file is flushed.
+ */
+static inline size_t plcrash_writer_pack_bytes (plcrash_async_file_t *file, uint32_t field_id, const void *data, size_t len) {
+    size_t rv = plcrash_writer_pack_varint_field(file, field_id, PLPROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED, len);
+    if (file != NULL)
+        plcrash_async_file_write_ref(file, data, len);
+    return rv + len;
+}
+
+/**
+ * @internal
+ * Write a string field. The string is queued by reference, and must remain valid until the file is flushed.
+ */
+static inline size_t plcrash_writer_pack_string (plcrash_async_file_t *file, uint32_t field_id, const char *value) {
+    return plcrash_writer_pack_bytes(file, field_id, value, strlen(value));
+}
@@ -0,0 +1,266 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+
+#import "PLCrashLogWriterEncoding.h"
+#import "crash_report.pb-c.h"
+
+#import <mach/mach_time.h>
+
+@interface PLCrashLogWriterEncodingTests : SenTestCase @end
+
+@implementation PLCrashLogWriterEncodingTests
+
+/* Reference (loop-based) varint size, used to validate the size kernels */
+static size_t reference_varint_size (uint64_t value) {
+    size_t rv = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        rv++;
+    }
+    return rv;
+}
+
+/* Verify the varint size kernels and encoder against the reference implementation across all value widths */
+- (void) testVarintKernels {
+    for (unsigned int bit = 0; bit <= 64; bit++) {
+        for (int delta = -1; delta <= 1; delta++) {
+            uint64_t value = (bit == 64 ? 0 : (1ULL << bit)) + delta;
+            uint8_t encoded[PROTOBUF_C_VARINT_MAX_SIZE];
+            size_t len = reference_varint_size(value);
+
+            /* Sizing */
+            STAssertEquals(len, protobuf_c_varint_size64(value), @"Incorrect size for value %llx", (unsigned long long) value);
+            if ((uint32_t) value == value)
+                STAssertEquals(len, protobuf_c_varint_size32((uint32_t) value), @"Incorrect size for value %llx", (unsigned long long) value);
+            STAssertEquals(len, plcrash_writer_varint_size(value), @"Incorrect size for value %llx", (unsigned long long) value);
+
+            /* Round trip */
+            STAssertEquals(len, plcrash_writer_varint_pack(value, encoded), @"Incorrect length for value %llx", (unsigned long long) value);
+
+            uint64_t decoded = 0;
+            for (size_t i = 0; i < len; i++)
+                decoded |= ((uint64_t) (encoded[i] & 0x7F)) << (7 * i);
+            STAssertEquals(value, decoded, @"Incorrect round trip for value %llx", (unsigned long long) value);
+        }
+    }
+}
+
+/* Compare the reference and kernel varint size computations over a uniform distribution of value widths. Results are logged. */
+- (void) testVarintKernelBenchmark {
+    const size_t count = 1000000;
+    uint64_t *values = malloc(count * sizeof(uint64_t));
+    mach_timebase_info_data_t timebase;
+    uint64_t seed = 88172645463325252ULL;
+    uint64_t start;
+    uint64_t reference_ns, kernel_ns;
+    volatile size_t total;
+
+    mach_timebase_info(&timebase);
+
+    for (size_t i = 0; i < count; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        values[i] = seed >> (seed % 64);
+    }
+
+    total = 0;
+    start = mach_absolute_time();
+    for (size_t i = 0; i < count; i++)
+        total += reference_varint_size(values[i]);
+    reference_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    total = 0;
+    start = mach_absolute_time();
+    for (size_t i = 0; i < count; i++)
+        total += protobuf_c_varint_size64(values[i]);
+    kernel_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    NSLog(@"Sized %zu varints: reference %.2f ns/value, kernel %.2f ns/value", count,
+          (double) reference_ns / count, (double) kernel_ns / count);
+
+    free(values);
+}
+
+/* Verify that packed pcs written via the single-pass message API are decodable by protobuf-c */
+- (void) testPackedFrames {
+    uint8_t buffer[1024];
+    plcrash_async_file_t file;
+    plcrash_writer_message_t pcs;
+    uint64_t expected[3 * 64];
+    size_t count = 0;
+
+    plcrash_async_file_init_mem(&file, buffer, sizeof(buffer));
+    plcrash_writer_pack_uint32(&file, 1, 0);
+    plcrash_writer_pack_bool(&file, 3, true);
+
+    plcrash_writer_pack_message_begin(&file, 5, &pcs);
+    for (unsigned int bit = 0; bit < 64; bit++) {
+        for (int delta = -1; delta <= 1; delta++) {
+            expected[count] = (1ULL << bit) + delta;
+            plcrash_writer_pack_packed_varint(&file, expected[count]);
+            count++;
+        }
+    }
+    plcrash_writer_pack_message_end(&file, &pcs);
+
+    Plcrash__CrashReport__Thread *thread = plcrash__crash_report__thread__unpack(&protobuf_c_system_allocator,
+                                                                                  plcrash_async_file_offset(&file), buffer);
+    STAssertNotNULL(thread, @"Could not decode thread message");
+    if (thread == NULL)
+        return;
+
+    STAssertTrue(thread->has_pcs, @"Missing pcs field");
+    STAssertEquals((size_t) 0, thread->n_frames, @"Unexpected legacy frames");
+
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = 0;
+        unsigned int shift = 0;
+        uint8_t byte;
+
+        do {
+            if (offset == thread->pcs.len) {
+                STFail(@"Truncated pcs field");
+                break;
+            }
+            byte = thread->pcs.data[offset++];
+            value |= ((uint64_t) (byte & 0x7F)) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        STAssertEquals(expected[i], value, @"Incorrect pc at index %zu", i);
+    }
+    STAssertEquals(offset, thread->pcs.len, @"Trailing pcs data");
+
+    protobuf_c_message_free_unpacked((ProtobufCMessage *) thread, &protobuf_c_system_allocator);
+}
+
+/* Verify that a message whose header could not be written is reported as failed, and is not back-patched */
+- (void) testMessageBeginFailure {
+    uint8_t buffer[8];
+    plcrash_async_file_t file;
+    plcrash_writer_message_t msg;
+
+    /* Sizing always succeeds */
+    STAssertTrue(plcrash_writer_pack_message_begin(NULL, 5, &msg) > 0, @"Sizing should return the header size");
+
+    /* Fill the buffer, leaving less space than the message header requires */
+    plcrash_async_file_init_mem(&file, buffer, sizeof(buffer));
+    plcrash_writer_pack_uint32(&file, 1, 0);
+    plcrash_writer_pack_uint32(&file, 2, 0);
+    off_t offset = plcrash_async_file_offset(&file);
+
+    STAssertEquals((size_t) 0, plcrash_writer_pack_message_begin(&file, 5, &msg), @"Header write should fail");
+    STAssertEquals(offset, plcrash_async_file_offset(&file), @"No data should be written");
+
+    /* Completing the failed message must not modify the output */
+    plcrash_writer_pack_message_end(&file, &msg);
+    STAssertEquals(offset, plcrash_async_file_offset(&file), @"No data should be written");
+}
+
+/* Verify that the type-specialized encoders match plcrash_writer_pack() across all value widths */
+- (void) testTypedEncoders {
+    uint8_t generic[128];
+    uint8_t typed[128];
+
+    for (unsigned int bit = 0; bit < 64; bit++) {
+        for (int delta = -1; delta <= 1; delta++) {
+            uint64_t u64 = (1ULL << bit) + delta;
+            uint32_t u32 = (uint32_t) u64;
+            bool b = (u64 & 1);
+            plcrash_async_file_t gfile;
+            plcrash_async_file_t tfile;
+            size_t glen = 0;
+            size_t tlen = 0;
+
+            plcrash_async_file_init_mem(&gfile, generic, sizeof(generic));
+            plcrash_async_file_init_mem(&tfile, typed, sizeof(typed));
+
+            glen += plcrash_writer_pack(&gfile, 1, PLPROTOBUF_C_TYPE_UINT64, &u64);
+            glen += plcrash_writer_pack(&gfile, 2, PLPROTOBUF_C_TYPE_UINT32, &u32);
+            glen += plcrash_writer_pack(&gfile, 3, PLPROTOBUF_C_TYPE_BOOL, &b);
+            glen += plcrash_writer_pack(&gfile, 4, PLPROTOBUF_C_TYPE_MESSAGE, &u32);
+            glen += plcrash_writer_pack(&gfile, 2048, PLPROTOBUF_C_TYPE_STRING, "string");
+
+            tlen += plcrash_writer_pack_uint64(&tfile, 1, u64);
+            tlen += plcrash_writer_pack_uint32(&tfile, 2, u32);
+            tlen += plcrash_writer_pack_bool(&tfile, 3, b);
+            tlen += plcrash_writer_pack_message_header(&tfile, 4, u32);
+            tlen += plcrash_writer_pack_string(&tfile, 2048, "string");
+
+            STAssertEquals(glen, tlen, @"Incorrect encoded size for value %llx", (unsigned long long) u64);
+            STAssertEquals(plcrash_async_file_offset(&gfile), plcrash_async_file_offset(&tfile), @"Incorrect output length");
+            STAssertTrue(memcmp(generic, typed, glen) == 0, @"Incorrect encoding for value %llx", (unsigned long long) u64);
+
+            /* Sizing must not require an output file */
+            STAssertEquals(tlen, plcrash_writer_pack_uint64(NULL, 1, u64) + plcrash_writer_pack_uint32(NULL, 2, u32) +
+                           plcrash_writer_pack_bool(NULL, 3, b) + plcrash_writer_pack_message_header(NULL, 4, u32) +
+                           plcrash_writer_pack_string(NULL, 2048, "string"), @"Incorrect computed size");
+        }
+    }
+}
+
+/* Compare the switch-based and type-specialized encoders when writing frame PC values. Results are logged. */
+- (void) testTypedEncoderBenchmark {
+    const size_t count = 1000000;
+    size_t size = count * 8;
+    uint8_t *buffer = malloc(size);
+    mach_timebase_info_data_t timebase;
+    plcrash_async_file_t file;
+    uint64_t start;
+    uint64_t generic_ns;
+    uint64_t typed_ns;
+
+    mach_timebase_info(&timebase);
+
+    /* Switch-based encoder */
+    plcrash_async_file_init_mem(&file, buffer, size);
+    start = mach_absolute_time();
+    for (size_t i = 0; i < count; i++) {
+        uint64_t pc = 0x100000000ULL + (i * 16);
+        plcrash_writer_pack(&file, 3, PLPROTOBUF_C_TYPE_UINT64, &pc);
+    }
+    generic_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    /* Type-specialized encoder */
+    plcrash_async_file_init_mem(&file, buffer, size);
+    start = mach_absolute_time();
+    for (size_t i = 0; i < count; i++)
+        plcrash_writer_pack_uint64(&file, 3, 0x100000000ULL + (i * 16));
+    typed_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    NSLog(@"Encoded %zu PCs: plcrash_writer_pack() %.2f ns/field, plcrash_writer_pack_uint64() %.2f ns/field", count,
+          (double) generic_ns / count, (double) typed_ns / count);
+
+    free(buffer);
+}
+
+@end
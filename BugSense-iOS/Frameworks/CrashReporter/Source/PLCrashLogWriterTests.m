@@ -38,6 +38,10 @@
 #import <dlfcn.h>
 
 #import <mach-o/loader.h>
+#import <mach-o/dyld.h>
+#import <mach/mach.h>
+#import <mach/mach_time.h>
+#import <pthread.h>
 
 #import "crash_report.pb-c.h"
 
@@ -55,6 +59,102 @@
 
 @implementation PLCrashLogWriterTests
 
+/* Decode up to max packed pcs values, returning the number of values decoded, or -1 if the data is malformed. */
+static ssize_t decode_packed_pcs (const ProtobufCBinaryData *pcs, uint64_t *values, size_t max) {
+    size_t count = 0;
+    size_t offset = 0;
+
+    while (offset < pcs->len && count < max) {
+        uint64_t value = 0;
+        unsigned int shift = 0;
+        uint8_t byte;
+
+        do {
+            if (offset == pcs->len || shift >= 64)
+                return -1;
+
+            byte = pcs->data[offset++];
+            value |= ((uint64_t) (byte & 0x7F)) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        values[count++] = value;
+    }
+
+    return count;
+}
+
+/* Decode up to max image-relative pcs values against the report's binary images, returning the number of values
+ * decoded, or -1 if the data is malformed or references a binary image that was not written. */
+static ssize_t decode_relative_pcs (const ProtobufCBinaryData *relative_pcs, Plcrash__CrashReport *report, uint64_t *values,
+                                    size_t max)
+{
+    uint64_t pairs[1024];
+    size_t count = 0;
+
+    ssize_t pair_count = decode_packed_pcs(relative_pcs, pairs, sizeof(pairs) / sizeof(pairs[0]));
+    if (pair_count < 0 || pair_count % 2 != 0)
+        return -1;
+
+    uint64_t *last_pc = calloc(report->n_binary_images + 1, sizeof(uint64_t));
+    for (size_t i = 0; i < report->n_binary_images; i++)
+        last_pc[i] = report->binary_images[i]->base_address;
+
+    for (ssize_t i = 0; i < pair_count && count < max; i += 2) {
+        uint64_t image = pairs[i];
+        uint64_t delta = pairs[i + 1];
+
+        if (image == 0) {
+            values[count++] = delta;
+        } else if (image <= report->n_binary_images) {
+            last_pc[image - 1] += (delta >> 1) ^ -(delta & 1);
+            values[count++] = last_pc[image - 1];
+        } else {
+            free(last_pc);
+            return -1;
+        }
+    }
+
+    free(last_pc);
+    return count;
+}
+
+/* State of a thread that measures the longest interval for which it is not scheduled; while a crash report is
+ * written, this is the time for which the thread is suspended. */
+typedef struct suspension_monitor {
+    volatile bool stop;
+    volatile uint64_t max_gap;
+} suspension_monitor_t;
+
+static void *suspension_monitor_thread (void *arg) {
+    suspension_monitor_t *monitor = arg;
+    uint64_t last = mach_absolute_time();
+
+    while (!monitor->stop) {
+        uint64_t now = mach_absolute_time();
+        if (now - last > monitor->max_gap)
+            monitor->max_gap = now - last;
+        last = now;
+    }
+
+    return NULL;
+}
+
+/* State of a thread that increments a counter for as long as it is scheduled */
+typedef struct spinning_counter {
+    volatile bool stop;
+    volatile uint64_t count;
+} spinning_counter_t;
+
+static void *spinning_counter_thread (void *arg) {
+    spinning_counter_t *counter = arg;
+
+    while (!counter->stop)
+        counter->count++;
+
+    return NULL;
+}
+
 - (void) setUp {
     /* Create a temporary log path */
     _logPath = [[NSTemporaryDirectory() stringByAppendingString: [[NSProcessInfo processInfo] globallyUniqueString]] retain];
@@ -119,22 +219,41 @@
         /* Check that the threads are provided in order */
         STAssertEquals((uint32_t)i, thread->thread_number, @"Threads were encoded out of order (%d vs %d)", i, thread->thread_number);
 
-        /* Check that there is at least one frame */
-        STAssertNotEquals((size_t)0, thread->n_frames, @"No frames available in backtrace");
-        
         /* Check for crashed thread */
         if (thread->crashed) {
             foundCrashed = YES;
-            STAssertNotEquals((size_t)0, thread->n_registers, @"No registers available on crashed thread");
+            STAssertEquals((size_t)0, thread->n_registers, @"Legacy registers written");
+            STAssertTrue(thread->has_register_set, @"No register set available on crashed thread");
+            STAssertTrue(thread->has_register_values, @"No registers available on crashed thread");
+
+            uint64_t regs[PLFRAME_REG_LAST + 2];
+            ssize_t reg_count = decode_packed_pcs(&thread->register_values, regs, sizeof(regs) / sizeof(regs[0]));
+            STAssertEquals((ssize_t) (PLFRAME_REG_LAST + 1), reg_count, @"Incorrect number of register values");
+        } else {
+            STAssertFalse(thread->has_register_values, @"Registers written for a non-crashed thread");
         }
-        
-        for (int j = 0; j < thread->n_frames; j++) {
-            Plcrash__CrashReport__Thread__StackFrame *f = thread->frames[j];
 
+        /* Check that there is at least one frame, written in the packed encoding */
+        STAssertEquals((size_t)0, thread->n_frames, @"Legacy frames written");
+
+        /* Interned backtraces must reference an earlier thread, and omit their frames */
+        if (thread->has_interned_stack) {
+            STAssertTrue(thread->interned_stack < thread->thread_number, @"Interned backtrace references a later thread");
+            STAssertFalse(thread->has_pcs, @"Interned backtrace includes frames");
+            STAssertTrue(threads[thread->interned_stack]->has_pcs, @"Interned backtrace references a thread without frames");
+            continue;
+        }
+        STAssertTrue(thread->has_pcs, @"No frames available in backtrace");
+
+        uint64_t pcs[512];
+        ssize_t frame_count = decode_packed_pcs(&thread->pcs, pcs, sizeof(pcs) / sizeof(pcs[0]));
+        STAssertTrue(frame_count > 0, @"Invalid or empty packed backtrace");
+        
+        for (int j = 0; j < frame_count; j++) {
             /* It is possible for a mach thread to have pc=0 in the first frame. This is the case when a mach thread is
              * first created -- its initial state is 0, and it has a suspend count of 1. */
             if (j > 0)
-                STAssertNotEquals((uint64_t)0, f->pc, @"Backtrace includes NULL pc");
+                STAssertNotEquals((uint64_t)0, pcs[j], @"Backtrace includes NULL pc");
         }
     }
 
@@ -175,10 +294,13 @@
     STAssertTrue(strcmp(exception->name, "TestException") == 0, @"Exception name was not correctly serialized");
     STAssertTrue(strcmp(exception->reason, "TestReason") == 0, @"Exception reason was not correctly serialized");
 
-    STAssertTrue(exception->n_frames, @"0 exception frames were written");
-    for (int i = 0; i < exception->n_frames; i++) {
-        Plcrash__CrashReport__Thread__StackFrame *f = exception->frames[i];
-        STAssertNotEquals((uint64_t)0, f->pc, @"Backtrace includes NULL pc");
+    STAssertTrue(exception->has_pcs, @"0 exception frames were written");
+
+    uint64_t pcs[512];
+    ssize_t frame_count = decode_packed_pcs(&exception->pcs, pcs, sizeof(pcs) / sizeof(pcs[0]));
+    STAssertTrue(frame_count > 0, @"Invalid or empty packed exception backtrace");
+    for (int i = 0; i < frame_count; i++) {
+        STAssertNotEquals((uint64_t)0, pcs[i], @"Backtrace includes NULL pc");
     }
 }
 
@@ -209,6 +331,7 @@
 
     /* Initialize a writer */
     STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    STAssertNotNULL(writer.static_sections.data, @"Static report sections were not pre-encoded");
 
     /* Set an exception with a valid return address call stack. */
     NSException *e;
@@ -274,4 +397,380 @@
     plcrash_async_file_close(&file);
 }
 
+/* Verify that the report is truncated to fit the output limit, while retaining the required sections */
+- (void) testWriteReportWithSizeLimit {
+    siginfo_t info;
+    plframe_cursor_t cursor;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+    size_t size = 1024 * 1024;
+    uint8_t *buffer = malloc(size);
+    const size_t header_len = sizeof(struct PLCrashReportFileHeader);
+    uint64_t pcs[512];
+
+    /* Initialze faux crash data */
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_cursor_thread_init(&cursor, pthread_mach_thread_np(_thr_args.thread));
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+
+    NSException *e;
+    @try {
+        [NSException raise: @"TestException" format: @"TestReason"];
+    }
+    @catch (NSException *exception) {
+        e = exception;
+    }
+    plcrash_log_writer_set_exception(&writer, e);
+
+    /* Write the report without a size limit, and determine the size of the crashed and non-crashed threads */
+    plcrash_async_file_init_mem(&file, buffer, size);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+    size_t full_len = plcrash_async_file_offset(&file);
+
+    Plcrash__CrashReport *crashReport = plcrash__crash_report__unpack(&protobuf_c_system_allocator, full_len - header_len, buffer + header_len);
+    STAssertNotNULL(crashReport, @"Could not decode crash report");
+    if (crashReport == NULL) {
+        free(buffer);
+        return;
+    }
+
+    size_t crashed_frames = 0;
+    size_t other_thread_bytes = 0;
+    for (size_t i = 0; i < crashReport->n_threads; i++) {
+        if (crashReport->threads[i]->crashed)
+            crashed_frames = decode_packed_pcs(&crashReport->threads[i]->pcs, pcs, sizeof(pcs) / sizeof(pcs[0]));
+        else
+            other_thread_bytes += protobuf_c_message_get_packed_size((ProtobufCMessage *) crashReport->threads[i]);
+    }
+    protobuf_c_message_free_unpacked((ProtobufCMessage *) crashReport, &protobuf_c_system_allocator);
+
+    /* Rewrite the report, leaving space for only half of the non-crashed thread data */
+    size_t limit = full_len - (other_thread_bytes / 2);
+    plcrash_async_file_init_mem(&file, buffer, limit);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+    STAssertTrue(plcrash_async_file_offset(&file) <= limit, @"Report exceeds the size limit");
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    /* The truncated report must be decodable, and include the signal, exception, and complete crashed thread */
+    crashReport = plcrash__crash_report__unpack(&protobuf_c_system_allocator, plcrash_async_file_offset(&file) - header_len, buffer + header_len);
+    STAssertNotNULL(crashReport, @"Could not decode truncated crash report");
+    if (crashReport != NULL) {
+        STAssertNotNULL(crashReport->signal, @"Missing signal");
+        STAssertNotNULL(crashReport->exception, @"Missing exception");
+
+        BOOL foundCrashed = NO;
+        for (size_t i = 0; i < crashReport->n_threads; i++) {
+            if (!crashReport->threads[i]->crashed)
+                continue;
+
+            foundCrashed = YES;
+            STAssertEquals(crashed_frames, (size_t) decode_packed_pcs(&crashReport->threads[i]->pcs, pcs, sizeof(pcs) / sizeof(pcs[0])), @"Crashed thread was truncated");
+        }
+        STAssertTrue(foundCrashed, @"Missing crashed thread");
+
+        protobuf_c_message_free_unpacked((ProtobufCMessage *) crashReport, &protobuf_c_system_allocator);
+    }
+
+    free(buffer);
+}
+
+/* Verify that image-relative frames only reference the binary images written to the report, when image records are
+ * omitted to fit the output limit */
+- (void) testImageRelativeFramesWithOmittedImages {
+    siginfo_t info;
+    plframe_cursor_t cursor;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+    size_t size = 1024 * 1024;
+    uint8_t *buffer = malloc(size);
+    const size_t header_len = sizeof(struct PLCrashReportFileHeader);
+    uint64_t pcs[512];
+
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_cursor_thread_init(&cursor, pthread_mach_thread_np(_thr_args.thread));
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    plcrash_log_writer_set_options(&writer, PLCRASH_LOG_WRITER_OPTION_IMAGE_RELATIVE_FRAMES);
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++)
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+
+    NSException *e;
+    @try {
+        [NSException raise: @"TestException" format: @"TestReason"];
+    }
+    @catch (NSException *exception) {
+        e = exception;
+    }
+    plcrash_log_writer_set_exception(&writer, e);
+
+    /* Write the report without a size limit, and determine the size of the binary image and thread records */
+    plcrash_async_file_init_mem(&file, buffer, size);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+    size_t full_len = plcrash_async_file_offset(&file);
+
+    Plcrash__CrashReport *crashReport = plcrash__crash_report__unpack(&protobuf_c_system_allocator, full_len - header_len, buffer + header_len);
+    STAssertNotNULL(crashReport, @"Could not decode crash report");
+    if (crashReport == NULL) {
+        plcrash_log_writer_free(&writer);
+        free(buffer);
+        return;
+    }
+
+    size_t full_image_count = crashReport->n_binary_images;
+    size_t image_bytes = 0;
+    size_t thread_bytes = 0;
+    for (size_t i = 0; i < crashReport->n_binary_images; i++)
+        image_bytes += protobuf_c_message_get_packed_size((ProtobufCMessage *) crashReport->binary_images[i]);
+    for (size_t i = 0; i < crashReport->n_threads; i++)
+        thread_bytes += protobuf_c_message_get_packed_size((ProtobufCMessage *) crashReport->threads[i]);
+    protobuf_c_message_free_unpacked((ProtobufCMessage *) crashReport, &protobuf_c_system_allocator);
+
+    /* Rewrite the report, leaving space for only half of the binary image records */
+    size_t limit = full_len - thread_bytes - (image_bytes / 2);
+    plcrash_async_file_init_mem(&file, buffer, limit);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    /* The exception's frames must decode against the binary images that were written */
+    crashReport = plcrash__crash_report__unpack(&protobuf_c_system_allocator, plcrash_async_file_offset(&file) - header_len, buffer + header_len);
+    STAssertNotNULL(crashReport, @"Could not decode truncated crash report");
+    if (crashReport != NULL) {
+        NSArray *callstack = [e callStackReturnAddresses];
+
+        STAssertTrue(crashReport->n_binary_images < full_image_count, @"No binary images were omitted");
+        STAssertNotNULL(crashReport->exception, @"Missing exception");
+        STAssertTrue(crashReport->exception->has_image_relative_pcs, @"Missing exception frames");
+
+        ssize_t frame_count = decode_relative_pcs(&crashReport->exception->image_relative_pcs, crashReport, pcs, sizeof(pcs) / sizeof(pcs[0]));
+        STAssertEquals((ssize_t) [callstack count], frame_count, @"Invalid exception frames");
+        for (ssize_t i = 0; i < frame_count && i < (ssize_t) [callstack count]; i++)
+            STAssertEquals([[callstack objectAtIndex: i] unsignedLongLongValue], pcs[i], @"Incorrect frame %zd", i);
+
+        protobuf_c_message_free_unpacked((ProtobufCMessage *) crashReport, &protobuf_c_system_allocator);
+    }
+
+    free(buffer);
+}
+
+/* Verify that only the binary images referenced by the report's backtraces are written */
+- (void) testWriteReferencedImages {
+    siginfo_t info;
+    plframe_cursor_t cursor;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+    size_t size = 1024 * 1024;
+    uint8_t *buffer = malloc(size);
+    const size_t header_len = sizeof(struct PLCrashReportFileHeader);
+    uint64_t pcs[512];
+
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_cursor_thread_init(&cursor, pthread_mach_thread_np(_thr_args.thread));
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    plcrash_log_writer_set_options(&writer, PLCRASH_LOG_WRITER_OPTION_IMAGE_RELATIVE_FRAMES);
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++)
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+
+    plcrash_async_file_init_mem(&file, buffer, size);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    Plcrash__CrashReport *crashReport = plcrash__crash_report__unpack(&protobuf_c_system_allocator,
+                                                                      plcrash_async_file_offset(&file) - header_len, buffer + header_len);
+    STAssertNotNULL(crashReport, @"Could not decode crash report");
+    if (crashReport != NULL) {
+        STAssertTrue(crashReport->n_binary_images > 0, @"No binary images were written");
+        STAssertTrue(crashReport->n_binary_images < image_count, @"Unreferenced binary images were written");
+
+        /* Every written image must contain at least one frame */
+        BOOL *referenced = calloc(crashReport->n_binary_images, sizeof(BOOL));
+        for (size_t i = 0; i < crashReport->n_threads; i++) {
+            Plcrash__CrashReport__Thread *thread = crashReport->threads[i];
+            if (!thread->has_image_relative_pcs)
+                continue;
+
+            ssize_t frame_count = decode_relative_pcs(&thread->image_relative_pcs, crashReport, pcs, sizeof(pcs) / sizeof(pcs[0]));
+            STAssertTrue(frame_count > 0, @"Invalid or empty backtrace for thread %u", thread->thread_number);
+
+            for (ssize_t j = 0; j < frame_count; j++) {
+                for (size_t k = 0; k < crashReport->n_binary_images; k++) {
+                    Plcrash__CrashReport__BinaryImage *image = crashReport->binary_images[k];
+                    if (pcs[j] >= image->base_address && pcs[j] - image->base_address < image->size)
+                        referenced[k] = YES;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < crashReport->n_binary_images; i++)
+            STAssertTrue(referenced[i], @"Binary image %s is not referenced by any frame", crashReport->binary_images[i]->name);
+
+        free(referenced);
+        protobuf_c_message_free_unpacked((ProtobufCMessage *) crashReport, &protobuf_c_system_allocator);
+    }
+
+    free(buffer);
+}
+
+/* Verify that every thread is captured with a backtrace, and that all threads are resumed once the report is written */
+- (void) testSnapshotThreads {
+    siginfo_t info;
+    plframe_cursor_t cursor;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+    size_t size = 1024 * 1024;
+    uint8_t *buffer = malloc(size);
+    const size_t header_len = sizeof(struct PLCrashReportFileHeader);
+    plframe_test_thead_t deep_threads[4];
+    spinning_counter_t counter;
+    pthread_t counter_thread;
+
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_cursor_thread_init(&cursor, pthread_mach_thread_np(_thr_args.thread));
+
+    /* Additional threads: a spinning counter, and several threads of varying stack depth */
+    counter.stop = false;
+    counter.count = 0;
+    STAssertEquals(0, pthread_create(&counter_thread, NULL, spinning_counter_thread, &counter), @"Could not create counter thread");
+    for (uint32_t i = 0; i < sizeof(deep_threads) / sizeof(deep_threads[0]); i++)
+        plframe_test_thread_spawn_depth(&deep_threads[i], 16 * (i + 1));
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+
+    plcrash_async_file_init_mem(&file, buffer, size);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+
+    /* All threads must have been resumed */
+    {
+        thread_act_array_t threads;
+        mach_msg_type_number_t thread_count;
+
+        STAssertEquals(KERN_SUCCESS, task_threads(mach_task_self(), &threads, &thread_count), @"Could not fetch threads");
+        for (mach_msg_type_number_t i = 0; i < thread_count; i++) {
+            struct thread_basic_info basic_info;
+            mach_msg_type_number_t info_count = THREAD_BASIC_INFO_COUNT;
+
+            STAssertEquals(KERN_SUCCESS, thread_info(threads[i], THREAD_BASIC_INFO, (thread_info_t) &basic_info, &info_count),
+                           @"Could not fetch thread info");
+            STAssertEquals(0, basic_info.suspend_count, @"Thread %u was not resumed", i);
+
+            mach_port_deallocate(mach_task_self(), threads[i]);
+        }
+        vm_deallocate(mach_task_self(), (vm_address_t) threads, sizeof(thread_t) * thread_count);
+    }
+
+    /* The counter thread must continue to run */
+    uint64_t count = counter.count;
+    usleep(10000);
+    STAssertTrue(counter.count > count, @"Counter thread was not resumed");
+
+    counter.stop = true;
+    pthread_join(counter_thread, NULL);
+    for (uint32_t i = 0; i < sizeof(deep_threads) / sizeof(deep_threads[0]); i++)
+        plframe_test_thread_stop(&deep_threads[i]);
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    /* Every non-crashed thread must have a backtrace, either written directly or interned */
+    Plcrash__CrashReport *crashReport = plcrash__crash_report__unpack(&protobuf_c_system_allocator,
+                                                                      plcrash_async_file_offset(&file) - header_len, buffer + header_len);
+    STAssertNotNULL(crashReport, @"Could not decode crash report");
+    if (crashReport != NULL) {
+        /* The main, test, counter, and deep threads must all be present */
+        STAssertTrue(crashReport->n_threads >= 7, @"Missing threads (%zu written)", crashReport->n_threads);
+
+        for (size_t i = 0; i < crashReport->n_threads; i++) {
+            Plcrash__CrashReport__Thread *thread = crashReport->threads[i];
+            if (thread->crashed)
+                continue;
+
+            if (thread->has_interned_stack) {
+                STAssertTrue(crashReport->threads[thread->interned_stack]->has_pcs, @"Thread %u references an empty backtrace", thread->thread_number);
+            } else {
+                uint64_t pcs[512];
+                STAssertTrue(thread->has_pcs, @"Thread %u has no backtrace", thread->thread_number);
+                STAssertTrue(decode_packed_pcs(&thread->pcs, pcs, sizeof(pcs) / sizeof(pcs[0])) > 0, @"Thread %u has an empty backtrace",
+                             thread->thread_number);
+            }
+        }
+
+        protobuf_c_message_free_unpacked((ProtobufCMessage *) crashReport, &protobuf_c_system_allocator);
+    }
+
+    free(buffer);
+}
+
+/* Measure the longest time for which another thread is suspended while writing a crash report. Results are logged. */
+- (void) testSuspensionTimeBenchmark {
+    siginfo_t info;
+    plframe_cursor_t cursor;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+    size_t size = 1024 * 1024;
+    uint8_t *buffer = malloc(size);
+    suspension_monitor_t monitor;
+    mach_timebase_info_data_t timebase;
+    pthread_t thread;
+    uint64_t max_gap = 0;
+    uint64_t total_gap = 0;
+    const int iterations = 20;
+
+    mach_timebase_info(&timebase);
+
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_cursor_thread_init(&cursor, pthread_mach_thread_np(_thr_args.thread));
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++)
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+
+    monitor.stop = false;
+    monitor.max_gap = 0;
+    STAssertEquals(0, pthread_create(&thread, NULL, suspension_monitor_thread, &monitor), @"Could not create monitor thread");
+
+    for (int i = 0; i < iterations; i++) {
+        /* Allow the monitor thread to run prior to each measurement */
+        usleep(1000);
+        monitor.max_gap = 0;
+
+        plcrash_async_file_init_mem(&file, buffer, size);
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+
+        uint64_t gap = monitor.max_gap * timebase.numer / timebase.denom;
+        total_gap += gap;
+        if (gap > max_gap)
+            max_gap = gap;
+    }
+
+    monitor.stop = true;
+    pthread_join(thread, NULL);
+
+    NSLog(@"Thread suspension while writing %d reports: %.1f us average, %.1f us maximum", iterations,
+          (double) total_gap / iterations / 1000, (double) max_gap / 1000);
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+    free(buffer);
+}
+
 @end
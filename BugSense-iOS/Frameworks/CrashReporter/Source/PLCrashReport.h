@@ -26,6 +26,9 @@
  * OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#import <stdint.h>
+
+#ifdef __OBJC__
 #import <Foundation/Foundation.h>
 #import "PLCrashReportSystemInfo.h"
 #import "PLCrashReportMachineInfo.h"
@@ -35,6 +38,7 @@
 #import "PLCrashReportThreadInfo.h"
 #import "PLCrashReportBinaryImageInfo.h"
 #import "PLCrashReportExceptionInfo.h"
+#endif /* __OBJC__ */
 
 /** 
  * @ingroup constants
@@ -47,6 +51,12 @@
  * an entirely new crash log format. */
 #define PLCRASH_REPORT_FILE_VERSION 1
 
+/**
+ * @ingroup constants
+ * Compressed crash format version byte identifier. The file header is followed by the 4 byte little-endian
+ * length of the uncompressed crash log message, and the LZ4 block-format compressed message. */
+#define PLCRASH_REPORT_FILE_VERSION_COMPRESSED 2
+
 /**
  * @ingroup types
  * Crash log file header format.
@@ -67,6 +77,26 @@ struct PLCrashReportFileHeader {
     const uint8_t data[];
 } __attribute__((packed));
 
+#ifdef __OBJC__
+
+/**
+ * @ingroup enums
+ * Crash report decoding options.
+ */
+typedef enum {
+    /** Decode all report sections when the report is initialized. */
+    PLCrashReportDecodingOptionNone = 0,
+
+    /**
+     * Defer decoding of the thread, binary image, and exception sections until the corresponding
+     * property is first accessed. Large reports become readable sooner, and sections that are never
+     * accessed are never materialized as Objective-C objects.
+     *
+     * Only the section header fields are validated at initialization; if a deferred section is found
+     * to be invalid when it is accessed, its property will return nil.
+     */
+    PLCrashReportDecodingOptionLazy = 1 << 0,
+} PLCrashReportDecodingOptions;
 
 /**
  * @internal
@@ -102,9 +132,13 @@ typedef struct _PLCrashReportDecoder _PLCrashReportDecoder;
 
     /** Exception information (may be nil) */
     PLCrashReportExceptionInfo *_exceptionInfo;
+
+    /** Sections that have not yet been decoded (lazy decoding only) */
+    uint32_t _pendingSections;
 }
 
 - (id) initWithData: (NSData *) encodedData error: (NSError **) outError;
+- (id) initWithData: (NSData *) encodedData options: (PLCrashReportDecodingOptions) options error: (NSError **) outError;
 
 - (PLCrashReportBinaryImageInfo *) imageForAddress: (uint64_t) address;
 
@@ -167,3 +201,5 @@ typedef struct _PLCrashReportDecoder _PLCrashReportDecoder;
 @property(nonatomic, readonly) PLCrashReportExceptionInfo *exceptionInfo;
 
 @end
+
+#endif /* __OBJC__ */
@@ -30,6 +30,7 @@
 #import "CrashReporter.h"
 
 #import "crash_report.pb-c.h"
+#import "PLCrashAsyncCompress.h"
 
 struct _PLCrashReportDecoder {
     Plcrash__CrashReport *crashReport;
@@ -37,6 +38,21 @@ struct _PLCrashReportDecoder {
 
 #define IMAGE_UUID_DIGEST_LEN 16
 
+/**
+ * @internal
+ * Report sections that may be decoded on first access (see PLCrashReportDecodingOptionLazy).
+ */
+enum {
+    /** Thread info has not been decoded */
+    PLCRASH_REPORT_SECTION_THREADS = 1 << 0,
+
+    /** Binary image info has not been decoded */
+    PLCRASH_REPORT_SECTION_IMAGES = 1 << 1,
+
+    /** Exception info has not been decoded */
+    PLCRASH_REPORT_SECTION_EXCEPTION = 1 << 2,
+};
+
 @interface PLCrashReport (PrivateMethods)
 
 - (Plcrash__CrashReport *) decodeCrashData: (NSData *) data error: (NSError **) outError;
@@ -45,6 +61,11 @@ struct _PLCrashReportDecoder {
 - (PLCrashReportMachineInfo *) extractMachineInfo: (Plcrash__CrashReport__MachineInfo *) machineInfo error: (NSError **) outError;
 - (PLCrashReportApplicationInfo *) extractApplicationInfo: (Plcrash__CrashReport__ApplicationInfo *) applicationInfo error: (NSError **) outError;
 - (PLCrashReportProcessInfo *) extractProcessInfo: (Plcrash__CrashReport__ProcessInfo *) processInfo error: (NSError **) outError;
+- (NSMutableArray *) extractStackFrames: (Plcrash__CrashReport__Thread__StackFrame **) stackFrames
+                                  count: (size_t) frameCount
+                              packedPCs: (ProtobufCBinaryData *) pcs
+                       imageRelativePCs: (ProtobufCBinaryData *) relativePCs
+                                  error: (NSError **) outError;
 - (NSArray *) extractThreadInfo: (Plcrash__CrashReport *) crashReport error: (NSError **) outError;
 - (NSArray *) extractImageInfo: (Plcrash__CrashReport *) crashReport error: (NSError **) outError;
 - (PLCrashReportExceptionInfo *) extractExceptionInfo: (Plcrash__CrashReport__Exception *) exceptionInfo error: (NSError **) outError;
@@ -54,6 +75,8 @@ struct _PLCrashReportDecoder {
 
 
 static void populate_nserror (NSError **error, PLCrashReporterError code, NSString *description);
+static bool decode_varint (const ProtobufCBinaryData *data, size_t *offset, uint64_t *value);
+static NSString * const *register_set_names (Plcrash__CrashReport__Thread__RegisterSet registerSet, size_t *count);
 
 /**
  * Provides decoding of crash logs generated by the PLCrashReporter framework.
@@ -62,11 +85,28 @@ static void populate_nserror (NSError **error, PLCrashReporterError code, NSStri
  */
 @implementation PLCrashReport
 
+/**
+ * Initialize with the provided crash log data, decoding all report sections. On error, nil will
+ * be returned, and an NSError instance will be provided via @a error, if non-NULL.
+ *
+ * @param encodedData Encoded plcrash crash log.
+ * @param outError If an error occurs, this pointer will contain an NSError object
+ * indicating why the crash log could not be parsed. If no error occurs, this parameter
+ * will be left unmodified. You may specify NULL for this parameter, and no error information
+ * will be provided.
+ */
+- (id) initWithData: (NSData *) encodedData error: (NSError **) outError {
+    return [self initWithData: encodedData options: PLCrashReportDecodingOptionNone error: outError];
+}
+
 /**
  * Initialize with the provided crash log data. On error, nil will be returned, and
  * an NSError instance will be provided via @a error, if non-NULL.
  *
  * @param encodedData Encoded plcrash crash log.
+ * @param options Decoding options. If PLCrashReportDecodingOptionLazy is specified, the thread,
+ * binary image and exception sections are decoded on first access, and errors in those sections
+ * are not reported here.
  * @param outError If an error occurs, this pointer will contain an NSError object
  * indicating why the crash log could not be parsed. If no error occurs, this parameter
  * will be left unmodified. You may specify NULL for this parameter, and no error information
@@ -75,7 +115,7 @@ static void populate_nserror (NSError **error, PLCrashReporterError code, NSStri
  * @par Designated Initializer
  * This method is the designated initializer for the PLCrashReport class.
  */
-- (id) initWithData: (NSData *) encodedData error: (NSError **) outError {
+- (id) initWithData: (NSData *) encodedData options: (PLCrashReportDecodingOptions) options error: (NSError **) outError {
     if ((self = [super init]) == nil) {
         // This shouldn't happen, but we have to fufill our API contract
         populate_nserror(outError, PLCrashReporterErrorUnknown, @"Could not initialize superclass");
@@ -122,6 +162,15 @@ static void populate_nserror (NSError **error, PLCrashReporterError code, NSStri
     if (!_signalInfo)
         goto error;
 
+    /* Defer the remaining (and largest) sections until they are first accessed */
+    if (options & PLCrashReportDecodingOptionLazy) {
+        _pendingSections = PLCRASH_REPORT_SECTION_THREADS | PLCRASH_REPORT_SECTION_IMAGES;
+        if (_decoder->crashReport->exception != NULL)
+            _pendingSections |= PLCRASH_REPORT_SECTION_EXCEPTION;
+
+        return self;
+    }
+
     /* Thread info */
     _threads = [[self extractThreadInfo: _decoder->crashReport error: outError] retain];
     if (!_threads)
@@ -201,19 +250,53 @@ error:
 
 // property getter. Returns YES if exception information is available.
 - (BOOL) hasExceptionInfo {
-    if (_exceptionInfo != nil)
+    /* Consult the decoded message directly; the exception section may not have been decoded yet */
+    if (_decoder->crashReport->exception != NULL)
         return YES;
     return NO;
 }
 
+// property getter. Decodes the thread section on first access when lazy decoding is enabled.
+- (NSArray *) threads {
+    @synchronized (self) {
+        if (_pendingSections & PLCRASH_REPORT_SECTION_THREADS) {
+            _threads = [[self extractThreadInfo: _decoder->crashReport error: NULL] retain];
+            _pendingSections &= ~PLCRASH_REPORT_SECTION_THREADS;
+        }
+    }
+
+    return _threads;
+}
+
+// property getter. Decodes the binary image section on first access when lazy decoding is enabled.
+- (NSArray *) images {
+    @synchronized (self) {
+        if (_pendingSections & PLCRASH_REPORT_SECTION_IMAGES) {
+            _images = [[self extractImageInfo: _decoder->crashReport error: NULL] retain];
+            _pendingSections &= ~PLCRASH_REPORT_SECTION_IMAGES;
+        }
+    }
+
+    return _images;
+}
+
+// property getter. Decodes the exception section on first access when lazy decoding is enabled.
+- (PLCrashReportExceptionInfo *) exceptionInfo {
+    @synchronized (self) {
+        if (_pendingSections & PLCRASH_REPORT_SECTION_EXCEPTION) {
+            _exceptionInfo = [[self extractExceptionInfo: _decoder->crashReport->exception error: NULL] retain];
+            _pendingSections &= ~PLCRASH_REPORT_SECTION_EXCEPTION;
+        }
+    }
+
+    return _exceptionInfo;
+}
+
 @synthesize systemInfo = _systemInfo;
 @synthesize machineInfo = _machineInfo;
 @synthesize applicationInfo = _applicationInfo;
 @synthesize processInfo = _processInfo;
 @synthesize signalInfo = _signalInfo;
-@synthesize threads = _threads;
-@synthesize images = _images;
-@synthesize exceptionInfo = _exceptionInfo;
 
 @end
 
@@ -251,14 +334,48 @@ error:
         return NULL;
     }
 
-    /* Check the version */
-    if(header->version != PLCRASH_REPORT_FILE_VERSION) {
+    /* Decompress compressed crash logs */
+    const uint8_t *message = header->data;
+    size_t message_len = [data length] - sizeof(struct PLCrashReportFileHeader);
+    uint8_t *decompressed = NULL;
+
+    if (header->version == PLCRASH_REPORT_FILE_VERSION_COMPRESSED) {
+        size_t length;
+        size_t decoded_len;
+
+        /* Fetch the little-endian uncompressed length. Each compressed byte may decode to no more than 255 bytes. */
+        if (message_len < 4) {
+            populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, NSLocalizedString(@"Could not decode truncated crash log",
+                                                                                                 @"Crash log decoding error message"));
+            return NULL;
+        }
+        length = message[0] | (message[1] << 8) | (message[2] << 16) | ((size_t) message[3] << 24);
+        message += 4;
+        message_len -= 4;
+
+        if (length / 255 > message_len || (decompressed = malloc(length)) == NULL ||
+            plcrash_async_lz_decompress(message, message_len, decompressed, length, &decoded_len) != PLCRASH_ESUCCESS ||
+            decoded_len != length)
+        {
+            free(decompressed);
+            populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, NSLocalizedString(@"Could not decompress the crash report",
+                                                                                                 @"Crash log decoding error message"));
+            return NULL;
+        }
+
+        message = decompressed;
+        message_len = length;
+
+    } else if (header->version != PLCRASH_REPORT_FILE_VERSION) {
         populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, [NSString stringWithFormat: NSLocalizedString(@"Could not decode unsupported crash report version: %d", 
                                                                                                                          @"Crash log decoding message"), header->version]);
         return NULL;
     }
 
-    Plcrash__CrashReport *crashReport = plcrash__crash_report__unpack(&protobuf_c_system_allocator, [data length] - sizeof(struct PLCrashReportFileHeader), header->data);
+    /* The decoded message does not reference the input data; the decompressed data may be released immediately. */
+    Plcrash__CrashReport *crashReport = plcrash__crash_report__unpack(&protobuf_c_system_allocator, message_len, message);
+    free(decompressed);
+
     if (crashReport == NULL) {
         populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, NSLocalizedString(@"An unknown error occured decoding the crash report", 
                                                                                              @"Crash log decoding error message"));
@@ -452,6 +569,89 @@ error:
     return [[[PLCrashReportStackFrameInfo alloc] initWithInstructionPointer: stackFrame->pc] autorelease];
 }
 
+/**
+ * Extract a backtrace from the crash log, decoding the StackFrame message encoding, the packed pcs encoding,
+ * and the image-relative encoding. Returns nil on error, or an array of PLCrashReportStackFrameInfo instances
+ * on success.
+ *
+ * @param stackFrames StackFrame messages.
+ * @param frameCount The number of StackFrame messages.
+ * @param pcs Packed instruction pointer data, or NULL if none.
+ * @param relativePCs Packed image-relative instruction pointer data, or NULL if none.
+ * @param outError A pointer to an NSError object variable. If an error occurs, this pointer will contain an error
+ * object indicating why the frames could not be decoded.
+ */
+- (NSMutableArray *) extractStackFrames: (Plcrash__CrashReport__Thread__StackFrame **) stackFrames
+                                  count: (size_t) frameCount
+                              packedPCs: (ProtobufCBinaryData *) pcs
+                       imageRelativePCs: (ProtobufCBinaryData *) relativePCs
+                                  error: (NSError **) outError
+{
+    Plcrash__CrashReport *crashReport = _decoder->crashReport;
+    NSMutableArray *frames = [NSMutableArray arrayWithCapacity: frameCount];
+    uint64_t *lastPC;
+    size_t offset;
+    uint64_t pc;
+
+    /* Legacy StackFrame messages */
+    for (size_t frame_idx = 0; frame_idx < frameCount; frame_idx++) {
+        PLCrashReportStackFrameInfo *frameInfo = [self extractStackFrameInfo: stackFrames[frame_idx] error: outError];
+        if (frameInfo == nil)
+            return nil;
+
+        [frames addObject: frameInfo];
+    }
+
+    /* Packed repeated uint64 values */
+    offset = 0;
+    while (pcs != NULL && offset < pcs->len) {
+        if (!decode_varint(pcs, &offset, &pc))
+            goto invalid;
+
+        [frames addObject: [[[PLCrashReportStackFrameInfo alloc] initWithInstructionPointer: pc] autorelease]];
+    }
+
+    /* Image-relative (image, delta) pairs */
+    if (relativePCs == NULL || relativePCs->len == 0)
+        return frames;
+
+    lastPC = [[NSMutableData dataWithLength: sizeof(uint64_t) * crashReport->n_binary_images] mutableBytes];
+
+    /* Each image's first frame is relative to the image's base address */
+    for (size_t i = 0; i < crashReport->n_binary_images; i++)
+        lastPC[i] = crashReport->binary_images[i]->base_address;
+
+    offset = 0;
+    while (offset < relativePCs->len) {
+        uint64_t image;
+        uint64_t delta;
+
+        if (!decode_varint(relativePCs, &offset, &image) || !decode_varint(relativePCs, &offset, &delta))
+            goto invalid;
+
+        if (image == 0) {
+            /* Absolute value */
+            pc = delta;
+        } else if (image <= crashReport->n_binary_images) {
+            /* Zigzag-encoded delta */
+            pc = lastPC[image - 1] + ((delta >> 1) ^ -(delta & 1));
+            lastPC[image - 1] = pc;
+        } else {
+            goto invalid;
+        }
+
+        [frames addObject: [[[PLCrashReportStackFrameInfo alloc] initWithInstructionPointer: pc] autorelease]];
+    }
+
+    return frames;
+
+invalid:
+    populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid,
+                     NSLocalizedString(@"Crash report contains invalid packed stack frame data",
+                                       @"Invalid packed frame data in crash report"));
+    return nil;
+}
+
 /**
  * Extract thread information from the crash log. Returns nil on error, or an array of PLCrashLogThreadInfo
  * instances on success.
@@ -471,14 +671,30 @@ error:
         Plcrash__CrashReport__Thread *thread = crashReport->threads[thr_idx];
         
         /* Fetch stack frames for this thread */
-        NSMutableArray *frames = [NSMutableArray arrayWithCapacity: thread->n_frames];
-        for (size_t frame_idx = 0; frame_idx < thread->n_frames; frame_idx++) {
-            Plcrash__CrashReport__Thread__StackFrame *frame = thread->frames[frame_idx];
-            PLCrashReportStackFrameInfo *frameInfo = [self extractStackFrameInfo: frame error: outError];
-            if (frameInfo == nil)
-                return nil;
+        NSArray *frames = nil;
+        if (thread->has_interned_stack) {
+            /* Share the frames of the earlier thread with an identical backtrace */
+            for (PLCrashReportThreadInfo *interned in threadResult) {
+                if (interned.threadNumber == thread->interned_stack) {
+                    frames = interned.stackFrames;
+                    break;
+                }
+            }
 
-            [frames addObject: frameInfo];
+            if (frames == nil) {
+                populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid,
+                                 NSLocalizedString(@"Crash report references an unknown thread backtrace",
+                                                   @"Invalid interned backtrace in crash report"));
+                return nil;
+            }
+        } else {
+            frames = [self extractStackFrames: thread->frames
+                                        count: thread->n_frames
+                                    packedPCs: thread->has_pcs ? &thread->pcs : NULL
+                             imageRelativePCs: thread->has_image_relative_pcs ? &thread->image_relative_pcs : NULL
+                                        error: outError];
+            if (frames == nil)
+                return nil;
         }
 
         /* Fetch registers for this thread */
@@ -498,6 +714,32 @@ error:
             [registers addObject: regInfo];
         }
 
+        /* Packed register values, named according to their register set */
+        if (thread->has_register_values) {
+            NSString * const *names = NULL;
+            size_t nameCount = 0;
+            size_t offset = 0;
+            uint64_t value;
+
+            if (thread->has_register_set)
+                names = register_set_names(thread->register_set, &nameCount);
+
+            if (names == NULL) {
+                populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, @"Unknown register set in register values");
+                return nil;
+            }
+
+            for (size_t reg_idx = 0; offset < thread->register_values.len; reg_idx++) {
+                if (reg_idx == nameCount || !decode_varint(&thread->register_values, &offset, &value)) {
+                    populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, @"Invalid packed register values");
+                    return nil;
+                }
+
+                [registers addObject: [[[PLCrashReportRegisterInfo alloc] initWithRegisterName: names[reg_idx]
+                                                                                registerValue: value] autorelease]];
+            }
+        }
+
         /* Create the thread info instance */
         PLCrashReportThreadInfo *threadInfo = [[[PLCrashReportThreadInfo alloc] initWithThreadNumber: thread->thread_number
                                                                                    stackFrames: frames 
@@ -596,20 +838,15 @@ error:
     NSString *reason = [NSString stringWithUTF8String: exceptionInfo->reason];
     
     /* Fetch stack frames for this thread */
-    NSMutableArray *frames = nil;
-    if (exceptionInfo->n_frames > 0) {
-        frames = [NSMutableArray arrayWithCapacity: exceptionInfo->n_frames];
-        for (size_t frame_idx = 0; frame_idx < exceptionInfo->n_frames; frame_idx++) {
-            Plcrash__CrashReport__Thread__StackFrame *frame = exceptionInfo->frames[frame_idx];
-            PLCrashReportStackFrameInfo *frameInfo = [self extractStackFrameInfo: frame error: outError];
-            if (frameInfo == nil)
-                return nil;
-            
-            [frames addObject: frameInfo];
-        }
-    }
+    NSMutableArray *frames = [self extractStackFrames: exceptionInfo->frames
+                                                count: exceptionInfo->n_frames
+                                            packedPCs: exceptionInfo->has_pcs ? &exceptionInfo->pcs : NULL
+                                     imageRelativePCs: exceptionInfo->has_image_relative_pcs ? &exceptionInfo->image_relative_pcs : NULL
+                                                error: outError];
+    if (frames == nil)
+        return nil;
 
-    if (frames == nil) {
+    if ([frames count] == 0) {
         return [[[PLCrashReportExceptionInfo alloc] initWithExceptionName: name reason: reason] autorelease];
     } else {
         return [[[PLCrashReportExceptionInfo alloc] initWithExceptionName: name
@@ -681,4 +918,83 @@ static void populate_nserror (NSError **error, PLCrashReporterError code, NSStri
                 ];
     
     *error = [NSError errorWithDomain: PLCrashReporterErrorDomain code: code userInfo: userInfo];
-}
\ No newline at end of file
+}
+
+/** @internal CrashReport.Thread.RegisterSet.REGISTER_SET_X86_32 register names */
+static NSString * const x86_32_register_names[] = {
+    @"eax", @"edx", @"ecx", @"ebx", @"ebp", @"esi", @"edi", @"esp", @"eip", @"eflags", @"trapno", @"cs", @"ds", @"es",
+    @"fs", @"gs"
+};
+
+/** @internal CrashReport.Thread.RegisterSet.REGISTER_SET_X86_64 register names */
+static NSString * const x86_64_register_names[] = {
+    @"rax", @"rbx", @"rcx", @"rdx", @"rdi", @"rsi", @"rbp", @"rsp", @"r10", @"r11", @"r12", @"r13", @"r14", @"r15",
+    @"rip", @"rflags", @"cs", @"fs", @"gs"
+};
+
+/** @internal CrashReport.Thread.RegisterSet.REGISTER_SET_ARM register names */
+static NSString * const arm_register_names[] = {
+    @"r0", @"r1", @"r2", @"r3", @"r4", @"r5", @"r6", @"r7", @"r8", @"r9", @"r10", @"r11", @"r12", @"sp", @"lr", @"pc",
+    @"cpsr"
+};
+
+/** @internal CrashReport.Thread.RegisterSet.REGISTER_SET_PPC register names */
+static NSString * const ppc_register_names[] = {
+    @"srr0", @"srr1", @"dar", @"dsisr",
+    @"r0", @"r1", @"r2", @"r3", @"r4", @"r5", @"r6", @"r7", @"r8", @"r9", @"r10", @"r11", @"r12", @"r13", @"r14", @"r15",
+    @"r16", @"r17", @"r18", @"r19", @"r20", @"r21", @"r22", @"r23", @"r24", @"r25", @"r26", @"r27", @"r28", @"r29",
+    @"r30", @"r31",
+    @"cr", @"xer", @"lr", @"ctr", @"vrsave"
+};
+
+/**
+ * @internal
+ *
+ * Return the ordered register names of @a registerSet, or NULL if the register set is unknown.
+ *
+ * @param registerSet The register set.
+ * @param count On return, the number of register names.
+ */
+static NSString * const *register_set_names (Plcrash__CrashReport__Thread__RegisterSet registerSet, size_t *count) {
+#define RETURN_NAMES(names) do { *count = sizeof(names) / sizeof(names[0]); return names; } while (0)
+    switch (registerSet) {
+        case PLCRASH__CRASH_REPORT__THREAD__REGISTER_SET__REGISTER_SET_X86_32:
+            RETURN_NAMES(x86_32_register_names);
+
+        case PLCRASH__CRASH_REPORT__THREAD__REGISTER_SET__REGISTER_SET_X86_64:
+            RETURN_NAMES(x86_64_register_names);
+
+        case PLCRASH__CRASH_REPORT__THREAD__REGISTER_SET__REGISTER_SET_ARM:
+            RETURN_NAMES(arm_register_names);
+
+        case PLCRASH__CRASH_REPORT__THREAD__REGISTER_SET__REGISTER_SET_PPC:
+            RETURN_NAMES(ppc_register_names);
+
+        default:
+            return NULL;
+    }
+#undef RETURN_NAMES
+}
+
+/**
+ * @internal
+ *
+ * Decode a varint from @a data at @a offset, advancing @a offset past the decoded value. Returns false if the
+ * varint is truncated or exceeds 64 bits.
+ */
+static bool decode_varint (const ProtobufCBinaryData *data, size_t *offset, uint64_t *value) {
+    unsigned int shift = 0;
+    uint8_t byte;
+
+    *value = 0;
+    do {
+        if (*offset == data->len || shift >= 64)
+            return false;
+
+        byte = data->data[(*offset)++];
+        *value |= ((uint64_t) (byte & 0x7F)) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    return true;
+}
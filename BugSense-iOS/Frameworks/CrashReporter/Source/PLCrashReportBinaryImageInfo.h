@@ -83,7 +83,8 @@
 @property(nonatomic, readonly) BOOL hasImageUUID;
 
 /**
- * 128-bit object UUID (matches Mach-O DWARF dSYM files). May be nil if unavailable.
+ * 128-bit object UUID (matches Mach-O DWARF dSYM files), or the GNU build-id of an ELF image. May be nil if
+ * unavailable.
  */
 @property(nonatomic, readonly) NSString *imageUUID;
 
@@ -32,8 +32,7 @@
 /**
  * @ingroup constants
  *
- * The type encodings supported for CPU types and subtypes. Currently only Apple
- * Mach-O defined encodings are supported.
+ * The type encodings supported for CPU types and subtypes.
  *
  * @internal
  * These enum values match the protobuf values. Keep them synchronized.
@@ -43,7 +42,10 @@ typedef enum {
     PLCrashReportProcessorTypeEncodingUnknown = 0,
 
     /** Apple Mach-defined processor types. */
-    PLCrashReportProcessorTypeEncodingMach = 1
+    PLCrashReportProcessorTypeEncodingMach = 1,
+
+    /** ELF-defined machine types. */
+    PLCrashReportProcessorTypeEncodingELF = 2
 } PLCrashReportProcessorTypeEncoding;
 
 @interface PLCrashReportProcessorInfo : NSObject {
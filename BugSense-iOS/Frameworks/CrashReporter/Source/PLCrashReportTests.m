@@ -37,6 +37,28 @@
 
 #import <mach-o/arch.h>
 #import <mach-o/dyld.h>
+#import <mach/mach_time.h>
+#import <malloc/malloc.h>
+#import <pthread.h>
+
+/* State of a thread that samples the heap in use, recording the peak */
+typedef struct heap_monitor {
+    volatile bool stop;
+    volatile size_t peak;
+} heap_monitor_t;
+
+static void *heap_monitor_thread (void *arg) {
+    heap_monitor_t *monitor = arg;
+
+    while (!monitor->stop) {
+        malloc_statistics_t stats;
+        malloc_zone_statistics(NULL, &stats);
+        if (stats.size_in_use > monitor->peak)
+            monitor->peak = stats.size_in_use;
+    }
+
+    return NULL;
+}
 
 @interface PLCrashReportTests : SenTestCase {
 @private
@@ -70,6 +92,43 @@
     plframe_test_thread_stop(&_thr_args);
 }
 
+/**
+ * Write a crash report for the current process to the log path, snapshotting the test thread as the
+ * crashed thread, and return the encoded report.
+ */
+- (NSData *) writeReportWithException: (NSException *) exception {
+    siginfo_t info;
+    plframe_cursor_t cursor;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_cursor_thread_init(&cursor, pthread_mach_thread_np(_thr_args.thread));
+
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_TRUNC, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    if (exception != nil)
+        plcrash_log_writer_set_exception(&writer, exception);
+
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++) {
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+    }
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    plcrash_async_file_flush(&file);
+    plcrash_async_file_close(&file);
+
+    return [NSData dataWithContentsOfFile: _logPath];
+}
+
 - (void) testWriteReport {
     siginfo_t info;
     plframe_cursor_t cursor;
@@ -186,9 +245,16 @@
         STAssertEquals((NSInteger)thrNumber, threadInfo.threadNumber, @"Threads are listed out of order.");
 
         if (threadInfo.crashed) {
-            STAssertNotEquals((NSUInteger)0, [threadInfo.registers count], @"No registers recorded for the crashed thread");
+            STAssertEquals((NSUInteger) (PLFRAME_REG_LAST + 1), [threadInfo.registers count],
+                           @"Incorrect number of registers recorded for the crashed thread");
+
+            /* The register names are supplied by the reader; verify that they match the host's register numbering */
+            plframe_regnum_t regnum = 0;
             for (PLCrashReportRegisterInfo *registerInfo in threadInfo.registers) {
                 STAssertNotNil(registerInfo.registerName, @"Register name is nil");
+                STAssertEqualStrings([NSString stringWithUTF8String: plframe_get_regname(regnum)], registerInfo.registerName,
+                                     @"Incorrect register name");
+                regnum++;
             }
             crashedFound = YES;
         }
@@ -224,5 +290,299 @@
     }
 }
 
+/* Verify that image-relative backtraces are decoded to the original instruction pointers */
+- (void) testWriteImageRelativeReport {
+    siginfo_t info;
+    plframe_cursor_t cursor;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+    NSError *error = nil;
+
+    /* Initialze faux crash data */
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_cursor_thread_init(&cursor, pthread_mach_thread_np(_thr_args.thread));
+
+    /* Open the output file */
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+
+    /* Initialize a writer with image-relative frame encoding */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    plcrash_log_writer_set_options(&writer, PLCRASH_LOG_WRITER_OPTION_IMAGE_RELATIVE_FRAMES);
+
+    NSException *exception;
+    @try {
+        [NSException raise: @"TestException" format: @"TestReason"];
+    }
+    @catch (NSException *e) {
+        exception = e;
+    }
+    plcrash_log_writer_set_exception(&writer, exception);
+
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++) {
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+    }
+
+    /* Write the crash report */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    plcrash_async_file_flush(&file);
+    plcrash_async_file_close(&file);
+
+    /* Parse it */
+    PLCrashReport *crashLog = [[[PLCrashReport alloc] initWithData: [NSData dataWithContentsOfMappedFile: _logPath] error: &error] autorelease];
+    STAssertNotNil(crashLog, @"Could not decode crash log: %@", error);
+
+    /* The exception frames must match the original call stack */
+    NSArray *callStack = [exception callStackReturnAddresses];
+    STAssertEquals([callStack count], [crashLog.exceptionInfo.stackFrames count], @"Incorrect exception frame count");
+    for (NSUInteger i = 0; i < [callStack count] && i < [crashLog.exceptionInfo.stackFrames count]; i++) {
+        NSNumber *retAddr = [callStack objectAtIndex: i];
+        PLCrashReportStackFrameInfo *sf = [crashLog.exceptionInfo.stackFrames objectAtIndex: i];
+        STAssertEquals(sf.instructionPointer, [retAddr unsignedLongLongValue], @"Stack frame address is incorrect");
+    }
+
+    /* Thread frames */
+    for (PLCrashReportThreadInfo *threadInfo in crashLog.threads)
+        STAssertNotEquals((NSUInteger)0, [threadInfo.stackFrames count], @"No frames decoded");
+}
+
+- (void) testWriteCompressedReport {
+    siginfo_t info;
+    plframe_cursor_t cursor;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+    NSError *error = nil;
+
+    /* Initialze faux crash data */
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_cursor_thread_init(&cursor, pthread_mach_thread_np(_thr_args.thread));
+
+    /* Open the output file */
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+
+    /* Initialize a writer with compression enabled */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    plcrash_log_writer_set_options(&writer, PLCRASH_LOG_WRITER_OPTION_COMPRESS);
+
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++) {
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+    }
+
+    /* Write the crash report */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    plcrash_async_file_flush(&file);
+    plcrash_async_file_close(&file);
+
+    /* Verify the header */
+    NSData *data = [NSData dataWithContentsOfMappedFile: _logPath];
+    const struct PLCrashReportFileHeader *header = [data bytes];
+    STAssertTrue([data length] > sizeof(*header) + 4, @"Crash log is truncated");
+    STAssertEquals(header->version, (uint8_t) PLCRASH_REPORT_FILE_VERSION_COMPRESSED, @"Crash log is not compressed");
+
+    uint32_t uncompressed_len = header->data[0] | (header->data[1] << 8) | (header->data[2] << 16) | (header->data[3] << 24);
+    NSLog(@"Compressed %u byte crash report to %u bytes", uncompressed_len, (unsigned int) [data length]);
+
+    /* Parse it */
+    PLCrashReport *crashLog = [[[PLCrashReport alloc] initWithData: data error: &error] autorelease];
+    STAssertNotNil(crashLog, @"Could not decode crash log: %@", error);
+
+    STAssertNotEquals((NSUInteger)0, [crashLog.images count], @"Crash log should contain at least one image");
+    for (PLCrashReportThreadInfo *threadInfo in crashLog.threads)
+        STAssertNotEquals((NSUInteger)0, [threadInfo.stackFrames count], @"No frames decoded");
+
+    /* Corrupt data must be rejected */
+    NSMutableData *corrupt = [NSMutableData dataWithData: data];
+    ((uint8_t *) [corrupt mutableBytes])[sizeof(*header)] ^= 0xFF;
+    STAssertNil([[[PLCrashReport alloc] initWithData: corrupt error: NULL] autorelease], @"Decoded corrupt crash log");
+}
+
+/* Verify that a compressed report is always decodable when written under a small output limit */
+- (void) testWriteCompressedReportWithLimit {
+    const off_t limits[] = { 4 * 1024, 16 * 1024, 32 * 1024 };
+    siginfo_t info;
+    plframe_cursor_t cursor;
+    NSError *error = nil;
+
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_cursor_thread_init(&cursor, pthread_mach_thread_np(_thr_args.thread));
+
+    for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+        plcrash_log_writer_t writer;
+        plcrash_async_file_t file;
+
+        /* Open the output file with the given limit */
+        int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_TRUNC, 0644);
+        plcrash_async_file_init(&file, fd, limits[i]);
+
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+        plcrash_log_writer_set_options(&writer, PLCRASH_LOG_WRITER_OPTION_COMPRESS);
+
+        uint32_t image_count = _dyld_image_count();
+        for (uint32_t j = 0; j < image_count; j++) {
+            plcrash_log_writer_add_image(&writer, _dyld_get_image_header(j));
+        }
+
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+        plcrash_log_writer_close(&writer);
+        plcrash_log_writer_free(&writer);
+
+        plcrash_async_file_flush(&file);
+        plcrash_async_file_close(&file);
+
+        /* The report must fit within the limit, and be decodable */
+        NSData *data = [NSData dataWithContentsOfFile: _logPath];
+        const struct PLCrashReportFileHeader *header = [data bytes];
+        STAssertTrue((off_t) [data length] <= limits[i], @"Report exceeds the output limit");
+        NSLog(@"Wrote %u byte %@ report with a %lld byte limit", (unsigned int) [data length],
+              header->version == PLCRASH_REPORT_FILE_VERSION_COMPRESSED ? @"compressed" : @"uncompressed", (long long) limits[i]);
+
+        PLCrashReport *crashLog = [[[PLCrashReport alloc] initWithData: data error: &error] autorelease];
+        STAssertNotNil(crashLog, @"Could not decode crash log with a %lld byte limit: %@", (long long) limits[i], error);
+        STAssertEqualStrings(@"SIGSEGV", crashLog.signalInfo.name, @"Signal is incorrect");
+    }
+}
+
+/* Verify that lazily decoded sections match the eagerly decoded report */
+- (void) testLazyDecoding {
+    NSException *exception = nil;
+    NSError *error = nil;
+
+    @try {
+        [NSException raise: @"TestException" format: @"TestReason"];
+    }
+    @catch (NSException *e) {
+        exception = e;
+    }
+
+    NSData *data = [self writeReportWithException: exception];
+    PLCrashReport *eager = [[[PLCrashReport alloc] initWithData: data error: &error] autorelease];
+    STAssertNotNil(eager, @"Could not decode crash log: %@", error);
+
+    PLCrashReport *lazy = [[[PLCrashReport alloc] initWithData: data options: PLCrashReportDecodingOptionLazy error: &error] autorelease];
+    STAssertNotNil(lazy, @"Could not decode crash log: %@", error);
+
+    /* The exception section is reported without being decoded */
+    STAssertTrue(lazy.hasExceptionInfo, @"Exception info should be available");
+    STAssertEqualStrings(eager.signalInfo.name, lazy.signalInfo.name, @"Signal is incorrect");
+
+    /* Sections are decoded once, on first access */
+    STAssertNotNil(lazy.threads, @"Thread list is nil");
+    STAssertTrue(lazy.threads == lazy.threads, @"Thread list was decoded more than once");
+    STAssertEquals([eager.threads count], [lazy.threads count], @"Incorrect thread count");
+    for (NSUInteger i = 0; i < [eager.threads count]; i++) {
+        PLCrashReportThreadInfo *expected = [eager.threads objectAtIndex: i];
+        PLCrashReportThreadInfo *thread = [lazy.threads objectAtIndex: i];
+
+        STAssertEquals(expected.threadNumber, thread.threadNumber, @"Incorrect thread number");
+        STAssertEquals(expected.crashed, thread.crashed, @"Incorrect crashed flag");
+        STAssertEquals([expected.stackFrames count], [thread.stackFrames count], @"Incorrect frame count");
+        STAssertEquals([expected.registers count], [thread.registers count], @"Incorrect register count");
+    }
+
+    STAssertEquals([eager.images count], [lazy.images count], @"Incorrect image count");
+    for (NSUInteger i = 0; i < [eager.images count]; i++) {
+        PLCrashReportBinaryImageInfo *expected = [eager.images objectAtIndex: i];
+        PLCrashReportBinaryImageInfo *image = [lazy.images objectAtIndex: i];
+
+        STAssertEquals(expected.imageBaseAddress, image.imageBaseAddress, @"Incorrect image base address");
+        STAssertEqualStrings(expected.imageName, image.imageName, @"Incorrect image name");
+    }
+
+    STAssertEqualStrings(eager.exceptionInfo.exceptionName, lazy.exceptionInfo.exceptionName, @"Exception name is incorrect");
+    STAssertEquals([eager.exceptionInfo.stackFrames count], [lazy.exceptionInfo.stackFrames count], @"Incorrect exception frame count");
+
+    /* A report without an exception has no exception section to decode */
+    data = [self writeReportWithException: nil];
+    lazy = [[[PLCrashReport alloc] initWithData: data options: PLCrashReportDecodingOptionLazy error: &error] autorelease];
+    STAssertNotNil(lazy, @"Could not decode crash log: %@", error);
+    STAssertFalse(lazy.hasExceptionInfo, @"Exception info should not be available");
+    STAssertNil(lazy.exceptionInfo, @"Exception info should be nil");
+}
+
+/**
+ * Benchmark eager and lazy decoding of a large report (deep stacks on many threads, and every loaded image).
+ * The time to the first field (signal info) and to the crashed thread, and the peak heap in use while decoding
+ * and reading the report, are logged, and are not validated. The peak is sampled by a monitor thread, and so
+ * may miss short-lived allocations.
+ */
+- (void) testLazyDecodingBenchmark {
+    plframe_test_thead_t threads[32];
+    const uint32_t thread_count = sizeof(threads) / sizeof(threads[0]);
+    mach_timebase_info_data_t timebase;
+    NSError *error = nil;
+
+    mach_timebase_info(&timebase);
+
+    for (uint32_t i = 0; i < thread_count; i++)
+        plframe_test_thread_spawn_depth(&threads[i], 256);
+
+    NSData *data = [self writeReportWithException: nil];
+
+    for (uint32_t i = 0; i < thread_count; i++)
+        plframe_test_thread_stop(&threads[i]);
+
+    const PLCrashReportDecodingOptions modes[] = { PLCrashReportDecodingOptionNone, PLCrashReportDecodingOptionLazy };
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        malloc_statistics_t before;
+        malloc_statistics_t after;
+        heap_monitor_t monitor;
+        pthread_t monitor_thread;
+        uint64_t first_field_ns;
+        uint64_t crashed_thread_ns;
+        uint64_t start;
+
+        malloc_zone_statistics(NULL, &before);
+        monitor.stop = false;
+        monitor.peak = before.size_in_use;
+        STAssertEquals(0, pthread_create(&monitor_thread, NULL, heap_monitor_thread, &monitor), @"Could not create monitor thread");
+
+        start = mach_absolute_time();
+
+        PLCrashReport *report = [[PLCrashReport alloc] initWithData: data options: modes[m] error: &error];
+        STAssertNotNil(report, @"Could not decode crash log: %@", error);
+        STAssertNotNil(report.signalInfo.name, @"Signal is nil");
+        first_field_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+        PLCrashReportThreadInfo *crashed = nil;
+        for (PLCrashReportThreadInfo *thread in report.threads) {
+            if (thread.crashed) {
+                crashed = thread;
+                break;
+            }
+        }
+        STAssertNotNil(crashed, @"No crashed thread was found in the crash log");
+        crashed_thread_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+        monitor.stop = true;
+        pthread_join(monitor_thread, NULL);
+        malloc_zone_statistics(NULL, &after);
+        if (after.size_in_use > monitor.peak)
+            monitor.peak = after.size_in_use;
+
+        NSLog(@"%@ decode of %u byte report: first field %8llu ns, crashed thread %8llu ns, peak %8zd bytes, %8zd bytes retained",
+              (modes[m] & PLCrashReportDecodingOptionLazy) ? @"Lazy " : @"Eager", (unsigned int) [data length],
+              (unsigned long long) first_field_ns, (unsigned long long) crashed_thread_ns,
+              (ssize_t) (monitor.peak - before.size_in_use), (ssize_t) (after.size_in_use - before.size_in_use));
+
+        [report release];
+        [pool release];
+    }
+}
 
 @end
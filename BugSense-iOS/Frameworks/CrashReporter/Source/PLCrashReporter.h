@@ -94,4 +94,10 @@ typedef struct PLCrashReporterCallbacks {
 
 - (void) setCrashCallbacks: (PLCrashReporterCallbacks *) callbacks;
 
+- (void) setCrashReportBufferSize: (size_t) size;
+
+- (void) setImageRelativeFrameEncoding: (BOOL) enabled;
+
+- (void) setCrashReportCompression: (BOOL) enabled;
+
 @end
\ No newline at end of file
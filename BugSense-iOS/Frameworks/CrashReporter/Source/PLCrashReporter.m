@@ -34,6 +34,8 @@
 #import "PLCrashLogWriter.h"
 
 #import <fcntl.h>
+#import <pthread.h>
+#import <sys/mman.h>
 #import <mach-o/dyld.h>
 
 #define NSDEBUG(msg, args...) {\
@@ -48,6 +50,11 @@ static NSString *PLCRASH_CACHE_DIR = @"com.plausiblelabs.crashreporter.data";
  * Crash Report file name. */
 static NSString *PLCRASH_LIVE_CRASHREPORT = @"live_report.plcrash";
 
+/** @internal
+ * Pre-allocated crash report output file. This is renamed to PLCRASH_LIVE_CRASHREPORT once a crash report
+ * has been written. */
+static NSString *PLCRASH_RESERVED_CRASHREPORT = @"reserved_report.plcrash";
+
 /** @internal
  * Directory containing crash reports queued for sending. */
 static NSString *PLCRASH_QUEUED_DIR = @"queued_reports";
@@ -61,6 +68,12 @@ static NSString *PLCRASH_QUEUED_DIR = @"queued_reports";
  */
 #define MAX_REPORT_BYTES (64 * 1024)
 
+/** @internal
+ * Default size of the crash report output buffer. This is sufficient to write most crash reports with a
+ * single flush.
+ */
+#define DEFAULT_OUTPUT_BUFFER_BYTES (16 * 1024)
+
 /**
  * @internal
  * Crash reporter singleton.
@@ -78,6 +91,34 @@ typedef struct signal_handler_ctx {
 
     /** Path to the output file */
     const char *path;
+
+    /** Pre-allocated, memory mapped output file. If unavailable, the output file is opened at crash time. */
+    struct {
+        /** Path to the pre-allocated file. */
+        const char *path;
+
+        /** Open file descriptor, or -1 if unavailable. */
+        int fd;
+
+        /** The MAP_SHARED file mapping, or NULL if unavailable. */
+        void *mapping;
+
+        /** The size of the mapping, in bytes. */
+        size_t size;
+    } reserved;
+
+    /** Pre-allocated output buffer, used when writing directly to the output file. Only allocated if the reserved
+     * output file is unavailable. */
+    struct {
+        /** The buffer, or NULL if unavailable. */
+        void *data;
+
+        /** The requested buffer size, in bytes. */
+        size_t size;
+    } output_buffer;
+
+    /** Crash log writer encoding options, applied when the writer is initialized. */
+    uint32_t writer_options;
 } plcrashreporter_handler_ctx_t;
 
 
@@ -86,7 +127,12 @@ typedef struct signal_handler_ctx {
  * 
  * Signal handler context (singleton)
  */
-static plcrashreporter_handler_ctx_t signal_handler_context;
+static plcrashreporter_handler_ctx_t signal_handler_context = {
+    .output_buffer = {
+        .data = NULL,
+        .size = DEFAULT_OUTPUT_BUFFER_BYTES
+    }
+};
 
 
 /**
@@ -109,15 +155,21 @@ static void signal_handler_callback (int signal, siginfo_t *info, ucontext_t *ua
     plcrashreporter_handler_ctx_t *sigctx = context;
     plcrash_async_file_t file;
 
-    /* Open the output file */
-    int fd = open(sigctx->path, O_RDWR|O_CREAT|O_TRUNC, 0644);
-    if (fd < 0) {
-        PLCF_DEBUG("Could not open the crashlog output file: %s", strerror(errno));
-        return;
-    }
+    /* Initialize the output context, preferring the pre-allocated output file */
+    if (sigctx->reserved.mapping != NULL) {
+        plcrash_async_file_init_mapped(&file, sigctx->reserved.fd, sigctx->reserved.mapping, sigctx->reserved.size);
+    } else {
+        /* Open the output file */
+        int fd = open(sigctx->path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+        if (fd < 0) {
+            PLCF_DEBUG("Could not open the crashlog output file: %s", strerror(errno));
+            return;
+        }
 
-    /* Initialize the output context */
-    plcrash_async_file_init(&file, fd, MAX_REPORT_BYTES);
+        plcrash_async_file_init(&file, fd, MAX_REPORT_BYTES);
+        if (sigctx->output_buffer.data != NULL)
+            plcrash_async_file_set_buffer(&file, sigctx->output_buffer.data, sigctx->output_buffer.size);
+    }
 
     /* Write the crash log using the already-initialized writer */
     plcrash_log_writer_write(&sigctx->writer, &file, info, uap);
@@ -127,16 +179,156 @@ static void signal_handler_callback (int signal, siginfo_t *info, ucontext_t *ua
     plcrash_async_file_flush(&file);
     plcrash_async_file_close(&file);
 
+    /* Move the completed report into place */
+    if (sigctx->reserved.mapping != NULL && rename(sigctx->reserved.path, sigctx->path) != 0)
+        PLCF_DEBUG("Could not rename the crashlog output file: %s", strerror(errno));
+
     /* Call any post-crash callback */
     if (crashCallbacks.handleSignal != NULL)
         crashCallbacks.handleSignal(info, uap, crashCallbacks.context);
 }
 
+/**
+ * @internal
+ *
+ * Create, zero-fill, and map the pre-allocated crash report output file, allowing the signal handler to write the
+ * crash report without opening a file or issuing write() calls. On failure, the signal handler will fall back
+ * to opening the output file at crash time.
+ *
+ * @param sigctx The signal handler context to be configured.
+ * @param path The pre-allocated output file path.
+ * @param size The size of the output file, in bytes.
+ *
+ * @return Returns true on success, or false if the file could not be created or mapped.
+ */
+static bool reserve_output_file (plcrashreporter_handler_ctx_t *sigctx, const char *path, size_t size) {
+    static const uint8_t zero[4096];
+    void *mapping;
+    int fd;
+
+    sigctx->reserved.path = path;
+    sigctx->reserved.fd = -1;
+    sigctx->reserved.mapping = NULL;
+    sigctx->reserved.size = 0;
+
+    fd = open(path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+    if (fd < 0) {
+        PLCF_DEBUG("Could not create the reserved crashlog output file: %s", strerror(errno));
+        return false;
+    }
+
+    /* Allocate the file's blocks up front; writing to unallocated pages of the mapping could otherwise fail
+     * with SIGBUS at crash time if the disk is full. */
+    for (size_t written = 0; written < size;) {
+        size_t len = MIN(sizeof(zero), size - written);
+        ssize_t nwritten = write(fd, zero, len);
+        if (nwritten <= 0) {
+            if (nwritten < 0 && errno == EINTR)
+                continue;
+
+            PLCF_DEBUG("Could not allocate the reserved crashlog output file: %s", strerror(errno));
+            close(fd);
+            unlink(path);
+            return false;
+        }
+        written += nwritten;
+    }
+
+    mapping = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        PLCF_DEBUG("Could not map the reserved crashlog output file: %s", strerror(errno));
+        close(fd);
+        unlink(path);
+        return false;
+    }
+
+    sigctx->reserved.fd = fd;
+    sigctx->reserved.mapping = mapping;
+    sigctx->reserved.size = size;
+
+    return true;
+}
+
+/**
+ * @internal
+ * A loaded image, as reported by dyld.
+ */
+typedef struct loaded_image {
+    /** The image's header address. */
+    const void *header;
+
+    /** The image's name. */
+    const char *name;
+
+    /** True if the image has since been unloaded. */
+    bool unloaded;
+} loaded_image_t;
+
+/**
+ * @internal
+ * The images loaded at the time image monitoring is enabled, pending registration as a single batch.
+ *
+ * dyld invokes the add callback for every loaded image from within _dyld_register_func_for_add_image(). Those
+ * invocations are skipped for the images recorded here, which are instead registered as a batch once the add callback
+ * has been registered. Until then, the remove callback removes any unloaded image from the batch.
+ */
+static struct {
+    /** Serializes the batch against the remove callback. */
+    pthread_mutex_t lock;
+
+    /** The thread registering the batch. */
+    pthread_t thread;
+
+    /** The pending images, sorted by header address, or NULL if no batch is pending. */
+    loaded_image_t *images;
+
+    /** The number of pending images. */
+    uint32_t count;
+} pending_images = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .images = NULL,
+    .count = 0
+};
+
+/**
+ * @internal
+ * Compare two loaded_image_t records by header address.
+ */
+static int loaded_image_compare (const void *a, const void *b) {
+    uintptr_t lhs = (uintptr_t) ((const loaded_image_t *) a)->header;
+    uintptr_t rhs = (uintptr_t) ((const loaded_image_t *) b)->header;
+
+    if (lhs < rhs)
+        return -1;
+    else if (lhs > rhs)
+        return 1;
+
+    return 0;
+}
+
+/**
+ * @internal
+ * Return the pending image with the given @a header address, or NULL if none.
+ */
+static loaded_image_t *pending_image_find (const void *header) {
+    loaded_image_t key = { .header = header };
+
+    if (pending_images.images == NULL)
+        return NULL;
+
+    return bsearch(&key, pending_images.images, pending_images.count, sizeof(key), loaded_image_compare);
+}
+
 /**
  * @internal
  * dyld image add notification callback.
  */
 static void image_add_callback (const struct mach_header *mh, intptr_t vmaddr_slide) {
+    /* Images pending batch registration are registered by register_loaded_images(). The batch is only accessed
+     * without the lock on the registering thread, which is the only thread that may modify it. */
+    if (pthread_equal(pending_images.thread, pthread_self()) && pending_image_find(mh) != NULL)
+        return;
+
     plcrash_log_writer_add_image(&signal_handler_context.writer, mh);
 }
 
@@ -145,7 +337,85 @@ static void image_add_callback (const struct mach_header *mh, intptr_t vmaddr_sl
  * dyld image remove notification callback.
  */
 static void image_remove_callback (const struct mach_header *mh, intptr_t vmaddr_slide) {
-    plcrash_log_writer_remove_image(&signal_handler_context.writer, mh);
+    pthread_mutex_lock(&pending_images.lock); {
+        loaded_image_t *image = pending_image_find(mh);
+        if (image != NULL)
+            image->unloaded = true;
+
+        plcrash_log_writer_remove_image(&signal_handler_context.writer, mh);
+    } pthread_mutex_unlock(&pending_images.lock);
+}
+
+/**
+ * @internal
+ * Register all currently loaded images with @a writer, and enable dyld image monitoring. The currently loaded images
+ * are registered as a single batch; their names are fetched from dyld, rather than resolved individually with dladdr().
+ *
+ * The remove callback is registered before the loaded images are enumerated, and the add callback is registered
+ * before the batch is appended; an image loaded or unloaded at any point during registration is thus neither missed
+ * nor left registered once unloaded.
+ */
+static void register_loaded_images (plcrash_log_writer_t *writer) {
+    _dyld_register_func_for_remove_image(image_remove_callback);
+
+    /* Enumerate the loaded images */
+    uint32_t count = _dyld_image_count();
+    loaded_image_t *images = malloc(count * sizeof(*images));
+    uint32_t found = 0;
+
+    if (images != NULL) {
+        for (uint32_t i = 0; i < count; i++) {
+            /* Images may be unloaded concurrently; dyld returns NULL for indices that are no longer valid. */
+            images[found].header = _dyld_get_image_header(i);
+            images[found].name = _dyld_get_image_name(i);
+            images[found].unloaded = false;
+            if (images[found].header != NULL && images[found].name != NULL)
+                found++;
+        }
+
+        qsort(images, found, sizeof(*images), loaded_image_compare);
+    }
+
+    pthread_mutex_lock(&pending_images.lock); {
+        pending_images.thread = pthread_self();
+        pending_images.images = images;
+        pending_images.count = found;
+    } pthread_mutex_unlock(&pending_images.lock);
+
+    /* dyld will invoke the add callback for each loaded image; images not in the batch are registered immediately. */
+    _dyld_register_func_for_add_image(image_add_callback);
+
+    /* Register the batch. The lock is held until the images have been appended, preventing the remove callback from
+     * running for an image that has been taken from the batch but not yet registered. */
+    pthread_mutex_lock(&pending_images.lock); {
+        const void **headers = malloc(found * sizeof(*headers));
+        const char **names = malloc(found * sizeof(*names));
+        uint32_t loaded = 0;
+
+        if (headers != NULL && names != NULL) {
+            for (uint32_t i = 0; i < found; i++) {
+                if (images[i].unloaded)
+                    continue;
+
+                headers[loaded] = images[i].header;
+                names[loaded] = images[i].name;
+                loaded++;
+            }
+
+            plcrash_log_writer_add_images(writer, headers, names, loaded);
+        }
+
+        if (headers != NULL)
+            free(headers);
+        if (names != NULL)
+            free(names);
+
+        pending_images.images = NULL;
+        pending_images.count = 0;
+    } pthread_mutex_unlock(&pending_images.lock);
+
+    if (images != NULL)
+        free(images);
 }
 
 
@@ -177,6 +447,7 @@ static void uncaught_exception_handler (NSException *exception) {
 - (NSString *) crashReportDirectory;
 - (NSString *) queuedCrashReportDirectory;
 - (NSString *) crashReportPath;
+- (NSString *) reservedCrashReportPath;
 
 @end
 
@@ -303,10 +574,18 @@ static void uncaught_exception_handler (NSException *exception) {
     assert(_applicationIdentifier != nil);
     assert(_applicationVersion != nil);
     plcrash_log_writer_init(&signal_handler_context.writer, _applicationIdentifier, _applicationVersion);
+    plcrash_log_writer_set_options(&signal_handler_context.writer, signal_handler_context.writer_options);
+
+    /* Pre-allocate the output file. This is not fatal; the output file will be opened at crash time if necessary.
+     * The mapped file is written in place, and only the fallback requires an output buffer. If the buffer can not be
+     * allocated, the output file's smaller embedded buffer will be used. */
+    if (!reserve_output_file(&signal_handler_context, strdup([[self reservedCrashReportPath] UTF8String]), MAX_REPORT_BYTES)) {
+        if (signal_handler_context.output_buffer.size > PLCRASH_ASYNC_FILE_DEFAULT_BUFFER_SIZE)
+            signal_handler_context.output_buffer.data = malloc(signal_handler_context.output_buffer.size);
+    }
     
-    /* Enable dyld image monitoring */
-    _dyld_register_func_for_add_image(image_add_callback);
-    _dyld_register_func_for_remove_image(image_remove_callback);
+    /* Register the currently loaded images as a single batch, and enable dyld image monitoring */
+    register_loaded_images(&signal_handler_context.writer);
 
     /* Enable the signal handler */
     if (![[PLCrashSignalHandler sharedHandler] registerHandlerWithCallback: &signal_handler_callback context: &signal_handler_context error: outError])
@@ -320,6 +599,73 @@ static void uncaught_exception_handler (NSException *exception) {
     return YES;
 }
 
+/**
+ * Set the size of the buffer used when writing a crash report directly to its output file. The buffer is only
+ * flushed once full; larger values reduce the number of write calls issued while handling a crash. The default
+ * is 16KB, which is sufficient for most crash reports.
+ *
+ * Crash reports are normally written to a pre-allocated, memory-mapped file, which does not require a buffer. The
+ * buffer is only allocated, when the crash reporter is enabled, if the mapped file could not be created; this
+ * setting has no effect otherwise.
+ *
+ * @param size The buffer size, in bytes.
+ *
+ * @note This method must be called prior to PLCrashReporter::enableCrashReporter or
+ * PLCrashReporter::enableCrashReporterAndReturnError:
+ */
+- (void) setCrashReportBufferSize: (size_t) size {
+    /* Check for programmer error; the buffer is allocated when the signal handler is enabled. */
+    if (_enabled)
+        [NSException raise: PLCrashReporterException format: @"The crash reporter has alread been enabled"];
+
+    signal_handler_context.output_buffer.size = size;
+}
+
+/**
+ * Enable or disable image-relative encoding of backtrace frames. When enabled, each frame is written as the index
+ * of its binary image and the offset from the previous frame in that image, rather than as an absolute address;
+ * this reduces the size of the crash report. Reports written with this encoding may be decoded with
+ * PLCrashReport. Image-relative encoding is disabled by default.
+ *
+ * @param enabled YES to enable image-relative encoding.
+ *
+ * @note This method must be called prior to PLCrashReporter::enableCrashReporter or
+ * PLCrashReporter::enableCrashReporterAndReturnError:
+ */
+- (void) setImageRelativeFrameEncoding: (BOOL) enabled {
+    /* Check for programmer error; the options are applied when the signal handler is enabled. */
+    if (_enabled)
+        [NSException raise: PLCrashReporterException format: @"The crash reporter has alread been enabled"];
+
+    if (enabled)
+        signal_handler_context.writer_options |= PLCRASH_LOG_WRITER_OPTION_IMAGE_RELATIVE_FRAMES;
+    else
+        signal_handler_context.writer_options &= ~PLCRASH_LOG_WRITER_OPTION_IMAGE_RELATIVE_FRAMES;
+}
+
+/**
+ * Enable or disable compression of crash reports. When enabled, the crash report is written to a buffer allocated
+ * when the crash reporter is enabled, and is compressed before being written to disk; this reduces the size of
+ * the report on disk. If the compressed report would not fit within the crash report size limit, the report is
+ * written uncompressed instead. Compressed reports may be decoded with PLCrashReport. Compression is disabled by
+ * default.
+ *
+ * @param enabled YES to enable compression.
+ *
+ * @note This method must be called prior to PLCrashReporter::enableCrashReporter or
+ * PLCrashReporter::enableCrashReporterAndReturnError:
+ */
+- (void) setCrashReportCompression: (BOOL) enabled {
+    /* Check for programmer error; the options are applied when the signal handler is enabled. */
+    if (_enabled)
+        [NSException raise: PLCrashReporterException format: @"The crash reporter has alread been enabled"];
+
+    if (enabled)
+        signal_handler_context.writer_options |= PLCRASH_LOG_WRITER_OPTION_COMPRESS;
+    else
+        signal_handler_context.writer_options &= ~PLCRASH_LOG_WRITER_OPTION_COMPRESS;
+}
+
 /**
  * Set the callbacks that will be executed by the receiver after a crash has occured and been recorded by PLCrashReporter.
  *
@@ -477,6 +823,13 @@ static void uncaught_exception_handler (NSException *exception) {
     return [[self crashReportDirectory] stringByAppendingPathComponent: PLCRASH_LIVE_CRASHREPORT];
 }
 
+/**
+ * Return the path to the pre-allocated crash report output file.
+ */
+- (NSString *) reservedCrashReportPath {
+    return [[self crashReportDirectory] stringByAppendingPathComponent: PLCRASH_RESERVED_CRASHREPORT];
+}
+
 
 
 @end